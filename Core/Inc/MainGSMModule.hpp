@@ -38,6 +38,8 @@ private:
     std::unique_ptr<Tele::GyroTask> m_gyro_task;
     std::optional<Reply::HTTPResponseReady> m_last_http_response {};
 
+    Tele::PacketResendWindow m_resend_window {};
+
     std::atomic_bool m_gyro_guard;
     Stf::Vector<uint16_t, 3> m_gyro_data;
 
@@ -11,6 +11,7 @@
 #include <Packets.hpp>
 #include <Tele/CANTask.hpp>
 #include <Tele/DataCollector.hpp>
+#include <Tele/FlashSpool.hpp>
 #include <Tele/GPSTask.hpp>
 #include <Tele/StaticTask.hpp>
 
@@ -20,21 +21,63 @@ struct PacketForgerTask : Tele::StaticTask<2048> {
     inline static constexpr size_t queue_size = 100;
     using queue_item = Packet;
 
-    PacketForgerTask(DataCollectorTask& data_collector);
+    /// Spooled packets are binary encoded, whatever the configured encoding, and must fit in this many bytes.
+    inline static constexpr size_t spool_record_size = 512;
+
+    PacketForgerTask(DataCollectorTask& data_collector, CANTask& can_task, FlashSpool& spool);
 
     ~PacketForgerTask();
 
-    void reset_sequencer(std::span<uint32_t, 4> rng_iv);
+    /// Starts a new session, the sequence IDs start over.
+    /// @remarks
+    /// The packets in `unacknowledged` are resequenced through `PacketSequencer::resequence` ahead of anything the new
+    /// session produces, oldest first, so they are sent again instead of being lost. Spooled ones among them keep
+    /// awaiting their acknowledgement under their new sequence IDs.
+    void reset_sequencer(std::span<uint32_t, 4> rng_iv, PacketResendWindow& unacknowledged);
 
     size_t get_pending_packets(std::span<Packet> out);
 
+    /// Takes the oldest packets out of the spool, these were produced while the uplink was down or before a reset.
+    /// @remarks
+    /// Spooled packets are sequenced through `PacketSequencer::resequence` as they are taken, they keep their
+    /// timestamps but get the sequence IDs of the current session. Nothing is taken before `reset_sequencer`.\n
+    /// Taken packets stay in the spool until `acknowledge_spooled` covers their sequence IDs, those that were not
+    /// acknowledged by a reset are taken again.
+    size_t get_spooled_packets(std::span<Packet> out);
+
+    /// Consumes the taken spooled packets with sequence IDs in [first, last] from the spool.
+    /// @remarks
+    /// The spool is consumed oldest first, an acknowledged packet stays in it until every packet taken before it is
+    /// acknowledged too. A taken packet the resend window evicted must be acknowledged here as well, it won't be
+    /// anywhere else.
+    void acknowledge_spooled(uint32_t first, uint32_t last);
+
+    /// Packets go to the spool instead of the queue while the uplink is down, and whenever the queue is full. These are
+    /// spooled as whole packets before they are sequenced, which keeps the sequence IDs of the queued packets contiguous
+    /// and leaves the chain of `SparseFullPacket`s alone.
+    /// @remarks
+    /// The spool's next sector is erased while the uplink is up (see `FlashSpool::prepare`), so that spooling does not
+    /// stall the CPU when the uplink goes down.
+    void set_link_up(bool up) { m_link_up = up; }
+
+    FlashSpool::Statistics spool_statistics();
+
+    /// The CAN hardware FIFO overruns that happened while the spool was erasing or appending, the CPU can't drain the
+    /// FIFOs as it stalls on the flash.
+    uint32_t spool_fifo_overruns() const { return m_spool_fifo_overruns; }
+
+    /// Makes the next full packet a keyframe, for when sent packets might have been lost.
+    void request_keyframe() { m_keyframe_requested = true; }
+
 protected:
     [[noreturn]] void operator()() override;
 
 private:
     DataCollectorTask& m_data_collector;
+    CANTask& m_can_task;
 
     std::atomic_bool m_sequencer_ready = false;
+    std::atomic_bool m_keyframe_requested = false;
     SemaphoreHandle_t m_sequencer_mutex = nullptr;
     PacketSequencer m_sequencer {};
 
@@ -42,7 +85,37 @@ private:
     StaticQueue_t m_static_queue;
     QueueHandle_t m_packet_queue = nullptr;
 
+    struct SpooledPacket {
+        uint32_t sequence_id;
+        uint32_t ticket;
+    };
+
+    FlashSpool& m_spool;
+    std::atomic_bool m_link_up = false;
+    StaticSemaphore_t m_static_spool_mutex;
+    SemaphoreHandle_t m_spool_mutex = nullptr;
+    // taken spooled packets awaiting an acknowledgement, these are in the resend window
+    ResendWindow<SpooledPacket, PacketResendWindow::capacity> m_spooled_packets {};
+    std::atomic<uint32_t> m_spool_fifo_overruns = 0;
+
     FullPacket produce_full_packet();
+
+    void spool_packet(Packet const& packet);
+
+    /// Erases the spool's next sector if it can be.
+    void prepare_spool();
+
+    /// Calls `fn`, which may erase or program the flash, adding the CAN FIFO overruns meanwhile to the count.
+    template<typename Fn> auto count_fifo_overruns(Fn&& fn) {
+        const uint32_t before = m_can_task.rx_statistics().fifo_overruns;
+        auto ret = std::forward<Fn>(fn)();
+        m_spool_fifo_overruns += m_can_task.rx_statistics().fifo_overruns - before;
+
+        return ret;
+    }
+
+    /// Pops the spooled records that were read and are not awaited anymore, oldest first.
+    void consume_spooled();
 };
 
 }
@@ -11,8 +11,46 @@
 
 #include <Stuff/Serde/Serializers/JSON.hpp>
 
+#include <Tele/Binary.hpp>
+#include <Tele/ChannelBinder.hpp>
+#include <Tele/Columnar.hpp>
+#include <Tele/CommonMode.hpp>
+#include <Tele/Fixed.hpp>
+#include <Tele/Quantization.hpp>
+#include <Tele/ResendWindow.hpp>
+#include <Tele/Sparse.hpp>
+
 namespace Tele {
 
+enum class PacketEncoding : uint8_t {
+    JSON,
+
+    /// see `write_binary_batch`
+    Binary,
+
+    /// see `write_columnar_batch`
+    Columnar,
+};
+
+consteval PacketEncoding parse_packet_encoding(std::string_view name) {
+    if (name == "json")
+        return PacketEncoding::JSON;
+    if (name == "binary")
+        return PacketEncoding::Binary;
+    if (name == "columnar")
+        return PacketEncoding::Columnar;
+
+    throw std::invalid_argument("unknown packet encoding");
+}
+
+/// The version of the binary schemas below as a whole, bump it whenever any of them changes. The columnar encoding is
+/// built off of them too.
+inline constexpr uint32_t k_packet_binary_version = 4;
+
+/// The resolutions the BMS reports cell voltages and temperatures at, see `CANMessageTable`.
+using BatteryVoltageGrid = RangeFloat<uint8_t, 2.4f, 4.3f>;
+using BatteryTempGrid = RangeFloat<uint8_t, 0.f, 100.f>;
+
 struct EssentialsPacket {
     float speed;
     float bat_temp_readings[5];
@@ -29,11 +67,38 @@ inline constexpr auto _libstf_adl_introspector(EssentialsPacket&&) {
     return accessor;
 }
 
+inline constexpr auto _tele_adl_binary_schema(EssentialsPacket&&) {
+    return BinarySchema<EssentialsPacket> {} //
+      .field<&EssentialsPacket::speed>()
+      .field<&EssentialsPacket::bat_temp_readings>()
+      .field<&EssentialsPacket::voltage>()
+      .field<&EssentialsPacket::remaining_wh>();
+}
+
+static_assert(
+  decltype(_tele_adl_binary_schema(EssentialsPacket {}))::is_complete,
+  "the binary schema misses or reorders a member"
+);
+
+inline constexpr auto _tele_adl_channel_binder(EssentialsPacket&&) {
+    auto binder = ChannelBinder<EssentialsPacket> {} //
+                    .bind<&EssentialsPacket::speed, Channels::engine_speed>()
+                    .bind<&EssentialsPacket::bat_temp_readings, Channels::can_battery_temp>();
+    return binder;
+}
+
 struct DiagnosticPacket {
     uint32_t free_heap_space;
     uint32_t amt_allocs;
     uint32_t amt_frees;
     uint32_t performance[3];
+
+    // Data collector
+    uint32_t collector_writes_per_second;
+    uint32_t collector_reads_per_second;
+    uint32_t collector_read_retries;
+    uint32_t collector_read_wait_cycles;
+    uint32_t collector_max_hold_cycles;
 };
 
 inline constexpr auto _libstf_adl_introspector(DiagnosticPacket&&) {
@@ -41,10 +106,52 @@ inline constexpr auto _libstf_adl_introspector(DiagnosticPacket&&) {
                       .add_simple<&DiagnosticPacket::free_heap_space, "free">()
                       .add_simple<&DiagnosticPacket::amt_allocs, "alloc">()
                       .add_simple<&DiagnosticPacket::amt_frees, "free">()
-                      .add_simple<&DiagnosticPacket::performance, "perf">();
+                      .add_simple<&DiagnosticPacket::performance, "perf">()
+
+                      // Data collector
+                      .add_simple<&DiagnosticPacket::collector_writes_per_second, "cw">()
+                      .add_simple<&DiagnosticPacket::collector_reads_per_second, "cr">()
+                      .add_simple<&DiagnosticPacket::collector_read_retries, "crr">()
+                      .add_simple<&DiagnosticPacket::collector_read_wait_cycles, "cwc">()
+                      .add_simple<&DiagnosticPacket::collector_max_hold_cycles, "chc">();
     return accessor;
 }
 
+inline constexpr auto _tele_adl_binary_schema(DiagnosticPacket&&) {
+    return BinarySchema<DiagnosticPacket> {} //
+      .field<&DiagnosticPacket::free_heap_space>()
+      .field<&DiagnosticPacket::amt_allocs>()
+      .field<&DiagnosticPacket::amt_frees>()
+      .field<&DiagnosticPacket::performance>()
+
+      // Data collector
+      .field<&DiagnosticPacket::collector_writes_per_second>()
+      .field<&DiagnosticPacket::collector_reads_per_second>()
+      .field<&DiagnosticPacket::collector_read_retries>()
+      .field<&DiagnosticPacket::collector_read_wait_cycles>()
+      .field<&DiagnosticPacket::collector_max_hold_cycles>();
+}
+
+static_assert(
+  decltype(_tele_adl_binary_schema(DiagnosticPacket {}))::is_complete,
+  "the binary schema misses or reorders a member"
+);
+
+inline constexpr auto _tele_adl_channel_binder(DiagnosticPacket&&) {
+    auto binder = ChannelBinder<DiagnosticPacket> {} //
+                    .bind<&DiagnosticPacket::free_heap_space, Channels::rtos_heap_free>()
+                    .bind<&DiagnosticPacket::amt_allocs, Channels::rtos_heap_allocations>()
+                    .bind<&DiagnosticPacket::amt_frees, Channels::rtos_heap_deallocations>()
+
+                    // Data collector
+                    .bind<&DiagnosticPacket::collector_writes_per_second, Channels::collector_writes_per_second>()
+                    .bind<&DiagnosticPacket::collector_reads_per_second, Channels::collector_reads_per_second>()
+                    .bind<&DiagnosticPacket::collector_read_retries, Channels::collector_read_retries>()
+                    .bind<&DiagnosticPacket::collector_read_wait_cycles, Channels::collector_read_wait_cycles>()
+                    .bind<&DiagnosticPacket::collector_max_hold_cycles, Channels::collector_max_hold_cycles>();
+    return binder;
+}
+
 struct FullPacket {
     // BMS
     float battery_voltages[27];
@@ -84,6 +191,9 @@ struct FullPacket {
     uint32_t amt_allocs;
     uint32_t amt_frees;
     float cpu_usage;
+
+    /// bit `i` is set if the channel of the `i`th binding in `_tele_adl_channel_binder` was stale
+    uint32_t stale_fields;
 };
 
 inline constexpr auto _libstf_adl_introspector(FullPacket&&) {
@@ -124,11 +234,334 @@ inline constexpr auto _libstf_adl_introspector(FullPacket&&) {
                       .add_simple<&FullPacket::free_heap_space, "heap">()
                       .add_simple<&FullPacket::amt_allocs, "alloc">()
                       .add_simple<&FullPacket::amt_frees, "free">()
-                      .add_simple<&FullPacket::cpu_usage, "cu">();
+                      .add_simple<&FullPacket::cpu_usage, "cu">()
+                      .add_simple<&FullPacket::stale_fields, "stale">();
     return accessor;
 }
 
-using packets_variant = std::variant<EssentialsPacket, DiagnosticPacket, FullPacket>;
+inline constexpr auto _tele_adl_binary_schema(FullPacket&&) {
+    // the cells move together, their differences from the mean fit in a byte. the cells past k_battery_cell_count
+    // aren't bound to anything.
+    return BinarySchema<FullPacket> {} // BMS
+      .coded_field<&FullPacket::battery_voltages, CommonModeCodec<BatteryVoltageGrid, k_battery_cell_count>>()
+      .coded_field<&FullPacket::battery_temps, CommonModeCodec<BatteryTempGrid>>()
+      .field<&FullPacket::spent_mah>()
+      .field<&FullPacket::spent_mwh>()
+      .field<&FullPacket::current>()
+      .field<&FullPacket::soc_percent>()
+
+      // Fuel cell (hydro only)
+      .field<&FullPacket::hydro_current>()
+      .field<&FullPacket::hydro_ppm>()
+      .field<&FullPacket::hydro_temp>()
+
+      // VCS
+      .field<&FullPacket::temperature_smps>()
+      .field<&FullPacket::temperature_engine_driver>()
+      .field<&FullPacket::vc_engine_driver>()
+      .field<&FullPacket::vc_telemetry>()
+      .field<&FullPacket::vc_smps>()
+      .field<&FullPacket::vc_bms>()
+
+      // Engine
+      .field<&FullPacket::rpm>()
+      .field<&FullPacket::speed>()
+      .field<&FullPacket::vc_engine>()
+
+      // Local
+      .field<&FullPacket::longitude>()
+      .field<&FullPacket::latitude>()
+      .field<&FullPacket::gyro>()
+
+      // Diagnostic
+      .field<&FullPacket::queue_fill_amt>()
+      .field<&FullPacket::tick_counter>()
+      .field<&FullPacket::free_heap_space>()
+      .field<&FullPacket::amt_allocs>()
+      .field<&FullPacket::amt_frees>()
+      .field<&FullPacket::cpu_usage>()
+      .field<&FullPacket::stale_fields>();
+}
+
+static_assert(
+  decltype(_tele_adl_binary_schema(FullPacket {}))::is_complete,
+  "the binary schema misses or reorders a member"
+);
+
+inline constexpr auto _tele_adl_channel_binder(FullPacket&&) {
+    auto binder = ChannelBinder<FullPacket> {} // BMS
+                    .bind<&FullPacket::battery_voltages, Channels::can_battery_voltage>()
+                    .bind<&FullPacket::battery_temps, Channels::can_battery_temp>()
+                    .bind<&FullPacket::spent_mah, Channels::can_spent_mah>()
+                    .bind<&FullPacket::spent_mwh, Channels::can_spent_mwh>()
+                    .bind<&FullPacket::current, Channels::can_current>()
+                    .bind<&FullPacket::soc_percent, Channels::can_soc_percent>()
+
+                    // Fuel cell (hydro only)
+                    .bind<&FullPacket::hydro_ppm, Channels::can_hydro_ppm>()
+                    .bind<&FullPacket::hydro_temp, Channels::can_hydro_temp>()
+
+                    // Engine
+                    .bind<&FullPacket::rpm, Channels::engine_rpm>()
+                    .bind<&FullPacket::speed, Channels::engine_speed>()
+
+                    // Local
+                    .bind<&FullPacket::longitude, Channels::gps_longitude>()
+                    .bind<&FullPacket::latitude, Channels::gps_latitude>()
+
+                    // Diagnostic
+                    .bind<&FullPacket::tick_counter, Channels::hal_lf_ticks>()
+                    .bind<&FullPacket::free_heap_space, Channels::rtos_heap_free>()
+                    .bind<&FullPacket::amt_allocs, Channels::rtos_heap_allocations>()
+                    .bind<&FullPacket::amt_frees, Channels::rtos_heap_deallocations>();
+    return binder;
+}
+
+/// `EssentialsPacket` at the precision its sources have.
+struct QuantizedEssentialsPacket {
+    Fixed<uint16_t, -6> speed;
+    RangeFloat<uint8_t, 0.f, 100.f> bat_temp_readings[5];
+    Fixed<uint16_t, -8> voltage;
+    Fixed<uint16_t, 0> remaining_wh;
+};
+
+inline constexpr auto _libstf_adl_introspector(QuantizedEssentialsPacket&&) {
+    auto accessor = Stf::Intro::StructBuilder<QuantizedEssentialsPacket> {} //
+                      .add_simple<&QuantizedEssentialsPacket::speed, "spd">()
+                      .add_simple<&QuantizedEssentialsPacket::bat_temp_readings, "temps">()
+                      .add_simple<&QuantizedEssentialsPacket::voltage, "v">()
+                      .add_simple<&QuantizedEssentialsPacket::remaining_wh, "wh">();
+    return accessor;
+}
+
+inline constexpr auto _tele_adl_binary_schema(QuantizedEssentialsPacket&&) {
+    return BinarySchema<QuantizedEssentialsPacket> {} //
+      .field<&QuantizedEssentialsPacket::speed, BinaryEncoding::Fixed>()
+      .field<&QuantizedEssentialsPacket::bat_temp_readings, BinaryEncoding::Fixed>()
+      .field<&QuantizedEssentialsPacket::voltage, BinaryEncoding::Fixed>()
+      .field<&QuantizedEssentialsPacket::remaining_wh>();
+}
+
+static_assert(
+  decltype(_tele_adl_binary_schema(QuantizedEssentialsPacket {}))::is_complete,
+  "the binary schema misses or reorders a member"
+);
+
+inline constexpr auto _tele_adl_quantization(QuantizedEssentialsPacket&&) {
+    return Quantization<EssentialsPacket, QuantizedEssentialsPacket> {} //
+      .field<&EssentialsPacket::speed, &QuantizedEssentialsPacket::speed>()
+      .field<&EssentialsPacket::bat_temp_readings, &QuantizedEssentialsPacket::bat_temp_readings>()
+      .field<&EssentialsPacket::voltage, &QuantizedEssentialsPacket::voltage>()
+      .field<&EssentialsPacket::remaining_wh, &QuantizedEssentialsPacket::remaining_wh>();
+}
+
+static_assert(
+  decltype(_tele_adl_quantization(QuantizedEssentialsPacket {}))::is_complete,
+  "the quantization misses or reorders a member"
+);
+
+/// `FullPacket` at the precision its sources have.
+/// @remarks
+/// BMS fields use the ranges and widths the BMS sends them in (see `CANMessageTable`), values within those ranges
+/// round trip exactly. Values outside of them are clamped, a cell that was never written (0 V) comes back as 2.4 V.
+/// Voltage/current pairs are 1/128 steps within ±256, temperatures 0.5 °C steps within [0, 127.5].
+struct QuantizedFullPacket {
+    using volt_amps = Fixed<int16_t, -7>[2];
+    using temperature = RangeFloat<uint8_t, 0.f, 127.5f>;
+
+    // BMS
+    BatteryVoltageGrid battery_voltages[27];
+    BatteryTempGrid battery_temps[5];
+    RangeFloat<uint16_t, 0.f, 15000.f> spent_mah;
+    RangeFloat<uint16_t, 0.f, 15000.f * 256> spent_mwh;
+    RangeFloat<uint16_t, -10.f, 50.f> current;
+    RangeFloat<uint16_t, -5.f, 105.f> soc_percent;
+
+    // Fuel cell (hydro only)
+    Fixed<int16_t, -7> hydro_current;
+    RangeFloat<uint8_t, 0.f, 255.f> hydro_ppm;
+    RangeFloat<uint8_t, 0.f, 255.f> hydro_temp;
+
+    // VCS
+    temperature temperature_smps;
+    temperature temperature_engine_driver;
+    volt_amps vc_engine_driver;
+    volt_amps vc_telemetry;
+    volt_amps vc_smps;
+    volt_amps vc_bms;
+
+    // Engine
+    Fixed<uint16_t, 0> rpm;
+    Fixed<uint16_t, -6> speed;
+    volt_amps vc_engine;
+
+    // Local, ~1.3 cm steps
+    Fixed<int32_t, -23> longitude;
+    Fixed<int32_t, -23> latitude;
+    Fixed<int16_t, -8> gyro[3];
+
+    // Diagnostic
+    uint8_t queue_fill_amt;
+    uint32_t tick_counter;
+    uint32_t free_heap_space;
+    uint32_t amt_allocs;
+    uint32_t amt_frees;
+    RangeFloat<uint8_t, 0.f, 1.f> cpu_usage;
+    uint32_t stale_fields;
+};
+
+inline constexpr auto _libstf_adl_introspector(QuantizedFullPacket&&) {
+    auto accessor = Stf::Intro::StructBuilder<QuantizedFullPacket> {} // BMS
+                      .add_simple<&QuantizedFullPacket::battery_voltages, "v">()
+                      .add_simple<&QuantizedFullPacket::battery_temps, "temps">()
+                      .add_simple<&QuantizedFullPacket::spent_mah, "mah">()
+                      .add_simple<&QuantizedFullPacket::spent_mwh, "mwh">()
+                      .add_simple<&QuantizedFullPacket::current, "amps">()
+                      .add_simple<&QuantizedFullPacket::soc_percent, "soc">()
+
+                      // Fuel cell (hydro only)
+                      .add_simple<&QuantizedFullPacket::hydro_current, "hc">()
+                      .add_simple<&QuantizedFullPacket::hydro_ppm, "hd">()
+                      .add_simple<&QuantizedFullPacket::hydro_temp, "ht">()
+
+                      // VCS
+                      .add_simple<&QuantizedFullPacket::temperature_smps, "ts">()
+                      .add_simple<&QuantizedFullPacket::temperature_engine_driver, "ted">()
+                      .add_simple<&QuantizedFullPacket::vc_engine_driver, "vced">()
+                      .add_simple<&QuantizedFullPacket::vc_telemetry, "vct">()
+                      .add_simple<&QuantizedFullPacket::vc_smps, "vcs">()
+                      .add_simple<&QuantizedFullPacket::vc_bms, "vcb">()
+
+                      // Engine
+                      .add_simple<&QuantizedFullPacket::rpm, "rpm">()
+                      .add_simple<&QuantizedFullPacket::speed, "spd">()
+                      .add_simple<&QuantizedFullPacket::vc_engine, "vce">()
+
+                      // Local
+                      .add_simple<&QuantizedFullPacket::longitude, "long">()
+                      .add_simple<&QuantizedFullPacket::latitude, "lat">()
+                      .add_simple<&QuantizedFullPacket::gyro, "gyro">()
+
+                      // Diagnostic
+                      .add_simple<&QuantizedFullPacket::queue_fill_amt, "q">()
+                      .add_simple<&QuantizedFullPacket::tick_counter, "tc">()
+                      .add_simple<&QuantizedFullPacket::free_heap_space, "heap">()
+                      .add_simple<&QuantizedFullPacket::amt_allocs, "alloc">()
+                      .add_simple<&QuantizedFullPacket::amt_frees, "free">()
+                      .add_simple<&QuantizedFullPacket::cpu_usage, "cu">()
+                      .add_simple<&QuantizedFullPacket::stale_fields, "stale">();
+    return accessor;
+}
+
+inline constexpr auto _tele_adl_binary_schema(QuantizedFullPacket&&) {
+    // everything with a fixed width is written as such, varints would only lengthen values with their top bits set
+    return BinarySchema<QuantizedFullPacket> {} // BMS
+      .field<&QuantizedFullPacket::battery_voltages, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::battery_temps, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::spent_mah, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::spent_mwh, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::current, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::soc_percent, BinaryEncoding::Fixed>()
+
+      // Fuel cell (hydro only)
+      .field<&QuantizedFullPacket::hydro_current, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::hydro_ppm, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::hydro_temp, BinaryEncoding::Fixed>()
+
+      // VCS
+      .field<&QuantizedFullPacket::temperature_smps, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::temperature_engine_driver, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::vc_engine_driver, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::vc_telemetry, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::vc_smps, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::vc_bms, BinaryEncoding::Fixed>()
+
+      // Engine
+      .field<&QuantizedFullPacket::rpm, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::speed, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::vc_engine, BinaryEncoding::Fixed>()
+
+      // Local
+      .field<&QuantizedFullPacket::longitude, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::latitude, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::gyro, BinaryEncoding::Fixed>()
+
+      // Diagnostic
+      .field<&QuantizedFullPacket::queue_fill_amt, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::tick_counter>()
+      .field<&QuantizedFullPacket::free_heap_space>()
+      .field<&QuantizedFullPacket::amt_allocs>()
+      .field<&QuantizedFullPacket::amt_frees>()
+      .field<&QuantizedFullPacket::cpu_usage, BinaryEncoding::Fixed>()
+      .field<&QuantizedFullPacket::stale_fields>();
+}
+
+static_assert(
+  decltype(_tele_adl_binary_schema(QuantizedFullPacket {}))::is_complete,
+  "the binary schema misses or reorders a member"
+);
+
+inline constexpr auto _tele_adl_quantization(QuantizedFullPacket&&) {
+    return Quantization<FullPacket, QuantizedFullPacket> {} // BMS
+      .field<&FullPacket::battery_voltages, &QuantizedFullPacket::battery_voltages>()
+      .field<&FullPacket::battery_temps, &QuantizedFullPacket::battery_temps>()
+      .field<&FullPacket::spent_mah, &QuantizedFullPacket::spent_mah>()
+      .field<&FullPacket::spent_mwh, &QuantizedFullPacket::spent_mwh>()
+      .field<&FullPacket::current, &QuantizedFullPacket::current>()
+      .field<&FullPacket::soc_percent, &QuantizedFullPacket::soc_percent>()
+
+      // Fuel cell (hydro only)
+      .field<&FullPacket::hydro_current, &QuantizedFullPacket::hydro_current>()
+      .field<&FullPacket::hydro_ppm, &QuantizedFullPacket::hydro_ppm>()
+      .field<&FullPacket::hydro_temp, &QuantizedFullPacket::hydro_temp>()
+
+      // VCS
+      .field<&FullPacket::temperature_smps, &QuantizedFullPacket::temperature_smps>()
+      .field<&FullPacket::temperature_engine_driver, &QuantizedFullPacket::temperature_engine_driver>()
+      .field<&FullPacket::vc_engine_driver, &QuantizedFullPacket::vc_engine_driver>()
+      .field<&FullPacket::vc_telemetry, &QuantizedFullPacket::vc_telemetry>()
+      .field<&FullPacket::vc_smps, &QuantizedFullPacket::vc_smps>()
+      .field<&FullPacket::vc_bms, &QuantizedFullPacket::vc_bms>()
+
+      // Engine
+      .field<&FullPacket::rpm, &QuantizedFullPacket::rpm>()
+      .field<&FullPacket::speed, &QuantizedFullPacket::speed>()
+      .field<&FullPacket::vc_engine, &QuantizedFullPacket::vc_engine>()
+
+      // Local
+      .field<&FullPacket::longitude, &QuantizedFullPacket::longitude>()
+      .field<&FullPacket::latitude, &QuantizedFullPacket::latitude>()
+      .field<&FullPacket::gyro, &QuantizedFullPacket::gyro>()
+
+      // Diagnostic
+      .field<&FullPacket::queue_fill_amt, &QuantizedFullPacket::queue_fill_amt>()
+      .field<&FullPacket::tick_counter, &QuantizedFullPacket::tick_counter>()
+      .field<&FullPacket::free_heap_space, &QuantizedFullPacket::free_heap_space>()
+      .field<&FullPacket::amt_allocs, &QuantizedFullPacket::amt_allocs>()
+      .field<&FullPacket::amt_frees, &QuantizedFullPacket::amt_frees>()
+      .field<&FullPacket::cpu_usage, &QuantizedFullPacket::cpu_usage>()
+      .field<&FullPacket::stale_fields, &QuantizedFullPacket::stale_fields>();
+}
+
+static_assert(
+  decltype(_tele_adl_quantization(QuantizedFullPacket {}))::is_complete,
+  "the quantization misses or reorders a member"
+);
+
+/// The fields of a `QuantizedFullPacket` that changed since the packet sequenced right before it, see
+/// `PacketSequencer::sequence_sparse`.
+using SparseFullPacket = Sparse<QuantizedFullPacket>;
+
+inline constexpr auto _libstf_adl_introspector(SparseFullPacket&&) {
+    auto accessor = Stf::Intro::StructBuilder<SparseFullPacket> {} //
+                      .add_simple<&SparseFullPacket::present, "p">()
+                      .add_simple<&SparseFullPacket::values, "d">();
+    return accessor;
+}
+
+// new alternatives go to the end, the binary encoding refers to them by index
+using packets_variant = std::variant<
+  EssentialsPacket, DiagnosticPacket, FullPacket, QuantizedEssentialsPacket, QuantizedFullPacket, SparseFullPacket>;
 
 struct Packet {
     uint32_t sequence_id;
@@ -148,16 +581,74 @@ inline constexpr auto _libstf_adl_introspector(Packet&&) {
     return accessor;
 }
 
+inline constexpr auto _tele_adl_binary_schema(Packet&&) {
+    return BinarySchema<Packet> {} //
+      .field<&Packet::sequence_id>()
+      .field<&Packet::timestamp, BinaryEncoding::Fixed>()
+      .field<&Packet::rng_state, BinaryEncoding::Fixed>()
+      .field<&Packet::data>();
+}
+
+static_assert(
+  decltype(_tele_adl_binary_schema(Packet {}))::is_complete,
+  "the binary schema misses or reorders a member"
+);
+
+/// Writes a batch of packets in the binary encoding: the byte 'B', `k_packet_binary_version` and the packets as a span.
+template<typename Stream> void write_binary_batch(Stream& stream, std::span<const Packet> packets) {
+    BinaryWriter writer { stream };
+
+    writer.write_byte('B');
+    writer.write_varint(k_packet_binary_version);
+    writer.write(packets);
+}
+
+/// Writes a batch of packets in the columnar encoding: the byte 'C', `k_packet_binary_version` and the packets as a
+/// columnar block.
+template<typename Stream> void write_columnar_batch(Stream& stream, std::span<const Packet> packets) {
+    BinaryWriter { stream }.write_byte('C');
+    BinaryWriter { stream }.write_varint(k_packet_binary_version);
+    ColumnarWriter { stream }.write(packets);
+}
+
+/// The RAM set aside for sent packets awaiting an acknowledgement.
+inline constexpr size_t k_resend_window_bytes = 8 * 1024;
+
+/// Sent packets stay here until the server acknowledges their sequence IDs, see `Reply::PacketAck`.
+using PacketResendWindow = ResendWindow<Packet, k_resend_window_bytes / sizeof(Packet)>;
+
 struct PacketSequencer {
+    /// A keyframe is followed by at most this many `SparseFullPacket`s before the next one.
+    inline static constexpr uint32_t keyframe_interval = 15;
+
+    /// Timestamps a packet without sequencing it, for packets that are spooled before they get a sequence ID.
+    static Packet stamp(packets_variant inner);
+
     Packet sequence(packets_variant inner);
 
+    /// Sequences a keyframe, being the whole packet, or the fields that changed since the previous call.
+    /// @remarks
+    /// Sparse packets are relative to the keyframe or sparse packet sequenced last before them, packets sequenced
+    /// through `sequence` in between are not a part of the chain. Whoever reconstructs the state must discard sparse
+    /// packets up until the next keyframe once any packet of the chain goes missing.
+    Packet sequence_sparse(QuantizedFullPacket const& packet);
+
+    /// Gives a packet the sequence ID and the PRNG state of a new one while keeping its timestamp and its data, for
+    /// packets that were sequenced but never sent, possibly in an earlier session.
+    Packet resequence(Packet packet);
+
+    /// Makes the next `sequence_sparse` call produce a keyframe.
+    void request_keyframe() { m_keyframe_requested = true; }
+
     void reset(std::span<uint32_t, 4> rng_vector);
 
 private:
     uint32_t m_last_seq_id = 0;
     uint32_t m_rng_state[4] = { 0xDEADBEEF, 0xCAFEBABE, 0xDEADC0DE, 0x8BADF00D };
 
-    // CircularBuffer<Packet, 32> m_resend_window;
+    QuantizedFullPacket m_last_full_packet {};
+    uint32_t m_packets_since_keyframe = 0;
+    bool m_keyframe_requested = true;
 
     static constexpr uint32_t xoshiro_next(uint32_t (&s)[4]) {
         const uint32_t result = std::rotl(s[0] + s[3], 7) + s[0];
@@ -8,6 +8,30 @@ void signature_benchmark(P256::PrivateKey const& sk);
 
 void p256_test(P256::PrivateKey const& sk);
 
+void data_collector_benchmark();
+
+void packet_snapshot_benchmark();
+
+void battery_aggregate_benchmark();
+
+void can_decode_benchmark();
+
+void kernels_benchmark();
+
+void packet_encoding_benchmark();
+
+void digest_stream_benchmark();
+
+void columnar_encoding_benchmark();
+
+void resend_window_simulation();
+
+bool data_collector_stress_test();
+
+bool can_rx_line_rate_test();
+
+bool can_filter_packing_test();
+
 void test_parse_ip();
 
 }
@@ -25,6 +25,9 @@ static constexpr std::string_view packet_diagnostic = "http://example.com/packet
 static constexpr std::string_view packet_essentials = "http://example.com/packet/essentials";
 static constexpr std::string_view packet_full = "http://example.com/packet/full";
 
+// "json", "binary" or "columnar", see Tele::PacketEncoding
+static constexpr std::string_view packet_full_encoding = "json";
+
 }
 
 static constexpr std::array<SigTest, 2> sig_tests { {
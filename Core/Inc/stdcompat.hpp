@@ -5,7 +5,9 @@
 #include <span>
 #include <string_view>
 
+#if !defined(__GLIBC__)
 extern "C" void getentropy(void *buffer, size_t length);
+#endif
 
 /*using __int128_t [[gnu::mode(TI)]] = int;
 using __uint128_t [[gnu::mode(TI)]] = unsigned;*/
@@ -41,8 +43,10 @@ private:
 };*/
 
 // i tried, ok?
+#if !defined(__SIZEOF_INT128__)
 using __uint128_t = uint64_t;
 using __int128_t = int64_t;
+#endif
 
 namespace Tele {
 
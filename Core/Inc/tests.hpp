@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+
+#include <Packets.hpp>
+
+/// Tests that need neither the HAL nor the scheduler, these run on the target through `run_tests` and on the host
+/// through the `Tests` project. Each returns whether every one of its checks passed.
+namespace Tele {
+
+/// A batch of ten full packets with plausible values, as sent to the packet_full endpoint.
+std::array<Packet, 10> make_packet_batch();
+
+/// Ten full packets 667 ms apart, as the forger would produce them while driving. Values are decoded off raw fields
+/// that drift the way the BMS and engine readings do, the way `CANTask` would decode them.
+std::array<Packet, 10> make_packet_series();
+
+/// Delivered fraction and goodput, unique packets delivered per packet transmitted, of an uplink round after round.
+/// @remarks
+/// Every round the forger produces two packets and a batch of the oldest ten is posted. The request is lost with
+/// `loss_rate`, so is the response carrying the acks. Rounds 400 through 499 are an outage where every request is lost.
+/// A full window evicts its oldest packet. Without a window, packets are sent once in the round they are produced.
+std::array<float, 2> simulate_uplink(float loss_rate, bool with_window);
+
+bool kernels_test();
+
+bool binary_encoding_test();
+
+bool quantization_test();
+
+bool columnar_encoding_test();
+
+bool sparse_packet_test();
+
+bool common_mode_test();
+
+bool resend_window_test();
+
+bool flash_spool_test();
+
+}
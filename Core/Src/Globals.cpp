@@ -8,6 +8,7 @@
 
 #include <Stuff/Maths/Check/CRC.hpp>
 
+#include <Tele/CANTask.hpp>
 #include <Tele/CharConv.hpp>
 #include <Tele/Log.hpp>
 #include <Tele/Stream.hpp>
@@ -16,6 +17,7 @@
 #include <PlainSink.hpp>
 #include <benchmarks.hpp>
 #include <secrets.hpp>
+#include <tests.hpp>
 
 namespace Tele {
 
@@ -48,32 +50,15 @@ P256::PrivateKey get_sk_from_config() {
 void init_globals() {
     g_privkey = Tele::get_sk_from_config();
 
+    Tele::enable_cycle_counter();
+
     HAL_RNG_Init(&hrng);
     HAL_CRC_Init(&hcrc);
 
-    CAN_FilterTypeDef filter = {
-        .FilterIdHigh = 0,
-        .FilterIdLow = 0,
-        .FilterMaskIdHigh = 0,
-        .FilterMaskIdLow = 0,
-        .FilterFIFOAssignment = CAN_RX_FIFO0,
-        .FilterBank = 0,
-        .FilterMode = CAN_FILTERMODE_IDMASK,
-        .FilterScale = CAN_FILTERSCALE_32BIT,
-        .FilterActivation = ENABLE,
-        .SlaveStartFilterBank = 14,
-    };
-
-    if (HAL_CAN_ConfigFilter(&hcan1, &filter) != HAL_OK) {
+    if (k_can_filter_plan.configure(hcan1) != HAL_OK) {
         Error_Handler();
     }
 
-    /*if (fifo) {
-        filter.FilterFIFOAssignment = *fifo;
-        if (HAL_CAN_ConfigFilter(&hcan1, &filter) != HAL_OK)
-            Error_Handler();
-    }*/
-
     if (HAL_CAN_Start(&hcan1) != HAL_OK) {
         Error_Handler();
     }
@@ -83,8 +68,48 @@ void init_globals() {
     }*/
 }
 
-void run_benchmarks() { Tele::p256_test(g_privkey); }
+void run_benchmarks() {
+    Tele::p256_test(g_privkey);
+    Tele::data_collector_benchmark();
+    Tele::packet_snapshot_benchmark();
+    Tele::battery_aggregate_benchmark();
+    Tele::can_decode_benchmark();
+    Tele::kernels_benchmark();
+    Tele::packet_encoding_benchmark();
+    Tele::digest_stream_benchmark();
+    Tele::columnar_encoding_benchmark();
+    Tele::resend_window_simulation();
+}
+
+void run_tests() {
+    Tele::signature_benchmark(g_privkey);
+
+    static constexpr std::pair<std::string_view, bool (*)()> tests[] {
+        { "data_collector_stress_test", Tele::data_collector_stress_test },
+        { "can_rx_line_rate_test", Tele::can_rx_line_rate_test },
+        { "can_filter_packing_test", Tele::can_filter_packing_test },
+        { "kernels_test", Tele::kernels_test },
+        { "binary_encoding_test", Tele::binary_encoding_test },
+        { "quantization_test", Tele::quantization_test },
+        { "columnar_encoding_test", Tele::columnar_encoding_test },
+        { "sparse_packet_test", Tele::sparse_packet_test },
+        { "common_mode_test", Tele::common_mode_test },
+        { "resend_window_test", Tele::resend_window_test },
+        { "flash_spool_test", Tele::flash_spool_test },
+    };
+
+    size_t failed = 0;
 
-void run_tests() { Tele::signature_benchmark(g_privkey); }
+    for (auto const& [name, test] : tests) {
+        if (test()) {
+            Log::info("{}: passed", name);
+        } else {
+            Log::error("{}: FAILED", name);
+            failed++;
+        }
+    }
+
+    Log::info("{} of {} tests passed", std::size(tests) - failed, std::size(tests));
+}
 
 }
\ No newline at end of file
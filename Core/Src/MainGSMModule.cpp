@@ -172,46 +172,162 @@ bool MainModule::initialize_session(std::span<uint32_t, 4> out_rng_vector) {
     return true;
 }
 
+static constexpr Tele::PacketEncoding k_packet_full_encoding
+  = Tele::parse_packet_encoding(Tele::Config::Endpoints::packet_full_encoding);
+
+template<typename Stream> static void serialize_packet_batch(Stream& stream, std::span<Tele::Packet> packets) {
+    if constexpr (k_packet_full_encoding == Tele::PacketEncoding::Binary) {
+        Tele::write_binary_batch(stream, packets);
+    } else if constexpr (k_packet_full_encoding == Tele::PacketEncoding::Columnar) {
+        Tele::write_columnar_batch(stream, packets);
+    } else {
+        Stf::Serde::JSON::Serializer<Stream> serializer { stream };
+        Stf::serialize(serializer, packets);
+    }
+}
+
+/// A signed batch of packets for the packet_full endpoint, serialized straight into the modem.
+/// @remarks
+/// The batch is serialized twice, once by `prepare` to size and sign it and once more by `write` to send it, neither
+/// holds more than a chunk of it in memory. The serialization must be deterministic for the signature to hold.\n
+/// The signature covers everything before it. It is appended as 128 hex digits for JSON and as 64 little endian bytes
+/// for the binary encodings, r first in both.
+struct PacketBatchBody final : HTTPBodyWriter {
+    inline static constexpr size_t chunk_size = 64;
+
+    PacketBatchBody(std::span<Tele::Packet> packets)
+        : m_packets(packets) { }
+
+    /// @return
+    /// The size of the body.
+    size_t prepare() {
+        Tele::CountingStream counter {};
+        Stf::Hash::SHA256State hash_state {};
+        Tele::DigestStream digest_stream { counter, hash_state };
+
+        auto sink = [&](std::string_view chunk) { digest_stream << chunk; };
+
+        Tele::ChunkedStream<chunk_size, decltype(sink)> stream { sink };
+        serialize_packet_batch(stream, m_packets);
+        stream.flush();
+
+        std::array<uint32_t, 8> hash = hash_state.finish();
+        P256::Signature signature = sign(Tele::g_privkey, hash.data());
+
+        if constexpr (k_packet_full_encoding != Tele::PacketEncoding::JSON) {
+            Tele::BufCharStream signature_stream { m_signature };
+            Tele::BinaryWriter writer { signature_stream };
+
+            for (uint32_t word : signature.r)
+                writer.write_fixed(word);
+            for (uint32_t word : signature.s)
+                writer.write_fixed(word);
+
+            m_signature_size = 64;
+        } else {
+            std::span<char> sig_span { m_signature };
+
+            Tele::to_chars(std::span(signature.r), sig_span.subspan(0, 64), std::endian::little);
+            Tele::to_chars(std::span(signature.s), sig_span.subspan(64, 64), std::endian::little);
+
+            m_signature_size = 128;
+        }
+
+        return counter.size() + m_signature_size;
+    }
+
+    void write(TransmitTask& transmit_task) override {
+        auto sink = [&](std::string_view chunk) { transmit_task.transmit(std::span(chunk)); };
+
+        Tele::ChunkedStream<chunk_size, decltype(sink)> stream { sink };
+        serialize_packet_batch(stream, m_packets);
+        stream.flush();
+
+        transmit_task.transmit(std::span<const char>(m_signature).first(m_signature_size));
+    }
+
+private:
+    std::span<Tele::Packet> m_packets;
+
+    std::array<char, 128> m_signature;
+    size_t m_signature_size = 0;
+};
+
 int MainModule::packet_loop() {
+    static constexpr std::string_view content_type
+      = k_packet_full_encoding != Tele::PacketEncoding::JSON ? "application/octet-stream" : "text/plain";
+
     // clang-format off
     TRY_OR_RET(1, extract_replies_from_range<Reply::Okay>(m_coordinator->send_command_async(this, Command::HTTPInit {})));
     TRY_OR_RET(1, extract_replies_from_range<Reply::Okay>(m_coordinator->send_command_async(this, Command::HTTPSetBearer { BearerProfile::Profile0 })));
     TRY_OR_RET(1, extract_replies_from_range<Reply::Okay>(m_coordinator->send_command_async(this, Command::HTTPSetUA { "https://github.com/xor-shift/TeleV2" })));
     TRY_OR_RET(1, extract_replies_from_range<Reply::Okay>(m_coordinator->send_command_async(this, Command::HTTPSetURL { Tele::Config::Endpoints::packet_full })));
-    TRY_OR_RET(1, extract_replies_from_range<Reply::Okay>(m_coordinator->send_command_async(this, Command::HTTPContentType { "text/plain" })));
+    TRY_OR_RET(1, extract_replies_from_range<Reply::Okay>(m_coordinator->send_command_async(this, Command::HTTPContentType { content_type })));
     // clang-format on
 
+    // packets go to the spool again as soon as the uplink fails
+    m_packet_forger.set_link_up(true);
+    Stf::ScopeExit link_guard { [this] { m_packet_forger.set_link_up(false); } };
+
+    // the forger's queue might have overflown while the uplink was down, sparse packets after a gap are useless
+    // without a keyframe
+    m_packet_forger.request_keyframe();
+
+    auto evict = [this](std::optional<Tele::Packet> const& evicted) {
+        if (!evicted)
+            return;
+
+        // sparse packets after the evicted one are useless without a keyframe. if it was spooled, its record is
+        // consumed as the window held its only other copy.
+        m_packet_forger.request_keyframe();
+        m_packet_forger.acknowledge_spooled(evicted->sequence_id, evicted->sequence_id);
+    };
+
     for (;;) {
         vTaskDelay(500);
 
         std::array<Tele::Packet, 10> arr;
-        size_t pending_packet_count = m_packet_forger.get_pending_packets(arr);
-        std::span<Tele::Packet> pending_packets { begin(arr), pending_packet_count };
 
-        std::string serialization_buffer;
-        Tele::PushBackStream serialization_stream { serialization_buffer };
-        Stf::Serde::JSON::Serializer<Tele::PushBackStream<std::string>> serializer { serialization_stream };
-        Stf::serialize(serializer, pending_packets);
+        // everything pending goes into the window, unacknowledged packets are the oldest and are sent first
+        const size_t evictions_before = m_resend_window.evictions();
+        for (size_t count; (count = m_packet_forger.get_pending_packets(arr)) != 0;) {
+            for (Tele::Packet const& packet : std::span(arr).first(count))
+                evict(m_resend_window.push(packet));
+        }
 
-        Stf::Hash::SHA256State hash_state {};
-        hash_state.update(std::string_view { serialization_buffer });
-        std::array<uint32_t, 8> hash = hash_state.finish();
-        P256::Signature signature = sign(Tele::g_privkey, hash.data());
+        // live packets come first, the spool fills what they leave of a batch so that it drains as fast as the
+        // uplink allows
+        if (m_resend_window.size() < arr.size()) {
+            const auto room = std::span(arr).first(arr.size() - m_resend_window.size());
 
-        serialization_buffer += "0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF";
-        serialization_buffer += "0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF";
+            for (Tele::Packet const& packet : room.first(m_packet_forger.get_spooled_packets(room)))
+                evict(m_resend_window.push(packet));
+        }
+
+        if (const size_t evicted = m_resend_window.evictions() - evictions_before; evicted != 0)
+            Log::warn("evicted {} unacknowledged packets, {} in total", evicted, m_resend_window.evictions());
 
-        std::span<char> sig_span { end(serialization_buffer) - 128, end(serialization_buffer) };
+        std::span<Tele::Packet> pending_packets { begin(arr), m_resend_window.oldest(arr) };
 
-        Tele::to_chars(std::span(signature.r), sig_span.subspan(0, 64), std::endian::little);
-        Tele::to_chars(std::span(signature.s), sig_span.subspan(64, 64), std::endian::little);
+        PacketBatchBody body { pending_packets };
+        const size_t body_size = body.prepare();
 
         // clang-format off
-        TRY_OR_RET(2, extract_replies_from_range<Reply::HTTPReadyForData, Reply::Okay>(m_coordinator->send_command_async(this, Command::HTTPData { .data = { serialization_buffer } })));
+        TRY_OR_RET(2, extract_replies_from_range<Reply::HTTPReadyForData, Reply::Okay>(m_coordinator->send_command_async(this, Command::HTTPData { .body_writer = &body, .body_size = body_size })));
         TRY_OR_RET(2, extract_replies_from_range<Reply::Okay>(m_coordinator->send_command_async(this, Command::HTTPMakeRequest { HTTPRequestType::POST })));
         TRY_OR_RET(2, wait_for_http());
-        TRY_OR_RET(2, extract_replies_from_range<Reply::Okay>(m_coordinator->send_command_async(this, Command::HTTPRead { })));
         // clang-format on
+
+        std::vector<Reply::reply_type> replies = m_coordinator->send_command_async(this, Command::HTTPRead {});
+        if (replies.empty() || !std::holds_alternative<Reply::Okay>(replies.back()))
+            return 2;
+
+        for (Reply::reply_type const& reply : replies) {
+            if (auto const* ack = std::get_if<Reply::PacketAck>(&reply)) {
+                m_resend_window.acknowledge(ack->first_sequence_id, ack->last_sequence_id);
+                m_packet_forger.acknowledge_spooled(ack->first_sequence_id, ack->last_sequence_id);
+            }
+        }
     }
     m_coordinator->send_command_async(this, Command::HTTPTerm {});
 
@@ -229,7 +345,8 @@ int MainModule::main() {
         return 2;
     }
 
-    m_packet_forger.reset_sequencer(initial_vector);
+    // sequence ids start over with the new session, the unacknowledged packets are given new ones
+    m_packet_forger.reset_sequencer(initial_vector, m_resend_window);
 
     auto reinitialize_device = [&] {
         for (size_t i = 0;; i++) {
@@ -2,28 +2,70 @@
 
 #include <queue.h>
 
-#include <random>
+#include <Tele/Log.hpp>
+#include <Tele/Stream.hpp>
+
+#include <secrets.hpp>
 
 namespace Tele {
 
-PacketForgerTask::PacketForgerTask(DataCollectorTask& data_collector)
+static constexpr PacketEncoding k_packet_full_encoding = parse_packet_encoding(Config::Endpoints::packet_full_encoding);
+
+// JSON spells every digit out, quantizing only pays off with the binary encodings
+static constexpr bool k_quantize_full_packets = k_packet_full_encoding != PacketEncoding::JSON;
+
+// the columnar encoding already codes unchanged fields in a bit
+static constexpr bool k_sparse_full_packets = k_packet_full_encoding == PacketEncoding::Binary;
+
+PacketForgerTask::PacketForgerTask(DataCollectorTask& data_collector, CANTask& can_task, FlashSpool& spool)
     : m_data_collector(data_collector)
+    , m_can_task(can_task)
     , m_sequencer_mutex(xSemaphoreCreateMutex())
     // , m_packet_queue(xQueueCreate(queue_size, sizeof(queue_item)))
-    , m_packet_queue(xQueueCreateStatic(queue_size, sizeof(queue_item), data(m_static_queue_storage), &m_static_queue)
-      ) { }
+    , m_packet_queue(xQueueCreateStatic(queue_size, sizeof(queue_item), data(m_static_queue_storage), &m_static_queue))
+    , m_spool(spool)
+    , m_spool_mutex(xSemaphoreCreateMutexStatic(&m_static_spool_mutex)) { }
 
-PacketForgerTask::~PacketForgerTask() { vSemaphoreDelete(m_sequencer_mutex); }
+PacketForgerTask::~PacketForgerTask() {
+    vSemaphoreDelete(m_spool_mutex);
+    vSemaphoreDelete(m_sequencer_mutex);
+}
 
-void PacketForgerTask::reset_sequencer(std::span<uint32_t, 4> rng_iv) {
-    /*if (xSemaphoreTake(m_sequencer_mutex, portMAX_DELAY) != pdTRUE) {
-        throw std::runtime_error("xSemaphoreTake");
-    }
+void PacketForgerTask::reset_sequencer(std::span<uint32_t, 4> rng_iv, PacketResendWindow& unacknowledged) {
+    xSemaphoreTake(m_spool_mutex, portMAX_DELAY);
+    Stf::ScopeExit mutex_guard { [this] { xSemaphoreGive(m_spool_mutex); } };
 
-    Stf::ScopeExit sema_guard { [this] { xSemaphoreGive(m_sequencer_mutex); } };*/
+    xSemaphoreTake(m_sequencer_mutex, portMAX_DELAY);
+    Stf::ScopeExit sema_guard { [this] { xSemaphoreGive(m_sequencer_mutex); } };
 
-    m_sequencer_ready = true;
     m_sequencer.reset(rng_iv);
+
+    // both windows are oldest first and the spooled packets are a subsequence of the resend window, the sequence ids
+    // keep increasing in either
+    size_t spooled = 0;
+    std::array<SpooledPacket, PacketResendWindow::capacity> awaited;
+    const size_t awaited_count = m_spooled_packets.oldest(awaited);
+
+    unacknowledged.for_each([&](Packet& packet) {
+        const Packet resequenced = m_sequencer.resequence(packet);
+
+        if (spooled != awaited_count && awaited[spooled].sequence_id == packet.sequence_id)
+            awaited[spooled++].sequence_id = resequenced.sequence_id;
+
+        packet = resequenced;
+    });
+
+    m_spooled_packets.clear();
+    for (SpooledPacket const& entry : std::span(awaited).first(spooled))
+        std::ignore = m_spooled_packets.push(entry);
+
+    // the spooled packets that are not in the resend window anymore are taken again
+    if (spooled != awaited_count) {
+        m_spool.rewind();
+        m_spooled_packets.clear();
+    }
+
+    m_sequencer_ready = true;
 }
 
 size_t PacketForgerTask::get_pending_packets(std::span<Packet> out) {
@@ -44,23 +86,150 @@ size_t PacketForgerTask::get_pending_packets(std::span<Packet> out) {
     return std::distance(begin, ptr);
 }
 
-[[noreturn]] void PacketForgerTask::operator()() {
-    for (;;) {
-        /*if (xSemaphoreTake(m_sequencer_mutex, portMAX_DELAY) != pdTRUE) {
-            throw std::runtime_error("xSemaphoreTake");
+size_t PacketForgerTask::get_spooled_packets(std::span<Packet> out) {
+    if (!m_sequencer_ready)
+        return 0;
+
+    xSemaphoreTake(m_spool_mutex, portMAX_DELAY);
+    Stf::ScopeExit mutex_guard { [this] { xSemaphoreGive(m_spool_mutex); } };
+
+    xSemaphoreTake(m_sequencer_mutex, portMAX_DELAY);
+    Stf::ScopeExit sema_guard { [this] { xSemaphoreGive(m_sequencer_mutex); } };
+
+    std::array<uint8_t, spool_record_size> buffer;
+    size_t count = 0;
+
+    while (count != out.size() && m_spool.unread() != 0 && m_spooled_packets.room() != 0) {
+        uint32_t ticket;
+        auto length = m_spool.read(buffer, ticket);
+        if (!length) {
+            Log::warn("could not read from the spool: {}", length.error());
+            break;
+        }
+
+        BinaryReader reader { std::span(buffer).first(*length) };
+        if (auto res = reader.read(out[count]); !res) {
+            // never awaited, it is consumed along with the packets taken before it
+            Log::warn("dropping a spooled packet: {}", res.error());
+            continue;
+        }
+
+        out[count] = m_sequencer.resequence(out[count]);
+        std::ignore = m_spooled_packets.push({ out[count].sequence_id, ticket });
+        count++;
+    }
+
+    consume_spooled();
+
+    return count;
+}
+
+void PacketForgerTask::acknowledge_spooled(uint32_t first, uint32_t last) {
+    xSemaphoreTake(m_spool_mutex, portMAX_DELAY);
+    Stf::ScopeExit mutex_guard { [this] { xSemaphoreGive(m_spool_mutex); } };
+
+    if (m_spooled_packets.acknowledge(first, last) != 0)
+        consume_spooled();
+}
+
+void PacketForgerTask::consume_spooled() {
+    std::array<SpooledPacket, 1> awaited;
+    const bool awaiting = m_spooled_packets.oldest(awaited) != 0;
+
+    // records read before the oldest awaited one were acknowledged, undecodable or dropped by the spool already
+    while (m_spool.unread() != m_spool.pending() && (!awaiting || m_spool.oldest_ticket() < awaited[0].ticket)) {
+        if (auto res = m_spool.pop(); !res) {
+            Log::warn("could not pop from the spool: {}", res.error());
+            break;
         }
+    }
+}
+
+FlashSpool::Statistics PacketForgerTask::spool_statistics() {
+    xSemaphoreTake(m_spool_mutex, portMAX_DELAY);
+    Stf::ScopeExit mutex_guard { [this] { xSemaphoreGive(m_spool_mutex); } };
+
+    return m_spool.statistics();
+}
+
+void PacketForgerTask::spool_packet(Packet const& packet) {
+    CountingStream counter {};
+    BinaryWriter { counter }.write(packet);
+
+    if (counter.size() > spool_record_size) {
+        Log::warn("a packet of {} bytes is too large to spool", counter.size());
+        return;
+    }
+
+    std::array<char, spool_record_size> buffer;
+    BufCharStream stream { buffer };
+    BinaryWriter { stream }.write(packet);
 
-        Stf::ScopeExit sema_guard { [this] { xSemaphoreGive(m_sequencer_mutex); } };*/
+    const std::string_view encoded = stream;
 
+    xSemaphoreTake(m_spool_mutex, portMAX_DELAY);
+    Stf::ScopeExit mutex_guard { [this] { xSemaphoreGive(m_spool_mutex); } };
+
+    const auto payload = std::span(reinterpret_cast<uint8_t const*>(encoded.data()), encoded.size());
+    if (auto res = count_fifo_overruns([&] { return m_spool.append(payload); }); !res)
+        Log::warn("could not spool a packet: {}", res.error());
+}
+
+void PacketForgerTask::prepare_spool() {
+    xSemaphoreTake(m_spool_mutex, portMAX_DELAY);
+    Stf::ScopeExit mutex_guard { [this] { xSemaphoreGive(m_spool_mutex); } };
+
+    if (auto res = count_fifo_overruns([this] { return m_spool.prepare(); }); !res)
+        Log::warn("could not prepare the spool: {}", res.error());
+}
+
+[[noreturn]] void PacketForgerTask::operator()() {
+    {
+        xSemaphoreTake(m_spool_mutex, portMAX_DELAY);
+        Stf::ScopeExit mutex_guard { [this] { xSemaphoreGive(m_spool_mutex); } };
+
+        // these get their sequence IDs under the new session once taken
+        if (const size_t recovered = m_spool.recover(); recovered != 0)
+            Log::info("recovered {} packets spooled before the reset", recovered);
+    }
+
+    for (;;) {
         if (!m_sequencer_ready) {
             vTaskDelay(1);
             continue;
         }
 
         TickType_t last_tick = xTaskGetTickCount();
-        Packet packet = m_sequencer.sequence(produce_full_packet());
-
-        xQueueSend(m_packet_queue, &packet, 0);
+        FullPacket full_packet = produce_full_packet();
+
+        packets_variant data;
+        if constexpr (k_quantize_full_packets)
+            data = quantize<QuantizedFullPacket>(full_packet);
+        else
+            data = full_packet;
+
+        // spooled packets are sequenced once taken out, so whatever gets queued keeps contiguous sequence IDs. the
+        // forger is the only one queueing, the space checked here can't be taken in the meantime.
+        if (!m_link_up || uxQueueSpacesAvailable(m_packet_queue) == 0) {
+            spool_packet(PacketSequencer::stamp(data));
+        } else {
+            Packet packet;
+            {
+                xSemaphoreTake(m_sequencer_mutex, portMAX_DELAY);
+                Stf::ScopeExit sema_guard { [this] { xSemaphoreGive(m_sequencer_mutex); } };
+
+                if (m_keyframe_requested.exchange(false))
+                    m_sequencer.request_keyframe();
+
+                if constexpr (k_sparse_full_packets)
+                    packet = m_sequencer.sequence_sparse(std::get<QuantizedFullPacket>(data));
+                else
+                    packet = m_sequencer.sequence(data);
+            }
+
+            xQueueSend(m_packet_queue, &packet, 0);
+            prepare_spool();
+        }
 
         static auto smooth_step = [](float t) {
             if (t <= 0.f)
@@ -80,7 +249,12 @@ size_t PacketForgerTask::get_pending_packets(std::span<Packet> out) {
 
         const float t = Stf::inv_lerp(fill_ratio, smooth_step_start, smooth_step_end);
         const float ss_res = smooth_step(t);
-        const float delay_secs = (1.f - ss_res) * min_delay + ss_res * max_delay;
+
+        // every sensor went quiet (the vehicle is off, the CAN bus is down etc.), don't spend the uplink on repeats
+        static constexpr uint32_t stored_fields = decltype(_tele_adl_channel_binder(FullPacket {}))::stored_mask();
+        const bool all_stale = (full_packet.stale_fields & stored_fields) == stored_fields;
+
+        const float delay_secs = all_stale ? max_delay : (1.f - ss_res) * min_delay + ss_res * max_delay;
 
         /*
          * Calculate queue size in seconds:
@@ -104,53 +278,14 @@ size_t PacketForgerTask::get_pending_packets(std::span<Packet> out) {
 }
 
 FullPacket PacketForgerTask::produce_full_packet() {
-    HeapStats_t heap_stats;
-    vPortGetHeapStats(&heap_stats);
-
-    std::minstd_rand engine { std::random_device {}() };
-    std::uniform_real_distribution<float> rand { 0.f, 1.f };
-
-    float engine_rpm = m_data_collector.get<float>("engine_rpm");
-    const float diameter_mm = 288.f;
-
-    const float circumference = diameter_mm * 2 * std::numbers::pi_v<float>;
-    const float mm_per_minute = circumference * engine_rpm;
-    const float km_per_hour = mm_per_minute * 60.f / (1000.f * 1000.f);
-
-
-
     FullPacket packet {
-        .spent_mah = m_data_collector.get<float>("can_spent_mah"),
-        .spent_mwh = m_data_collector.get<float>("can_spent_mwh"),
-        .current = m_data_collector.get<float>("can_current"),
-        .soc_percent = m_data_collector.get<float>("can_soc_percent"),
-
         .hydro_current = 0.f,
-        .hydro_ppm = m_data_collector.get<float>("can_hydro_ppm", 3.1415926f),
-        .hydro_temp = m_data_collector.get<float>("can_hydro_temp", 3.1415926f),
-
-        .rpm = m_data_collector.get<float>("engine_rpm"),
-        .speed = m_data_collector.get<float>("engine_speed"),
-
-        .longitude = m_data_collector.get<float>("gps_longitude"),
-        .latitude = m_data_collector.get<float>("gps_latitude"),
-
         .queue_fill_amt = uxQueueMessagesWaiting(m_packet_queue),
-        .tick_counter = m_data_collector.get<uint32_t>("hal_lf_ticks"),
-        .free_heap_space = m_data_collector.get<uint32_t>("rtos_heap_free"),
-        .amt_allocs = m_data_collector.get<uint32_t>("rtos_heap_allocations"),
-        .amt_frees = m_data_collector.get<uint32_t>("rtos_heap_deallocations"),
         .cpu_usage = 3.1415926f,
     };
 
-    auto battery_voltages = m_data_collector.get_array<float, 27>("can_battery_voltage");
-    auto battery_temperatures = m_data_collector.get_array<float, 5>("can_battery_temp");
-
-    std::copy(begin(battery_voltages), end(battery_voltages), std::begin(packet.battery_voltages));
-    std::copy(begin(battery_temperatures), end(battery_temperatures), std::begin(packet.battery_temps));
-
-    // std::generate(std::begin(packet.battery_voltages), std::end(packet.battery_voltages), [&] { return rand(engine); });
-    // std::generate(std::begin(packet.battery_temps), std::end(packet.battery_temps), [&] { return rand(engine); });
+    // stale fields are left zeroed and flagged
+    packet.stale_fields = m_data_collector.snapshot(packet);
 
     return packet;
 }
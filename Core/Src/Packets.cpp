@@ -1,8 +1,7 @@
 #include <Packets.hpp>
 
 #include <chrono>
-
-#include <Globals.hpp>
+#include <utility>
 
 #include <Tele/CharConv.hpp>
 #include <Tele/Stream.hpp>
@@ -43,25 +42,48 @@ namespace Tele {
     return { serialization_buffer, packet };
 }*/
 
-Packet PacketSequencer::sequence(Tele::packets_variant inner) {
+Packet PacketSequencer::stamp(Tele::packets_variant inner) {
     int32_t timestamp
       = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 
-    Packet packet {
-        .sequence_id = m_last_seq_id++,
+    return Packet {
+        .sequence_id = 0,
         .timestamp = timestamp,
-        .rng_state = xoshiro_next(m_rng_state),
+        .rng_state = 0,
         .data = inner,
     };
+}
+
+Packet PacketSequencer::sequence(Tele::packets_variant inner) { return resequence(stamp(inner)); }
 
-    // TODO: save packet in a resend window
+Packet PacketSequencer::resequence(Packet packet) {
+    packet.sequence_id = m_last_seq_id++;
+    packet.rng_state = xoshiro_next(m_rng_state);
 
     return packet;
 }
 
+Packet PacketSequencer::sequence_sparse(QuantizedFullPacket const& packet) {
+    const bool keyframe = m_keyframe_requested || m_packets_since_keyframe >= keyframe_interval;
+    const QuantizedFullPacket previous = std::exchange(m_last_full_packet, packet);
+
+    if (keyframe) {
+        m_keyframe_requested = false;
+        m_packets_since_keyframe = 0;
+
+        return sequence(packet);
+    }
+
+    m_packets_since_keyframe++;
+
+    return sequence(SparseFullPacket::changes(previous, packet));
+}
+
 void PacketSequencer::reset(std::span<uint32_t, 4> rng_vector) {
     m_last_seq_id = 0;
     copy(begin(rng_vector), end(rng_vector), m_rng_state);
+
+    m_keyframe_requested = true;
 }
 
 }
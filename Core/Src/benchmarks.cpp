@@ -4,19 +4,40 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
 #include <functional>
+#include <memory>
+#include <numbers>
+#include <numeric>
+#include <optional>
 #include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/format.h>
 
 #include <p256.hpp>
+#include <Stuff/Maths/Bit.hpp>
 #include <Stuff/Maths/Hash/Sha2.hpp>
 
 #include <main.h>
+#include <Packets.hpp>
 #include <secrets.hpp>
 #include <stdcompat.hpp>
+#include <tests.hpp>
 
+#include <Tele/CANTask.hpp>
 #include <Tele/CharConv.hpp>
+#include <Tele/DataCollector.hpp>
+#include <Tele/Kernels.hpp>
+#include <Tele/Log.hpp>
 #include <Tele/Parsers.hpp>
+#include <Tele/Quantization.hpp>
 #include <Tele/STUtilities.hpp>
+#include <Tele/Stream.hpp>
 
 namespace Tele {
 
@@ -113,6 +134,773 @@ void p256_test(P256::PrivateKey const& sk) {
     }
 }
 
+/// The string keyed store DataCollectorTask used to be, kept here as a baseline.
+/// Keys are owned by the map as the old `set_array` used to leave dangling `string_view`s behind.
+struct LegacyMapCollector {
+    void set(std::string_view key, float v) {
+        lock();
+        m_float_map[std::string(key)] = static_cast<double>(v);
+        unlock();
+    }
+
+    void set_array(std::string_view key_base, std::span<const float> vs, size_t offset = 0) {
+        for (size_t i = 0; auto v : vs) {
+            set(fmt::format("{}_{}", key_base, offset + i++), v);
+        }
+    }
+
+    float get(std::string_view key, float def = 0.f) {
+        lock();
+        float ret = def;
+        if (auto it = m_float_map.find(std::string(key)); it != m_float_map.end()) {
+            ret = it->second;
+        }
+        unlock();
+        return ret;
+    }
+
+    void get_array(std::string_view key_base, std::span<float> vs) {
+        for (size_t i = 0; auto& v : vs) {
+            v = get(fmt::format("{}_{}", key_base, i++));
+        }
+    }
+
+private:
+    SemaphoreHandle_t m_mutex = xSemaphoreCreateMutex();
+    std::unordered_map<std::string, double> m_float_map {};
+
+    void lock() const { xSemaphoreTake(m_mutex, portMAX_DELAY); }
+
+    void unlock() const { xSemaphoreGive(m_mutex); }
+};
+
+void data_collector_benchmark() {
+    static LegacyMapCollector s_legacy {};
+    static DataCollectorTask s_collector {};
+
+    std::array<float, 8> cells { 3.6f, 3.7f, 3.8f, 3.9f, 4.0f, 4.1f, 4.2f, 4.3f };
+
+    // a BMS frame worth of writes
+    auto bench_fn_legacy_set = [&cells] {
+        s_legacy.set_array("can_battery_voltage", cells, 8);
+        s_legacy.set("can_current", cells[0]);
+        return cells[0];
+    };
+
+    auto bench_fn_channel_set = [&cells] {
+        s_collector.set_array<float>(Channels::can_battery_voltage, cells, 8);
+        s_collector.set(Channels::can_current, cells[0]);
+        return cells[0];
+    };
+
+    // a FullPacket worth of reads (less the scalars)
+    auto bench_fn_legacy_get = [] {
+        std::array<float, 27> voltages;
+        std::array<float, 5> temperatures;
+        s_legacy.get_array("can_battery_voltage", voltages);
+        s_legacy.get_array("can_battery_temp", temperatures);
+        return voltages[0] + temperatures[0] + s_legacy.get("can_current");
+    };
+
+    auto bench_fn_channel_get = [] {
+        auto voltages = s_collector.get_array(Channels::can_battery_voltage);
+        auto temperatures = s_collector.get_array(Channels::can_battery_temp);
+        return voltages[0] + temperatures[0] + s_collector.get(Channels::can_current);
+    };
+
+    std::array<double, 4> results { {
+      benchmark_func(bench_fn_legacy_set, 256),
+      benchmark_func(bench_fn_channel_set, 256),
+      benchmark_func(bench_fn_legacy_get, 256),
+      benchmark_func(bench_fn_channel_get, 256),
+    } };
+
+    do_not_optimize(results);
+
+    // breakpoint here
+    std::ignore = 0;
+}
+
+void battery_aggregate_benchmark() {
+    static DataCollectorTask s_collector {};
+
+    std::array<float, 8> cells { 3.6f, 3.7f, 3.8f, 3.9f, 4.0f, 4.1f, 4.2f, 4.3f };
+    size_t frame = 0;
+
+    // a BMS frame, the aggregates are updated as a part of the write
+    auto bench_fn_incremental = [&] {
+        cells[frame % 8] += 0.01f;
+        s_collector.set_array<float>(Channels::can_battery_voltage, cells, (frame++ % 4) * 8);
+
+        return s_collector.get(Channels::can_battery_voltage_min);
+    };
+
+    // a BMS frame followed by what the consumers used to do
+    auto bench_fn_recompute = [&] {
+        cells[frame % 8] += 0.01f;
+        s_collector.set_array<float>(Channels::can_battery_voltage, cells, (frame++ % 4) * 8);
+
+        const auto voltages = s_collector.get_array(Channels::can_battery_voltage);
+        const auto sum = std::reduce(voltages.cbegin(), voltages.cbegin() + k_battery_cell_count);
+        const auto [min, max] = std::minmax_element(voltages.cbegin(), voltages.cbegin() + k_battery_cell_count);
+
+        return sum + *min + *max;
+    };
+
+    std::array<double, 2> results { {
+      benchmark_func(bench_fn_incremental, 256),
+      benchmark_func(bench_fn_recompute, 256),
+    } };
+
+    do_not_optimize(results);
+
+    // breakpoint here
+    std::ignore = 0;
+}
+
+/// The switch based decoder that `CANMessageTable` replaced, with its fallthroughs fixed, kept as a baseline.
+static void legacy_process_can_rx(DataCollectorTask& collector, uint16_t id, std::span<const uint8_t> data) {
+    float temp_f;
+    float engine_temperature;
+
+    auto read_battery_voltages = [data](std::span<float> out) {
+        for (size_t i = 0; float& f : out) {
+            f = Stf::map<float>(data[i++], 0, 255, 2.4, 4.3);
+        }
+    };
+
+    switch (id) {
+    case static_cast<uint16_t>(CANIDs::EngineRPMTemp):
+        if (data.size() != 8)
+            break;
+
+        std::memcpy(&temp_f, data.data(), sizeof(float));
+        std::memcpy(&engine_temperature, data.data() + sizeof(float), sizeof(float));
+
+        static constexpr float diameter_mm = 288.f;
+        static constexpr float circumference_mm = diameter_mm * 2 * std::numbers::pi_v<float>;
+
+        collector.publish([temp_f, engine_temperature](DataCollectorTask::Writer& writer) {
+            writer.set(Channels::engine_rpm, temp_f);
+            writer.set(Channels::engine_speed, (circumference_mm * temp_f) * 60.f / (1000.f * 1000.f));
+            writer.set(Channels::engine_temperature, engine_temperature);
+        });
+        break;
+
+    case static_cast<uint16_t>(CANIDs::BMS1):
+    case static_cast<uint16_t>(CANIDs::BMS2):
+    case static_cast<uint16_t>(CANIDs::BMS3):
+    case static_cast<uint16_t>(CANIDs::BMS4): {
+        std::array<float, 8> voltages_buffer {};
+        read_battery_voltages(voltages_buffer);
+
+        size_t bms_idx = id - static_cast<uint16_t>(CANIDs::BMS1);
+        size_t stride = bms_idx * 8;
+
+        size_t cur_excess
+          = (stride + 8 < k_battery_cell_count) ? 0 : std::min(8uz, stride + 8 - k_battery_cell_count);
+        for (size_t i = 0; i < cur_excess; i++) {
+            voltages_buffer[7 - i] = 0.f;
+        }
+
+        std::array<float, 5> temperatures {};
+        const bool have_temperatures = id == static_cast<uint16_t>(CANIDs::BMS4);
+        if (have_temperatures) {
+            for (size_t i = 0; auto& f : temperatures) {
+                f = Stf::map<float>(data[i++ + 3], 0, 255, 0, 100);
+            }
+        }
+
+        collector.publish([&](DataCollectorTask::Writer& writer) {
+            writer.set_array<float>(Channels::can_battery_voltage, voltages_buffer, stride);
+
+            if (have_temperatures)
+                writer.set_array<float>(Channels::can_battery_temp, temperatures);
+        });
+    } break;
+
+    case static_cast<uint16_t>(CANIDs::BMS5): {
+        uint16_t raw_mah = Stf::convert_endian(*reinterpret_cast<const uint16_t*>(data.data()), std::endian::big);
+        uint16_t raw_mwh = Stf::convert_endian(*reinterpret_cast<const uint16_t*>(data.data() + 2), std::endian::big);
+        uint16_t raw_current
+          = Stf::convert_endian(*reinterpret_cast<const uint16_t*>(data.data() + 4), std::endian::big);
+        uint16_t raw_percent
+          = Stf::convert_endian(*reinterpret_cast<const uint16_t*>(data.data() + 6), std::endian::big);
+        collector.publish([&](DataCollectorTask::Writer& writer) {
+            writer.set(Channels::can_spent_mah, Stf::map<float>(raw_mah, 0, 65535, 0, 15000));
+            writer.set(Channels::can_spent_mwh, Stf::map<float>(raw_mwh, 0, 65535, 0, 15000 * 256));
+            writer.set(Channels::can_current, Stf::map<float>(raw_current, 0, 65535, -10, 50));
+            writer.set(Channels::can_soc_percent, Stf::map<float>(raw_percent, 0, 65535, -5, 105));
+        });
+    } break;
+
+    case static_cast<uint16_t>(CANIDs::Hydrogen): {
+        collector.publish([data](DataCollectorTask::Writer& writer) {
+            writer.set(Channels::can_hydro_ppm, data[0]);
+            writer.set(Channels::can_hydro_temp, data[1]);
+        });
+    } break;
+
+    default: break;
+    }
+}
+
+void can_decode_benchmark() {
+    static DataCollectorTask s_collector {};
+    static CANDecodeState s_decode_state {};
+
+    const float rpm = 1234.5f;
+    const float engine_temperature = 56.7f;
+
+    std::array<CANFrame, 7> frames { {
+      { .id = static_cast<uint16_t>(CANIDs::EngineRPMTemp), .length = 8 },
+      { .id = static_cast<uint16_t>(CANIDs::BMS1), .length = 8, .data = { 200, 201, 202, 203, 204, 205, 206, 207 } },
+      { .id = static_cast<uint16_t>(CANIDs::BMS2), .length = 8, .data = { 210, 211, 212, 213, 214, 215, 216, 217 } },
+      { .id = static_cast<uint16_t>(CANIDs::BMS3), .length = 8, .data = { 220, 221, 222, 223, 224, 225, 226, 227 } },
+      { .id = static_cast<uint16_t>(CANIDs::BMS4), .length = 8, .data = { 230, 231, 232, 100, 101, 102, 103, 104 } },
+      { .id = static_cast<uint16_t>(CANIDs::BMS5), .length = 8, .data = { 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0 } },
+      { .id = static_cast<uint16_t>(CANIDs::Hydrogen), .length = 2, .data = { 12, 34 } },
+    } };
+
+    std::memcpy(frames[0].data.data(), &rpm, sizeof(float));
+    std::memcpy(frames[0].data.data() + sizeof(float), &engine_temperature, sizeof(float));
+
+    size_t frame_no = 0;
+
+    auto bench_fn_table = [&] {
+        CANFrame const& frame = frames[frame_no++ % frames.size()];
+        return CANMessageTable::decode(
+          frame.id, std::span(frame.data.data(), frame.length), s_collector, s_decode_state
+        );
+    };
+
+    auto bench_fn_switch = [&] {
+        CANFrame const& frame = frames[frame_no++ % frames.size()];
+        legacy_process_can_rx(s_collector, frame.id, std::span(frame.data.data(), frame.length));
+        return frame.id;
+    };
+
+    // both decoders must agree on every channel, up to rounding
+    static DataCollectorTask s_switch_collector {};
+
+    for (CANFrame const& frame : frames) {
+        const auto data = std::span(frame.data.data(), frame.length);
+        std::ignore = CANMessageTable::decode(frame.id, data, s_collector, s_decode_state);
+        legacy_process_can_rx(s_switch_collector, frame.id, data);
+    }
+
+    auto close = [](float lhs, float rhs) { return std::abs(lhs - rhs) <= 1e-4f * std::max(1.f, std::abs(rhs)); };
+
+    bool agree = std::ranges::equal(
+      s_collector.get_array(Channels::can_battery_voltage), s_switch_collector.get_array(Channels::can_battery_voltage),
+      close
+    );
+    agree &= std::ranges::equal(
+      s_collector.get_array(Channels::can_battery_temp), s_switch_collector.get_array(Channels::can_battery_temp), close
+    );
+
+    for (auto channel : { Channels::engine_rpm, Channels::engine_speed, Channels::engine_temperature,
+                          Channels::can_spent_mah, Channels::can_spent_mwh, Channels::can_current,
+                          Channels::can_soc_percent, Channels::can_hydro_ppm, Channels::can_hydro_temp }) {
+        agree &= close(s_collector.get(channel), s_switch_collector.get(channel));
+    }
+
+    do_not_optimize(agree);
+
+    std::array<double, 2> results { {
+      benchmark_func(bench_fn_table, 256),
+      benchmark_func(bench_fn_switch, 256),
+    } };
+
+    do_not_optimize(results);
+
+    // breakpoint here
+    std::ignore = 0;
+}
+
+void kernels_benchmark() {
+    std::mt19937 engine { 1234 };
+    std::uniform_int_distribution<uint32_t> byte_dist { 0, 255 };
+
+    // a pack worth of cells
+    std::array<uint8_t, k_battery_cell_count> raw;
+    std::ranges::generate(raw, [&] { return static_cast<uint8_t>(byte_dist(engine)); });
+
+    std::array<float, k_battery_cell_count> cells;
+    std::array<uint8_t, k_battery_cell_count> quantized;
+
+    constexpr SignalLayout layout = SignalLayout { .start_bit = 0, .length = 8 }.with_range(2.4f, 4.3f);
+
+    auto bench_fn_scale_scalar = [&] {
+        raw[0]++;
+        Kernels::Scalar::scale_u8(raw, cells, layout.scale, layout.offset);
+        return cells[0];
+    };
+
+    auto bench_fn_scale = [&] {
+        raw[0]++;
+        Kernels::scale_u8(raw, cells, layout.scale, layout.offset);
+        return cells[0];
+    };
+
+    auto bench_fn_reduce_scalar = [&] {
+        raw[0]++;
+        return Kernels::Scalar::reduce_u8(raw).sum;
+    };
+
+    auto bench_fn_reduce = [&] {
+        raw[0]++;
+        return Kernels::reduce_u8(raw).sum;
+    };
+
+    auto bench_fn_reduce_float = [&] {
+        cells[0] += 0.01f;
+        return Kernels::reduce(cells).sum;
+    };
+
+    auto bench_fn_quantize_scalar = [&] {
+        cells[0] += 0.01f;
+        Kernels::Scalar::quantize_u8(cells, quantized, layout.scale, layout.offset);
+        return quantized[0];
+    };
+
+    auto bench_fn_quantize = [&] {
+        cells[0] += 0.01f;
+        Kernels::quantize_u8(cells, quantized, layout.scale, layout.offset);
+        return quantized[0];
+    };
+
+    std::array<double, 7> results { {
+      benchmark_func(bench_fn_scale_scalar, 256),
+      benchmark_func(bench_fn_scale, 256),
+      benchmark_func(bench_fn_reduce_scalar, 256),
+      benchmark_func(bench_fn_reduce, 256),
+      benchmark_func(bench_fn_reduce_float, 256),
+      benchmark_func(bench_fn_quantize_scalar, 256),
+      benchmark_func(bench_fn_quantize, 256),
+    } };
+
+    do_not_optimize(results);
+
+    // breakpoint here
+    std::ignore = 0;
+}
+
+void packet_encoding_benchmark() {
+    std::array<Packet, 10> packets = make_packet_batch();
+
+    std::array<Packet, 10> quantized_packets = packets;
+    for (Packet& packet : quantized_packets)
+        packet.data = quantize<QuantizedFullPacket>(std::get<FullPacket>(packet.data));
+
+    std::string json_buffer;
+    std::string binary_buffer;
+    std::string quantized_buffer;
+
+    auto bench_fn_json = [&] {
+        json_buffer.clear();
+        PushBackStream stream { json_buffer };
+        Stf::Serde::JSON::Serializer<PushBackStream<std::string>> serializer { stream };
+        Stf::serialize(serializer, std::span<Packet>(packets));
+        return json_buffer.size();
+    };
+
+    auto bench_fn_binary = [&] {
+        binary_buffer.clear();
+        PushBackStream stream { binary_buffer };
+        write_binary_batch(stream, packets);
+        return binary_buffer.size();
+    };
+
+    auto bench_fn_quantize = [&] {
+        QuantizedFullPacket quantized = quantize<QuantizedFullPacket>(std::get<FullPacket>(packets[0].data));
+        return quantized.battery_voltages[0].data;
+    };
+
+    auto bench_fn_quantized_binary = [&] {
+        quantized_buffer.clear();
+        PushBackStream stream { quantized_buffer };
+        write_binary_batch(stream, quantized_packets);
+        return quantized_buffer.size();
+    };
+
+    // milliseconds per batch of ten, quantization per packet
+    std::array<double, 4> results { {
+      benchmark_func(bench_fn_json, 8),
+      benchmark_func(bench_fn_binary, 8),
+      benchmark_func(bench_fn_quantize, 256),
+      benchmark_func(bench_fn_quantized_binary, 8),
+    } };
+
+    std::array<size_t, 3> sizes { json_buffer.size(), binary_buffer.size(), quantized_buffer.size() };
+
+    do_not_optimize(results);
+    do_not_optimize(sizes);
+
+    // breakpoint here
+    std::ignore = 0;
+}
+
+void digest_stream_benchmark() {
+    // JSON being the larger encoding is where a second pass hurts the most
+    std::array<Packet, 10> packets = make_packet_batch();
+
+    std::string buffer;
+    std::array<std::array<uint32_t, 8>, 3> hashes;
+
+    // serialize, then hash the buffer
+    auto bench_fn_two_pass = [&] {
+        buffer.clear();
+        PushBackStream stream { buffer };
+        Stf::Serde::JSON::Serializer<PushBackStream<std::string>> serializer { stream };
+        Stf::serialize(serializer, std::span<Packet>(packets));
+
+        Stf::Hash::SHA256State hash_state {};
+        hash_state.update(std::string_view { buffer });
+        hashes[0] = hash_state.finish();
+        return hashes[0][0];
+    };
+
+    // hash every write on its way into the buffer
+    auto bench_fn_digest = [&] {
+        buffer.clear();
+        PushBackStream sink { buffer };
+        Stf::Hash::SHA256State hash_state {};
+        DigestStream stream { sink, hash_state };
+        Stf::Serde::JSON::Serializer<decltype(stream)> serializer { stream };
+        Stf::serialize(serializer, std::span<Packet>(packets));
+
+        hashes[1] = hash_state.finish();
+        return hashes[1][0];
+    };
+
+    // what PacketBatchBody::prepare does, nothing is buffered beyond a chunk
+    auto bench_fn_chunked_digest = [&] {
+        CountingStream counter {};
+        Stf::Hash::SHA256State hash_state {};
+        DigestStream digest_stream { counter, hash_state };
+
+        auto sink = [&](std::string_view chunk) { digest_stream << chunk; };
+        ChunkedStream<64, decltype(sink)> stream { sink };
+        Stf::Serde::JSON::Serializer<decltype(stream)> serializer { stream };
+        Stf::serialize(serializer, std::span<Packet>(packets));
+        stream.flush();
+
+        hashes[2] = hash_state.finish();
+        return counter.size();
+    };
+
+    // milliseconds per batch of ten
+    std::array<double, 3> results { {
+      benchmark_func(bench_fn_two_pass, 8),
+      benchmark_func(bench_fn_digest, 8),
+      benchmark_func(bench_fn_chunked_digest, 8),
+    } };
+
+    bool hashes_match = hashes[0] == hashes[1] && hashes[0] == hashes[2];
+
+    do_not_optimize(results);
+    do_not_optimize(hashes_match);
+
+    // breakpoint here, hashes_match must be true
+    std::ignore = 0;
+}
+
+void columnar_encoding_benchmark() {
+    std::array<Packet, 10> packets = make_packet_series();
+
+    std::array<Packet, 10> quantized_packets = packets;
+    for (Packet& packet : quantized_packets)
+        packet.data = quantize<QuantizedFullPacket>(std::get<FullPacket>(packet.data));
+
+    std::array<std::string, 5> buffers;
+
+    auto bench_fn_json = [&] {
+        buffers[0].clear();
+        PushBackStream stream { buffers[0] };
+        Stf::Serde::JSON::Serializer<PushBackStream<std::string>> serializer { stream };
+        Stf::serialize(serializer, std::span<Packet>(packets));
+        return buffers[0].size();
+    };
+
+    auto bench_fn_binary = [&] {
+        buffers[1].clear();
+        PushBackStream stream { buffers[1] };
+        write_binary_batch(stream, packets);
+        return buffers[1].size();
+    };
+
+    auto bench_fn_columnar = [&] {
+        buffers[2].clear();
+        PushBackStream stream { buffers[2] };
+        write_columnar_batch(stream, packets);
+        return buffers[2].size();
+    };
+
+    auto bench_fn_quantized_binary = [&] {
+        buffers[3].clear();
+        PushBackStream stream { buffers[3] };
+        write_binary_batch(stream, quantized_packets);
+        return buffers[3].size();
+    };
+
+    auto bench_fn_quantized_columnar = [&] {
+        buffers[4].clear();
+        PushBackStream stream { buffers[4] };
+        write_columnar_batch(stream, quantized_packets);
+        return buffers[4].size();
+    };
+
+    // milliseconds per batch of ten
+    std::array<double, 5> results { {
+      benchmark_func(bench_fn_json, 8),
+      benchmark_func(bench_fn_binary, 8),
+      benchmark_func(bench_fn_columnar, 8),
+      benchmark_func(bench_fn_quantized_binary, 8),
+      benchmark_func(bench_fn_quantized_columnar, 8),
+    } };
+
+    // against JSON
+    std::array<float, 5> ratios;
+    std::ranges::transform(buffers, ratios.begin(), [&](std::string const& buffer) {
+        return static_cast<float>(buffers[0].size()) / static_cast<float>(buffer.size());
+    });
+
+    do_not_optimize(results);
+    do_not_optimize(ratios);
+
+    // breakpoint here
+    std::ignore = 0;
+}
+
+void resend_window_simulation() {
+    static constexpr std::array<float, 4> loss_rates { 0.f, 0.05f, 0.2f, 0.5f };
+
+    // per loss rate: the delivered fraction and the goodput without the window, then the same with it
+    std::array<std::array<float, 4>, loss_rates.size()> results;
+
+    for (size_t i = 0; i < loss_rates.size(); i++) {
+        const auto without = simulate_uplink(loss_rates[i], false);
+        const auto with = simulate_uplink(loss_rates[i], true);
+        results[i] = { without[0], without[1], with[0], with[1] };
+    }
+
+    do_not_optimize(results);
+
+    // breakpoint here
+    std::ignore = 0;
+}
+
+void packet_snapshot_benchmark() {
+    static DataCollectorTask s_collector {};
+
+    // what produce_full_packet used to do, one read section per field
+    auto bench_fn_per_field = [] {
+        FullPacket packet {
+            .spent_mah = s_collector.get(Channels::can_spent_mah),
+            .spent_mwh = s_collector.get(Channels::can_spent_mwh),
+            .current = s_collector.get(Channels::can_current),
+            .soc_percent = s_collector.get(Channels::can_soc_percent),
+            .hydro_ppm = s_collector.get(Channels::can_hydro_ppm),
+            .hydro_temp = s_collector.get(Channels::can_hydro_temp),
+            .rpm = s_collector.get(Channels::engine_rpm),
+            .speed = s_collector.get(Channels::engine_speed),
+            .longitude = s_collector.get(Channels::gps_longitude),
+            .latitude = s_collector.get(Channels::gps_latitude),
+            .tick_counter = s_collector.get(Channels::hal_lf_ticks),
+            .free_heap_space = s_collector.get(Channels::rtos_heap_free),
+            .amt_allocs = s_collector.get(Channels::rtos_heap_allocations),
+            .amt_frees = s_collector.get(Channels::rtos_heap_deallocations),
+        };
+
+        s_collector.get_array<float>(Channels::can_battery_voltage, packet.battery_voltages);
+        s_collector.get_array<float>(Channels::can_battery_temp, packet.battery_temps);
+
+        return packet.battery_voltages[0];
+    };
+
+    auto bench_fn_snapshot = [] {
+        FullPacket packet {};
+        s_collector.snapshot(packet);
+        return packet.battery_voltages[0];
+    };
+
+    std::array<double, 2> results { {
+      benchmark_func(bench_fn_per_field, 256),
+      benchmark_func(bench_fn_snapshot, 256),
+    } };
+
+    do_not_optimize(results);
+
+    // breakpoint here
+    std::ignore = 0;
+}
+
+static DataCollectorTask s_stress_collector {};
+static std::atomic_bool s_stress_stop = false;
+
+/// Publishes frames in which every cell voltage and the current carry the same counter.
+static void data_collector_stress_writer(void*) {
+    for (uint32_t frame = 0; !s_stress_stop.load(); frame++) {
+        std::array<float, 27> cells;
+        cells.fill(static_cast<float>(frame));
+
+        s_stress_collector.publish([&](DataCollectorTask::Writer& writer) {
+            writer.set_array<float>(Channels::can_battery_voltage, cells);
+            writer.set(Channels::can_current, static_cast<float>(frame));
+        });
+
+        vTaskDelay(1);
+    }
+
+    vTaskDelete(nullptr);
+}
+
+bool data_collector_stress_test() {
+    s_stress_stop = false;
+
+    const UBaseType_t own_priority = uxTaskPriorityGet(nullptr);
+
+    // both writers preempt the reader loop below
+    xTaskCreate(data_collector_stress_writer, "stress writer 0", 256, nullptr, own_priority + 1, nullptr);
+    xTaskCreate(data_collector_stress_writer, "stress writer 1", 256, nullptr, own_priority + 2, nullptr);
+
+    static constexpr size_t reads = 100'000;
+    size_t torn_reads = 0;
+
+    for (size_t i = 0; i < reads; i++) {
+        auto [cells, current] = s_stress_collector.read([](DataCollectorTask::Reader const& reader) {
+            std::array<float, 27> cells;
+            reader.get_array<float>(Channels::can_battery_voltage, cells);
+            return std::pair { cells, reader.get(Channels::can_current) };
+        });
+
+        if (std::any_of(begin(cells), end(cells), [current](float v) { return v != current; }))
+            ++torn_reads;
+    }
+
+    s_stress_stop = true;
+    // let the writers see it and delete themselves
+    vTaskDelay(2);
+
+    const uint32_t retries = s_stress_collector.read_retries();
+
+    if (torn_reads != 0) {
+        Log::error("{} of {} reads were torn, {} reads retried", torn_reads, reads, retries);
+        return false;
+    }
+
+    Log::info("no torn reads, {} reads retried", retries);
+    return true;
+}
+
+/// Feeds a `CANTask` frames as fast as a saturated 1 Mbit/s bus would deliver them and checks that none get lost.
+bool can_rx_line_rate_test() {
+    // 8 byte standard frames, 111 bits and a 3 bit interframe space (bit stuffing would only make it slower)
+    static constexpr uint32_t bits_per_frame = 114;
+    static constexpr uint32_t line_rate = 1'000'000;
+    static constexpr uint32_t total_frames = 20'000;
+
+    static constexpr std::array ids {
+        CANIDs::EngineRPMTemp, CANIDs::BMS1, CANIDs::BMS2, CANIDs::BMS3, CANIDs::BMS4, CANIDs::BMS5,
+    };
+
+    // the task has a sizeable static stack, don't keep it around outside of the test
+    auto collector = std::make_unique<DataCollectorTask>();
+    // never started, the task neither sends heartbeats nor reads the registers of a handle in this state
+    CAN_HandleTypeDef dummy_handle {};
+    auto task = std::make_unique<CANTask>(*collector, dummy_handle);
+    task->create("can rx test");
+
+    // we stand in for the RX ISR, we have to be able to preempt the CAN task
+    const UBaseType_t own_priority = uxTaskPriorityGet(nullptr);
+    vTaskPrioritySet(nullptr, uxTaskPriorityGet(task->handle()) + 1);
+
+    const TickType_t start = xTaskGetTickCount();
+
+    for (uint32_t sent = 0; sent < total_frames;) {
+        // frames are pushed in bursts, one tick's worth at a time, as if the CAN task was held off for a whole tick
+        vTaskDelay(1);
+
+        const uint64_t elapsed_ms = xTaskGetTickCount() - start;
+        const uint64_t due = std::min<uint64_t>(elapsed_ms * line_rate / 1000 / bits_per_frame, total_frames);
+
+        for (; sent < due; sent++) {
+            CANFrame frame {
+                .id = static_cast<uint16_t>(ids[sent % ids.size()]),
+                .extended = false,
+                .fifo = 0,
+                .length = 8,
+                .data = { 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0 },
+            };
+
+            std::ignore = task->isr_receive(frame);
+        }
+
+        task->isr_notify();
+    }
+
+    vTaskPrioritySet(nullptr, own_priority);
+    vTaskDelay(10);
+
+    CANTask::RxStatistics stats = task->rx_statistics();
+    bool lossless = stats.dropped == 0 && stats.processed == total_frames;
+
+    vTaskDelete(task->handle());
+
+    return lossless;
+}
+
+bool can_filter_packing_test() {
+    // every standard ID must land in the FIFO its set says, or nowhere
+    auto check = [](auto const& plan, auto const& fifo0_ids, auto const& fifo1_ids) {
+        for (uint16_t id = 0; id < 0x800; id++) {
+            std::optional<uint8_t> expected = std::nullopt;
+            if (std::ranges::find(fifo0_ids, id) != fifo0_ids.end())
+                expected = 0;
+            if (std::ranges::find(fifo1_ids, id) != fifo1_ids.end())
+                expected = 1;
+
+            if (plan.fifo_of(id) != expected)
+                return false;
+        }
+
+        return true;
+    };
+
+    // seven data IDs and five heartbeats, list mode only
+    static_assert(k_can_filter_plan.size == 4);
+    bool vehicle_ok = check(k_can_filter_plan, CANMessageTable::ids, k_can_heartbeat_ids);
+
+    // aligned runs go into mask slots next to the lone IDs
+    static constexpr std::array<uint16_t, 17> runs_fifo0 { 0x100, 0x101, 0x102, 0x103, 0x104, 0x105, 0x106, 0x107, 0x108,
+                                                           0x109, 0x10A, 0x10B, 0x10C, 0x10D, 0x10E, 0x10F, 0x123 };
+    static constexpr std::array<uint16_t, 5> runs_fifo1 { 0x200, 0x201, 0x202, 0x203, 0x204 };
+    static constexpr auto runs_plan = plan_can_filters(runs_fifo0, runs_fifo1);
+    static_assert(runs_plan.size == 4);
+    static_assert(runs_plan.banks[0].mask_mode && !runs_plan.banks[1].mask_mode);
+    bool runs_ok = check(runs_plan, runs_fifo0, runs_fifo1);
+
+    // an unaligned run only has its aligned middle masked
+    static constexpr std::array<uint16_t, 8> unaligned { 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68 };
+    static constexpr std::array<uint16_t, 0> none {};
+    static constexpr auto unaligned_plan = plan_can_filters(unaligned, none);
+    static_assert(unaligned_plan.size == 2);
+    bool unaligned_ok = check(unaligned_plan, unaligned, none);
+
+    // everything, a single mask slot
+    static constexpr auto all_ids = [] {
+        std::array<uint16_t, 0x800> ret;
+        std::iota(ret.begin(), ret.end(), uint16_t(0));
+        return ret;
+    }();
+    static constexpr auto all_plan = plan_can_filters(all_ids, none);
+    static_assert(all_plan.size == 1 && all_plan.banks[0].values[1] == CANFilterBank::rtr_ide_bits);
+    bool all_ok = check(all_plan, all_ids, none);
+
+    return vehicle_ok && runs_ok && unaligned_ok && all_ok;
+}
+
 void test_parse_ip() {
     std::string_view decimated_v4 = "0.01.2.0x03";
     std::array<uint8_t, 4> out;
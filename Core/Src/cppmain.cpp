@@ -18,11 +18,13 @@
 #include <Watchdog.hpp>
 
 #include <Tele/CANTask.hpp>
+#include <Tele/CharConv.hpp>
 #include <Tele/DataCollector.hpp>
 #include <Tele/GPSTask.hpp>
 #include <Tele/GSMModules/Logger.hpp>
 #include <Tele/GSMModules/Timer.hpp>
 #include <Tele/GyroTask.hpp>
+#include <Tele/InternalFlash.hpp>
 #include <Tele/Log.hpp>
 #include <Tele/STUtilities.hpp>
 #include <Tele/UARTTasks.hpp>
@@ -68,40 +70,39 @@ protected:
     [[noreturn]] void operator()() override {
         std::array<char, 96> fmt_buffer {};
 
-        for (int i = 0;; i++) {
-            vTaskDelay(200);
+        std::ignore = m_data_collector.subscribe_task(displayed_channels, handle(), notification_bit);
+
+        TickType_t last_redraw = xTaskGetTickCount();
 
-            std::array<float, 5> battery_temperatures;
+        for (int i = 0;; i++) {
+            // redraw on changes, and every now and then so that the display recovers from resets
+            std::ignore = xTaskNotifyWait(0, notification_bit, nullptr, pdMS_TO_TICKS(1000));
 
-#if RACE_MODE == RACE_MODE_ELECTRO
-            static constexpr size_t cell_count = 27;
-#elif RACE_MODE == RACE_MODE_HYDRO
-            static constexpr size_t cell_count = 20;
-#endif
+            // the display can't keep up with every CAN frame
+            const TickType_t since_redraw = xTaskGetTickCount() - last_redraw;
+            if (since_redraw < min_redraw_interval)
+                vTaskDelay(min_redraw_interval - since_redraw);
 
-            std::array<float, cell_count> battery_voltages;
+            last_redraw = xTaskGetTickCount();
 
-            m_data_collector.get_array<float>("can_battery_temp", { battery_temperatures });
-            m_data_collector.get_array<float>("can_battery_voltage", { battery_voltages });
+            const auto battery_temperatures = m_data_collector.get_array(Tele::Channels::can_battery_temp);
+            const auto battery_voltages = m_data_collector.get_array(Tele::Channels::can_battery_voltage);
 
-            float spent_mah = m_data_collector.get<float>("can_spent_mah", 5);
-            float spent_mwh = m_data_collector.get<float>("can_spent_mwh", 6);
+            float spent_mah = m_data_collector.get(Tele::Channels::can_spent_mah, 5);
+            float spent_mwh = m_data_collector.get(Tele::Channels::can_spent_mwh, 6);
 
-            float current = m_data_collector.get<float>("can_current", 7);
-            // float current = m_data_collector.get<float>("engine_speed", 7);
+            float current = m_data_collector.get(Tele::Channels::can_current, 7);
+            // float current = m_data_collector.get(Tele::Channels::engine_speed, 7);
 
-            float soc_percent = m_data_collector.get<float>("can_soc_percent", 8);
-            // float soc_percent = m_data_collector.get<float>("engine_rpm", 8);
+            float soc_percent = m_data_collector.get(Tele::Channels::can_soc_percent, 8);
+            // float soc_percent = m_data_collector.get(Tele::Channels::engine_rpm, 8);
 
-            const auto voltage_sum = std::reduce(battery_voltages.cbegin(), battery_voltages.cend());
-            const auto [voltage_min, voltage_max]
-              = std::minmax_element(battery_voltages.cbegin(), battery_voltages.cend());
-            const auto voltage_avg = voltage_sum / battery_voltages.size();
+            const auto voltage_sum = m_data_collector.get(Tele::Channels::can_battery_voltage_sum);
+            const auto voltage_min = m_data_collector.get(Tele::Channels::can_battery_voltage_min);
+            const auto voltage_max = m_data_collector.get(Tele::Channels::can_battery_voltage_max);
+            const auto voltage_avg = m_data_collector.get(Tele::Channels::can_battery_voltage_avg);
 
-            const auto temperature_sum = std::reduce(battery_temperatures.cbegin(), battery_temperatures.cend());
-            const auto [temperature_min, temperature_max]
-              = std::minmax_element(battery_temperatures.cbegin(), battery_temperatures.cend());
-            const auto temperature_avg = voltage_sum / battery_temperatures.size();
+            const auto temperature_max = m_data_collector.get(Tele::Channels::can_battery_temp_max);
 
             m_uart_task.transmit(produce_assignment_expression({ fmt_buffer }, "cell_init", battery_voltages[0], 2));
             for (int i = 0; i < 26; i++) {
@@ -118,8 +119,8 @@ protected:
 
             // clang-format off
 
-            m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "speed_kmh", m_data_collector.get<float>("engine_speed", i), 0));
-            m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "rpm_engine", m_data_collector.get<float>("engine_rpm"), 0));
+            m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "speed_kmh", m_data_collector.get(Tele::Channels::engine_speed, i), 0));
+            m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "rpm_engine", m_data_collector.get(Tele::Channels::engine_rpm), 0));
 
             m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "volt_smps", 0.f, 1));
             m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "curr_smps", 0.f, 1));
@@ -134,14 +135,14 @@ protected:
             m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "temp_engine_drv", 0.f, 1));
             m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "temp_smps", 0.f, 1));
 
-            m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "hydro_ppm", m_data_collector.get<float>("can_hydro_ppm"), 2));
-            m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "hydro_temp", m_data_collector.get<float>("can_hydro_temp"), 2));
+            m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "hydro_ppm", m_data_collector.get(Tele::Channels::can_hydro_ppm), 2));
+            m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "hydro_temp", m_data_collector.get(Tele::Channels::can_hydro_temp), 2));
 
-            m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "cell_min", *voltage_min, 2));
-            m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "cell_max", *voltage_max, 2));
+            m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "cell_min", voltage_min, 2));
+            m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "cell_max", voltage_max, 2));
             m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "cell_avg", voltage_avg, 2));
             m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "cell_sum", voltage_sum, 2));
-            m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "temp_batt_max", *temperature_max, 1));
+            m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "temp_batt_max", temperature_max, 1));
 
             m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "current", current, 1));
             m_uart_task.transmit(produce_assignment_expression({fmt_buffer}, "spent_wh", spent_mwh / 1000.f, 1));
@@ -188,6 +189,16 @@ protected:
     }
 
 private:
+    inline static constexpr uint32_t notification_bit = 1;
+    inline static constexpr TickType_t min_redraw_interval = pdMS_TO_TICKS(50);
+
+    inline static constexpr Tele::ChannelSet displayed_channels {
+        Tele::Channels::engine_rpm,       Tele::Channels::engine_speed,    Tele::Channels::can_battery_voltage,
+        Tele::Channels::can_battery_temp, Tele::Channels::can_spent_mah,   Tele::Channels::can_spent_mwh,
+        Tele::Channels::can_current,      Tele::Channels::can_soc_percent, Tele::Channels::can_hydro_ppm,
+        Tele::Channels::can_hydro_temp,
+    };
+
     Tele::TransmitTask m_uart_task;
     Tele::DataCollectorTask& m_data_collector;
 };
@@ -200,7 +211,11 @@ static ShellTask s_shell_task {};
 
 static Tele::GPSTask s_gps_task { s_data_collector, Tele::s_gps_uart };
 static Tele::CANTask s_can_task { s_data_collector, hcan1 };
-static Tele::PacketForgerTask s_packet_forger_task { s_data_collector };
+// the upper half of the flash, sectors 8 through 11
+using SpoolFlash = Tele::InternalFlash<8, 4>;
+static SpoolFlash s_spool_flash {};
+static Tele::FlashSpool s_packet_spool { s_spool_flash };
+static Tele::PacketForgerTask s_packet_forger_task { s_data_collector, s_can_task, s_packet_spool };
 
 static Tele::TransmitTask s_gsm_transmit_task { Tele::s_gsm_uart };
 static Tele::GSM::TimerModule s_gsm_module_timer {};
@@ -229,6 +244,51 @@ extern "C" void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart) {
     }
 }
 
+extern "C" void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef* hcan) {
+    if (hcan == &hcan1)
+        s_can_task.isr_rx_pending(CAN_RX_FIFO0);
+}
+
+extern "C" void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef* hcan) {
+    if (hcan == &hcan1)
+        s_can_task.isr_rx_pending(CAN_RX_FIFO1);
+}
+
+extern "C" void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef* hcan) {
+    if (hcan == &hcan1)
+        s_can_task.isr_tx_done(0, true);
+}
+
+extern "C" void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef* hcan) {
+    if (hcan == &hcan1)
+        s_can_task.isr_tx_done(1, true);
+}
+
+extern "C" void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef* hcan) {
+    if (hcan == &hcan1)
+        s_can_task.isr_tx_done(2, true);
+}
+
+extern "C" void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef* hcan) {
+    if (hcan == &hcan1)
+        s_can_task.isr_tx_done(0, false);
+}
+
+extern "C" void HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef* hcan) {
+    if (hcan == &hcan1)
+        s_can_task.isr_tx_done(1, false);
+}
+
+extern "C" void HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef* hcan) {
+    if (hcan == &hcan1)
+        s_can_task.isr_tx_done(2, false);
+}
+
+extern "C" void HAL_CAN_ErrorCallback(CAN_HandleTypeDef* hcan) {
+    if (hcan == &hcan1)
+        s_can_task.isr_error(HAL_CAN_GetError(hcan));
+}
+
 extern "C" void HAL_GPIO_EXTI_Callback(uint16_t pin) {
     if (pin == 1) {
         s_gsm_module_main.isr_gyro_notify();
@@ -249,6 +309,187 @@ static int stack_abuser(int i) { // NOLINT(misc-no-recursion)
     return 1 + stack_abuser(i - 1) * 2;
 }
 
+/// Logs the value of every channel that has been written to.
+static void log_channel_values(Tele::DataCollectorTask const& collector) {
+    auto log_channel = [&]<typename T, size_t Extent>(std::string_view name, Tele::Channel<T, Extent> channel) {
+        const auto written_at = collector.read([channel](Tele::DataCollectorTask::Reader const& reader) {
+            return reader.written_at(channel);
+        });
+
+        if (!written_at)
+            return;
+
+        if constexpr (Extent == 1) {
+            Log::info("{}: {}", name, collector.get(channel));
+        } else {
+            std::string values;
+            for (T value : collector.get_array(channel))
+                fmt::format_to(std::back_inserter(values), "{} ", value);
+
+            Log::info("{}: {}", name, values);
+        }
+    };
+
+#pragma push_macro("FACTORY")
+#define FACTORY(_name, _type, _extent, _history, _ttl) log_channel(#_name, Tele::Channels::_name);
+    TELE_CHANNEL_LIST(FACTORY)
+#pragma pop_macro("FACTORY")
+}
+
+static void can_capture_command(std::string_view args) {
+    // small enough for the shell queue to not overflow
+    static constexpr size_t dump_page_size = 8;
+
+    Tele::CANCapture& capture = s_can_task.capture();
+
+    if (args == "start") {
+        capture.start();
+    } else if (args == "stop") {
+        capture.stop();
+    } else if (args == "clear") {
+        capture.stop();
+        capture.clear();
+    } else if (args.starts_with("dump")) {
+        size_t first = 0;
+        if (args.size() > 5) {
+            const auto res = std::from_chars(args.begin() + 5, args.end(), first);
+            if (res.ec != std::errc()) {
+                Log::warn("bad argument");
+                return;
+            }
+        }
+
+        capture.stop();
+
+        const size_t count = capture.size();
+        Log::info("CANCAP v{} records={}", Tele::CANCapture::format_version, count);
+
+        for (size_t i = first; i < std::min(count, first + dump_page_size); i++) {
+            const auto bytes = capture.record(i).to_bytes();
+
+            std::array<char, Tele::CANCaptureRecord::size * 2> text;
+            std::ignore = Tele::to_chars(std::span(bytes), text, std::endian::big);
+
+            Log::info("CANCAP {} {}", i, std::string_view(text.data(), text.size()));
+        }
+    } else if (args.starts_with("load v")) {
+        // the version the dump header carries, then the record
+        uint16_t version;
+        const auto version_res = std::from_chars(args.begin() + 6, args.end(), version);
+        if (version_res.ec != std::errc() || version_res.ptr == args.end() || *version_res.ptr != ' ') {
+            Log::warn("bad version");
+            return;
+        }
+
+        const std::string_view record_text(version_res.ptr + 1, args.end());
+        std::array<uint8_t, Tele::CANCaptureRecord::size> bytes;
+
+        const auto res = Tele::from_chars(std::span(bytes), record_text, std::endian::big);
+        if (res.ec != std::errc() || record_text.size() != bytes.size() * 2) {
+            Log::warn("bad record");
+            return;
+        }
+
+        capture.stop();
+        if (const auto loaded = capture.load(version, Tele::CANCaptureRecord::from_bytes(bytes)); !loaded)
+            Log::warn("{}, this build reads v{}", loaded.error(), Tele::CANCapture::format_version);
+    } else {
+        Log::warn("usage: can capture start|stop|clear|dump [first]|load v<version> <record>");
+    }
+}
+
+static void can_replay_command() {
+    Tele::CANCapture& capture = s_can_task.capture();
+    capture.stop();
+
+    // a scratch collector so that the replay doesn't clobber live data
+    auto collector = std::make_unique<Tele::DataCollectorTask>();
+    const auto stats = capture.replay(*collector);
+
+    if (stats.frames == 0) {
+        Log::warn("the capture is empty");
+        return;
+    }
+
+    const auto cycles_to_us = [](uint64_t cycles) { return cycles * 1'000'000 / SystemCoreClock; };
+
+    Log::info(
+      "{} frames: {} decoded, {} unknown, {} malformed, {} heartbeats", //
+      stats.frames, stats.decoded, stats.unknown, stats.malformed, stats.heartbeats
+    );
+    Log::info(
+      "{} us of traffic replayed in {} us, {} frames/s", //
+      stats.capture_us, cycles_to_us(stats.replay_cycles),
+      stats.frames * static_cast<uint64_t>(SystemCoreClock) / std::max<uint64_t>(stats.replay_cycles, 1)
+    );
+
+    const uint32_t decoded_frames = std::max<uint32_t>(stats.frames - stats.heartbeats, 1);
+    Log::info(
+      "decode latency: {} cycles mean, {} cycles max", stats.decode_cycles / decoded_frames, stats.max_decode_cycles
+    );
+
+    log_channel_values(*collector);
+}
+
+static void can_status_command() {
+    static constexpr std::array<std::string_view, 4> error_state_names {
+        "error active",
+        "error warning",
+        "error passive",
+        "bus-off",
+    };
+
+    const auto rx = s_can_task.rx_statistics();
+    const auto tx = s_can_task.tx_statistics();
+    const auto error_state = s_data_collector.get(Tele::Channels::can_error_state);
+
+    Log::info(
+      "{} frames/s received, {} frames/s sent, {:.1f}% bus load",  //
+      s_data_collector.get(Tele::Channels::can_rx_frames_per_second), //
+      s_data_collector.get(Tele::Channels::can_tx_frames_per_second), //
+      s_data_collector.get(Tele::Channels::can_bus_load_percent)
+    );
+    Log::info(
+      "{}, TEC {}, REC {}, {} times bus-off, {} times error passive",                 //
+      error_state_names[std::min<size_t>(error_state, error_state_names.size() - 1)], //
+      s_data_collector.get(Tele::Channels::can_tec),                                  //
+      s_data_collector.get(Tele::Channels::can_rec),                                  //
+      s_data_collector.get(Tele::Channels::can_bus_off_count),                        //
+      s_data_collector.get(Tele::Channels::can_error_passive_count)
+    );
+    Log::info(
+      "rx: {} received, {} processed, {} dropped, {} FIFO overruns, {} max ring fill", //
+      rx.received, rx.processed, rx.dropped, rx.fifo_overruns, rx.ring_high_watermark
+    );
+    Log::info(
+      "tx: {} sent, {} dropped, {} errors, {} arbitration losses, {} max queue fill", //
+      tx.sent, tx.dropped, tx.errors, tx.arbitration_losses, tx.queue_high_watermark
+    );
+    Log::info(
+      "{} malformed frames, {} unknown frames, {} incomplete cell voltage sets", //
+      s_data_collector.get(Tele::Channels::can_decode_failures),                 //
+      s_data_collector.get(Tele::Channels::can_unknown_frames),                  //
+      s_data_collector.get(Tele::Channels::can_staging_discards)
+    );
+
+    const auto id_rates = s_data_collector.get_array(Tele::Channels::can_id_frames_per_second);
+    for (size_t i = 0; i < Tele::k_can_rx_ids.size(); i++) {
+        const auto id = static_cast<Tele::CANIDs>(Tele::k_can_rx_ids[i]);
+
+        if (const auto last_heartbeat = s_can_task.last_heartbeat(id); last_heartbeat) {
+            Log::info(
+              "{:#05x}: {} frames/s, seen {} ms ago", //
+              Tele::k_can_rx_ids[i], id_rates[i], HAL_GetTick() - *last_heartbeat
+            );
+        } else {
+            Log::info("{:#05x}: {} frames/s", Tele::k_can_rx_ids[i], id_rates[i]);
+        }
+    }
+
+    if (rx.dropped != 0 || rx.fifo_overruns != 0)
+        Log::warn("received frames were lost, decoded values may be stale");
+}
+
 static void terminal_line_callback(std::string_view line) {
     static std::array<TaskStatus_t, 24> s_task_status_buffer;
 
@@ -288,6 +529,46 @@ static void terminal_line_callback(std::string_view line) {
               task.usStackHighWaterMark
             );
         }
+    } else if (line == "collector") {
+        for (uint16_t i = 0; i < Tele::k_channel_count; i++) {
+            const auto stats = s_data_collector.channel_statistics(i);
+            if (stats.writes == 0 && stats.reads == 0)
+                continue;
+
+            Log::info(
+              "{}: {} writes/s, {} writes, {} reads", //
+              Tele::k_channel_table[i].name,          //
+              stats.writes_per_second,                //
+              stats.writes,                           //
+              stats.reads
+            );
+        }
+
+        Log::info("{} read retries", s_data_collector.read_retries());
+        Log::info("{} cycles spent retrying reads", s_data_collector.get(Tele::Channels::collector_read_wait_cycles));
+        Log::info("{} cycles max write hold", s_data_collector.get(Tele::Channels::collector_max_hold_cycles));
+    } else if (line == "can") {
+        can_status_command();
+    } else if (line.starts_with("can capture ")) {
+        can_capture_command(line.substr(12));
+    } else if (line == "can replay") {
+        can_replay_command();
+    } else if (line == "spool") {
+        const auto stats = s_packet_forger_task.spool_statistics();
+
+        Log::info(
+          "{} packets pending, {} spooled, {} acked, {} dropped, {} erases at most, {} CAN FIFO overruns", //
+          stats.pending,                                                                                  //
+          stats.appended,                                                                                 //
+          stats.consumed,                                                                                 //
+          stats.dropped,                                                                                  //
+          stats.max_erase_count,                                                                          //
+          s_packet_forger_task.spool_fifo_overruns()
+        );
+    } else if (line == "test") {
+        Tele::run_tests();
+    } else if (line == "bench") {
+        Tele::run_benchmarks();
     } else if (line.starts_with("abuse_stack")) {
         int i;
         std::string_view args = line.substr(line.find(' ') + 1);
@@ -306,6 +587,10 @@ static void terminal_line_callback(std::string_view line) {
 extern "C" void cpp_init() {
     Tele::init_globals();
 
+    // the spool would erase the firmware
+    if (SpoolFlash::overlaps_image())
+        Error_Handler();
+
     Log::g_logger.add_sink(std::make_unique<ShellSink>(std::ref(s_shell_task)));
 
     s_watchdog_task.create("watchdog");
@@ -314,6 +599,8 @@ extern "C" void cpp_init() {
     s_gps_task.create("gps");
     s_gps_task.begin_rx();
     s_can_task.create("can");
+    s_can_task.begin_rx();
+    s_can_task.begin_tx();
     s_packet_forger_task.create("packet forger");
 
     s_gsm_coordinator.register_module(&s_gsm_module_timer);
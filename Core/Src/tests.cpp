@@ -0,0 +1,923 @@
+#include <tests.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Tele/CANSignals.hpp>
+#include <Tele/Flash.hpp>
+#include <Tele/FlashSpool.hpp>
+#include <Tele/GSMCommands.hpp>
+#include <Tele/Kernels.hpp>
+#include <Tele/Quantization.hpp>
+#include <Tele/ResendWindow.hpp>
+#include <Tele/Stream.hpp>
+
+namespace Tele {
+
+std::array<Packet, 10> make_packet_batch() {
+    std::mt19937 engine { 5678 };
+    std::uniform_real_distribution<float> cell_dist { 3.6f, 4.1f };
+    std::uniform_real_distribution<float> temp_dist { 25.f, 45.f };
+
+    std::array<Packet, 10> ret;
+
+    for (size_t i = 0; i < ret.size(); i++) {
+        FullPacket packet {
+            .spent_mah = 1234.5f + i,
+            .spent_mwh = 45678.9f + i,
+            .current = 12.3f,
+            .soc_percent = 76.5f,
+            .temperature_smps = 41.f,
+            .temperature_engine_driver = 52.f,
+            .vc_engine_driver = { 96.f, 15.f },
+            .vc_telemetry = { 12.1f, 0.4f },
+            .vc_smps = { 12.f, 1.2f },
+            .vc_bms = { 98.f, 0.1f },
+            .rpm = 1250.f,
+            .speed = 38.f,
+            .vc_engine = { 95.f, 14.f },
+            .longitude = 29.0123f,
+            .latitude = 41.0456f,
+            .gyro = { 0.1f, -0.2f, 9.8f },
+            .queue_fill_amt = 3,
+            .tick_counter = 123456 + static_cast<uint32_t>(i) * 500,
+            .free_heap_space = 40960,
+            .amt_allocs = 1000,
+            .amt_frees = 990,
+            .cpu_usage = 0.42f,
+        };
+
+        // like the collector, only the cells of the pack are written
+        std::ranges::generate(std::span(packet.battery_voltages).first<k_battery_cell_count>(), [&] {
+            return cell_dist(engine);
+        });
+        std::ranges::generate(packet.battery_temps, [&] { return temp_dist(engine); });
+
+        ret[i] = Packet {
+            .sequence_id = static_cast<uint32_t>(i),
+            .timestamp = 1'700'000'000 + static_cast<int32_t>(i) / 2,
+            .rng_state = static_cast<uint32_t>(engine()),
+            .data = packet,
+        };
+    }
+
+    return ret;
+}
+
+std::array<Packet, 10> make_packet_series() {
+    std::mt19937 engine { 8765 };
+    std::uniform_int_distribution<int> step_dist { -1, 1 };
+    std::uniform_int_distribution<uint32_t> byte_dist { 180, 200 };
+
+    constexpr SignalLayout cell_layout = SignalLayout { .length = 8 }.with_range(2.4f, 4.3f);
+    constexpr SignalLayout temp_layout = SignalLayout { .length = 8 }.with_range(0.f, 100.f);
+    constexpr SignalLayout current_layout = SignalLayout { .length = 16 }.with_range(-10.f, 50.f);
+
+    std::array<uint8_t, 27> cells;
+    std::ranges::generate(cells, [&] { return static_cast<uint8_t>(byte_dist(engine)); });
+    std::array<uint8_t, 5> temps { 80, 82, 81, 85, 79 };
+    uint16_t current = 24000;
+
+    std::array<Packet, 10> ret;
+
+    for (size_t i = 0; i < ret.size(); i++) {
+        for (uint8_t& cell : cells)
+            cell = static_cast<uint8_t>(cell + (step_dist(engine) < 0 ? -1 : 0));
+
+        temps[i % temps.size()] += step_dist(engine) > 0 ? 1 : 0;
+        current = static_cast<uint16_t>(current + step_dist(engine) * 150);
+
+        FullPacket packet {
+            .spent_mah = 1234.5f + i * 2.5f,
+            .spent_mwh = 45678.9f + i * 9.f,
+            .current = current * current_layout.scale + current_layout.offset,
+            .soc_percent = 76.5f,
+            .rpm = 1250.f + step_dist(engine) * 10.f,
+            .speed = 38.f,
+            .longitude = 29.0123f + i * 0.00005f,
+            .latitude = 41.0456f + i * 0.00002f,
+            .queue_fill_amt = 3,
+            .tick_counter = 123456 + static_cast<uint32_t>(i) * 667,
+            .free_heap_space = 40960,
+            .amt_allocs = 1000 + static_cast<uint32_t>(i) * 3,
+            .amt_frees = 990 + static_cast<uint32_t>(i) * 3,
+            .cpu_usage = 0.42f,
+        };
+
+        Kernels::scale_u8(
+          std::span(cells).first<k_battery_cell_count>(), packet.battery_voltages, cell_layout.scale, cell_layout.offset
+        );
+        Kernels::scale_u8(temps, packet.battery_temps, temp_layout.scale, temp_layout.offset);
+
+        ret[i] = Packet {
+            .sequence_id = 100 + static_cast<uint32_t>(i),
+            .timestamp = 1'700'000'000 + static_cast<int32_t>(i * 2 / 3),
+            .rng_state = static_cast<uint32_t>(engine()),
+            .data = packet,
+        };
+    }
+
+    return ret;
+}
+
+std::array<float, 2> simulate_uplink(float loss_rate, bool with_window) {
+    struct SimulatedPacket {
+        uint32_t sequence_id;
+    };
+
+    static constexpr size_t rounds = 1000;
+    static constexpr size_t packets_per_round = 2;
+    static constexpr size_t batch_size = 10;
+
+    std::mt19937 engine { 1234 };
+    std::bernoulli_distribution lost { loss_rate };
+
+    ResendWindow<SimulatedPacket, PacketResendWindow::capacity> window {};
+    std::vector<bool> delivered(rounds * packets_per_round, false);
+    uint32_t next_sequence_id = 0;
+    size_t transmitted = 0;
+
+    for (size_t round = 0; round < rounds; round++) {
+        if (!with_window)
+            window.clear();
+
+        for (size_t i = 0; i < packets_per_round; i++)
+            std::ignore = window.push({ next_sequence_id++ });
+
+        std::array<SimulatedPacket, batch_size> batch;
+        const size_t count = window.oldest(batch);
+        transmitted += count;
+
+        const bool outage = round >= 400 && round < 500;
+        if (outage || lost(engine))
+            continue;
+
+        for (SimulatedPacket const& packet : std::span(batch).first(count))
+            delivered[packet.sequence_id] = true;
+
+        if (count == 0 || lost(engine))
+            continue;
+
+        // the ids between the first and the last one of a batch that are not in it were acknowledged already
+        window.acknowledge(batch[0].sequence_id, batch[count - 1].sequence_id);
+    }
+
+    const auto delivered_count = static_cast<float>(std::ranges::count(delivered, true));
+
+    return {
+        delivered_count / static_cast<float>(delivered.size()),
+        transmitted == 0 ? 0.f : delivered_count / static_cast<float>(transmitted),
+    };
+}
+
+bool kernels_test() {
+    std::mt19937 engine { 4321 };
+    std::uniform_int_distribution<uint32_t> byte_dist { 0, 255 };
+
+    constexpr SignalLayout layout = SignalLayout { .start_bit = 0, .length = 8 }.with_range(2.4f, 4.3f);
+
+    bool ok = true;
+
+    // every length around the four byte steps, against the scalar kernels
+    for (size_t length = 0; length <= 40; length++) {
+        std::array<uint8_t, 40> raw;
+        std::ranges::generate(raw, [&] { return static_cast<uint8_t>(byte_dist(engine)); });
+        const auto in = std::span(raw).first(length);
+
+        std::array<float, 40> expected_cells {};
+        std::array<float, 40> cells {};
+        Kernels::Scalar::scale_u8(in, expected_cells, layout.scale, layout.offset);
+        Kernels::scale_u8(in, cells, layout.scale, layout.offset);
+        ok &= std::ranges::equal(cells, expected_cells, [](float lhs, float rhs) {
+            return std::abs(lhs - rhs) <= 1e-6f * std::abs(rhs);
+        });
+
+        const auto expected = Kernels::Scalar::reduce_u8(in);
+        const auto reduced = Kernels::reduce_u8(in);
+        ok &= reduced.sum == expected.sum && reduced.min == expected.min && reduced.max == expected.max;
+        ok &= reduced.argmin == expected.argmin && reduced.argmax == expected.argmax;
+
+        // quantization undoes scaling
+        std::array<uint8_t, 40> round_trip {};
+        Kernels::quantize_u8(std::span(cells).first(length), round_trip, layout.scale, layout.offset);
+        ok &= std::ranges::equal(std::span(round_trip).first(length), in);
+    }
+
+    // out of range values saturate
+    const std::array<float, 6> out_of_range { -100.f, 2.3f, 2.4f, 4.3f, 4.4f, 100.f };
+    std::array<uint8_t, 6> saturated;
+    Kernels::quantize_u8(out_of_range, saturated, layout.scale, layout.offset);
+    ok &= saturated == std::array<uint8_t, 6> { 0, 0, 0, 255, 255, 255 };
+
+    // as do NaNs, to the bottom of the range
+    const std::array<float, 5> nans { NAN, 3.f, NAN, NAN, -NAN };
+    std::array<uint8_t, 5> quantized_nans;
+    Kernels::quantize_u8(nans, quantized_nans, layout.scale, layout.offset);
+    ok &= quantized_nans[0] == 0 && quantized_nans[2] == 0 && quantized_nans[3] == 0 && quantized_nans[4] == 0;
+
+    // the decoder takes the kernel path for packed bytes, it must match the generic extraction
+    const std::array<uint8_t, 8> frame { 0, 1, 127, 128, 200, 254, 255, 42 };
+    const Detail::FrameWords words = Detail::load_frame(frame);
+
+    constexpr SignalLayout packed = SignalLayout { .start_bit = 8, .length = 8, .count = 7 }.with_range(2.4f, 4.3f);
+    const auto values = Detail::extract_signals<packed>(words);
+
+    [&]<size_t... Is>(std::index_sequence<Is...>) {
+        ok &= ((std::abs(values[Is] - Detail::extract_signal<packed, Is>(words)) <= 1e-6f) && ...);
+    }(std::make_index_sequence<packed.count> {});
+
+    return ok;
+}
+
+bool binary_encoding_test() {
+    bool ok = true;
+
+    auto encode = [](auto const& value, BinaryEncoding encoding = BinaryEncoding::Compact) {
+        std::string buffer;
+        PushBackStream stream { buffer };
+        BinaryWriter writer { stream };
+        writer.write(value, encoding);
+        return buffer;
+    };
+
+    auto as_bytes = [](std::string const& buffer) {
+        return std::span(reinterpret_cast<uint8_t const*>(buffer.data()), buffer.size());
+    };
+
+    // varint boundaries
+    ok &= encode(uint32_t { 0 }) == std::string_view("\x00", 1);
+    ok &= encode(uint32_t { 127 }) == "\x7F";
+    ok &= encode(uint32_t { 128 }) == "\x80\x01";
+    ok &= encode(uint32_t { 0xFFFF'FFFF }) == "\xFF\xFF\xFF\xFF\x0F";
+
+    // zigzag keeps small magnitudes short
+    ok &= encode(int32_t { -1 }) == "\x01";
+    ok &= encode(int32_t { 1 }) == "\x02";
+    ok &= encode(int32_t { -64 }) == "\x7F";
+    ok &= encode(int32_t { 64 }) == "\x80\x01";
+
+    ok &= encode(uint32_t { 0x1234'5678 }, BinaryEncoding::Fixed) == "\x78\x56\x34\x12";
+    ok &= encode(1.f) == std::string_view("\x00\x00\x80\x3F", 4);
+
+    for (int32_t value : { 0, 1, -1, 63, -64, 1'000'000, -1'000'000, INT32_MAX, INT32_MIN }) {
+        const std::string buffer = encode(value);
+        BinaryReader reader { as_bytes(buffer) };
+
+        int32_t decoded = 0;
+        ok &= reader.read(decoded).has_value() && decoded == value && reader.remaining().empty();
+    }
+
+    // whole packets survive a round trip
+    const std::array<Packet, 10> packets = make_packet_batch();
+    const std::string buffer = encode(std::span<const Packet>(packets));
+    BinaryReader reader { as_bytes(buffer) };
+
+    ok &= reader.read_varint() == packets.size();
+
+    for (Packet const& expected : packets) {
+        Packet decoded {};
+        ok &= reader.read(decoded).has_value();
+
+        ok &= decoded.sequence_id == expected.sequence_id && decoded.timestamp == expected.timestamp;
+        ok &= decoded.rng_state == expected.rng_state && decoded.data.index() == expected.data.index();
+
+        FullPacket const* decoded_full = std::get_if<FullPacket>(&decoded.data);
+        FullPacket const& expected_full = std::get<FullPacket>(expected.data);
+        ok &= decoded_full != nullptr && std::ranges::equal(decoded_full->battery_voltages, expected_full.battery_voltages);
+        ok &= decoded_full != nullptr && decoded_full->tick_counter == expected_full.tick_counter;
+    }
+
+    ok &= reader.remaining().empty();
+
+    // truncated input is an error, not a read past the end
+    BinaryReader truncated_reader { as_bytes(buffer).first(buffer.size() / 2) };
+    std::ignore = truncated_reader.read_varint();
+
+    bool truncated_ok = true;
+    for (size_t i = 0; i < packets.size() && truncated_ok; i++) {
+        Packet decoded {};
+        truncated_ok = truncated_reader.read(decoded).has_value();
+    }
+    ok &= !truncated_ok;
+
+    // chunking hands the sink the same bytes, however they are split
+    std::string chunked_buffer;
+    size_t chunk_count = 0;
+
+    auto sink = [&](std::string_view chunk) {
+        chunked_buffer += chunk;
+        chunk_count++;
+    };
+
+    ChunkedStream<64, decltype(sink)> chunked_stream { sink };
+    BinaryWriter chunked_writer { chunked_stream };
+    chunked_writer.write(std::span<const Packet>(packets));
+    chunked_stream.flush();
+
+    ok &= chunked_buffer == buffer && chunk_count == (buffer.size() + 63) / 64;
+
+    return ok;
+}
+
+bool quantization_test() {
+    bool ok = true;
+
+    // fixed point rounds to the nearest and saturates
+    ok &= Fixed<int16_t, -7>(1.f / 256.f).data == 1 && Fixed<int16_t, -7>(-1.f / 256.f).data == -1;
+    ok &= Fixed<int16_t, -7>(1000.f).data == INT16_MAX && Fixed<int16_t, -7>(-1000.f).data == INT16_MIN;
+    ok &= Fixed<uint16_t, 0>(-5.f).data == 0;
+    ok &= Fixed<int16_t, -7>(NAN).data == 0;
+
+    // range floats map their ends onto the ends of their representation
+    using Cell = RangeFloat<uint8_t, 2.4f, 4.3f>;
+    ok &= Cell(2.4f).data == 0 && Cell(4.3f).data == 255 && Cell(1.f).data == 0 && Cell(5.f).data == 255;
+    ok &= Cell(NAN).data == 0;
+
+    // cell voltages decoded off the bus quantize back to the raw bytes, through the kernel and element-wise alike
+    constexpr SignalLayout layout = SignalLayout { .start_bit = 0, .length = 8 }.with_range(2.4f, 4.3f);
+
+    for (uint32_t raw = 0; raw <= 255; raw++) {
+        const float decoded = static_cast<float>(raw) * layout.scale + layout.offset;
+        ok &= Cell(decoded).data == raw;
+    }
+
+    for (Packet const& packet : make_packet_batch()) {
+        FullPacket const& full = std::get<FullPacket>(packet.data);
+        const QuantizedFullPacket quantized = quantize<QuantizedFullPacket>(full);
+        const FullPacket restored = restore(quantized);
+
+        // cells past the pack are 0 V, off the range, and come back as its bottom
+        for (size_t i = 0; i < k_battery_cell_count; i++) {
+            ok &= quantized.battery_voltages[i].data == Cell(full.battery_voltages[i]).data;
+            ok &= std::abs(restored.battery_voltages[i] - full.battery_voltages[i]) <= Cell::value_step / 2 + 1e-6f;
+        }
+
+        ok &= std::abs(restored.current - full.current) <= decltype(quantized.current)::value_step / 2 + 1e-6f;
+        ok &= std::abs(restored.rpm - full.rpm) <= 0.5f;
+        ok &= std::abs(restored.vc_engine[1] - full.vc_engine[1]) <= 1.f / 256.f;
+        ok &= std::abs(restored.latitude - full.latitude) <= 1e-5f;
+        ok &= restored.tick_counter == full.tick_counter && restored.stale_fields == full.stale_fields;
+    }
+
+    return ok;
+}
+
+bool columnar_encoding_test() {
+    bool ok = true;
+
+    auto encode = [](std::span<const Packet> packets) {
+        std::string buffer;
+        PushBackStream stream { buffer };
+        ColumnarWriter { stream }.write(packets);
+        return buffer;
+    };
+
+    auto as_bytes = [](std::string const& buffer) {
+        return std::span(reinterpret_cast<uint8_t const*>(buffer.data()), buffer.size());
+    };
+
+    // what goes in comes out bit for bit, the binary encoding makes for an easy comparison
+    auto same = [](Packet const& lhs, Packet const& rhs) {
+        std::string lhs_buffer;
+        std::string rhs_buffer;
+        PushBackStream lhs_stream { lhs_buffer };
+        PushBackStream rhs_stream { rhs_buffer };
+        BinaryWriter { lhs_stream }.write(lhs);
+        BinaryWriter { rhs_stream }.write(rhs);
+        return lhs_buffer == rhs_buffer;
+    };
+
+    auto round_trips = [&](std::span<const Packet> packets) {
+        const std::string buffer = encode(packets);
+        ColumnarReader reader { as_bytes(buffer) };
+
+        std::array<Packet, k_columnar_max_rows> decoded;
+        auto res = reader.read(std::span<Packet>(decoded));
+
+        return res && *res == packets.size() && reader.remaining().empty()
+            && std::ranges::equal(packets, std::span(decoded).first(packets.size()), same);
+    };
+
+    const std::array<Packet, 10> series = make_packet_series();
+    const std::array<Packet, 10> batch = make_packet_batch();
+
+    ok &= round_trips(series);
+    ok &= round_trips(batch);
+    ok &= round_trips(std::span(series).first(1));
+    ok &= round_trips({});
+
+    // mixed alternatives, quantized ones and integer extremes
+    std::array<Packet, 6> mixed;
+    std::ranges::copy(std::span(series).first(mixed.size()), mixed.begin());
+
+    mixed[1].data = quantize<QuantizedFullPacket>(std::get<FullPacket>(series[1].data));
+    mixed[2].data = DiagnosticPacket { .free_heap_space = 0xFFFF'FFFF, .amt_allocs = 0 };
+    mixed[3].data = quantize<QuantizedFullPacket>(std::get<FullPacket>(series[3].data));
+    mixed[4].timestamp = INT32_MIN;
+    mixed[5].timestamp = INT32_MAX;
+    std::get<FullPacket>(mixed[5].data).battery_voltages[0] = -std::numeric_limits<float>::infinity();
+
+    ok &= round_trips(mixed);
+
+    // rows that barely move compress better than random ones
+    ok &= encode(series).size() < encode(batch).size();
+
+    // truncation is reported
+    const std::string buffer = encode(series);
+    ColumnarReader truncated_reader { as_bytes(buffer).first(buffer.size() - 1) };
+    std::array<Packet, 10> decoded;
+    ok &= !truncated_reader.read(std::span<Packet>(decoded)).has_value();
+
+    return ok;
+}
+
+bool sparse_packet_test() {
+    bool ok = true;
+
+    const std::array<Packet, 10> series = make_packet_series();
+
+    std::array<QuantizedFullPacket, 10> states;
+    std::ranges::transform(series, states.begin(), [](Packet const& packet) {
+        return quantize<QuantizedFullPacket>(std::get<FullPacket>(packet.data));
+    });
+
+    auto same = [](QuantizedFullPacket const& lhs, QuantizedFullPacket const& rhs) {
+        std::string lhs_buffer;
+        std::string rhs_buffer;
+        PushBackStream lhs_stream { lhs_buffer };
+        PushBackStream rhs_stream { rhs_buffer };
+        BinaryWriter { lhs_stream }.write(lhs);
+        BinaryWriter { rhs_stream }.write(rhs);
+        return lhs_buffer == rhs_buffer;
+    };
+
+    // applying the changes on top of the previous state gives back the current one
+    for (size_t i = 1; i < states.size(); i++) {
+        const SparseFullPacket sparse = SparseFullPacket::changes(states[i - 1], states[i]);
+        QuantizedFullPacket state = states[i - 1];
+        sparse.apply_to(state);
+        ok &= same(state, states[i]);
+    }
+
+    ok &= SparseFullPacket::changes(states[0], states[0]).present == 0;
+
+    // a keyframe first, then `keyframe_interval` sparse packets, contiguous sequence ids throughout
+    PacketSequencer sequencer {};
+    std::array<Packet, PacketSequencer::keyframe_interval + 2> sequenced;
+
+    for (size_t i = 0; i < sequenced.size(); i++)
+        sequenced[i] = sequencer.sequence_sparse(states[i % states.size()]);
+
+    for (size_t i = 0; i < sequenced.size(); i++) {
+        const bool keyframe = i % (PacketSequencer::keyframe_interval + 1) == 0;
+        ok &= std::holds_alternative<QuantizedFullPacket>(sequenced[i].data) == keyframe;
+        ok &= sequenced[i].sequence_id == sequenced[0].sequence_id + i;
+    }
+
+    // replaying the chain reconstructs every state
+    QuantizedFullPacket replayed {};
+    for (size_t i = 0; i < sequenced.size(); i++) {
+        if (auto const* keyframe = std::get_if<QuantizedFullPacket>(&sequenced[i].data))
+            replayed = *keyframe;
+        else
+            std::get<SparseFullPacket>(sequenced[i].data).apply_to(replayed);
+
+        ok &= same(replayed, states[i % states.size()]);
+    }
+
+    sequencer.request_keyframe();
+    ok &= std::holds_alternative<QuantizedFullPacket>(sequencer.sequence_sparse(states[0]).data);
+    ok &= std::holds_alternative<SparseFullPacket>(sequencer.sequence_sparse(states[1]).data);
+
+    // a spooled packet of an earlier session carries on the sequence ids of the current one
+    std::array<uint32_t, 4> rng_vector { 1, 2, 3, 4 };
+    PacketSequencer next_session {};
+    next_session.reset(rng_vector);
+    const uint32_t next_id = next_session.sequence(states[0]).sequence_id + 1;
+    const Packet resequenced = next_session.resequence(sequenced[0]);
+    ok &= resequenced.sequence_id == next_id && resequenced.timestamp == sequenced[0].timestamp;
+    ok &= resequenced.data.index() == sequenced[0].data.index();
+
+    // sparse packets are smaller than keyframes and survive both binary encodings
+    auto binary_round_trips = [&](Packet const& packet) {
+        std::string buffer;
+        PushBackStream stream { buffer };
+        BinaryWriter { stream }.write(packet);
+
+        Packet decoded;
+        BinaryReader reader { std::span(reinterpret_cast<uint8_t const*>(buffer.data()), buffer.size()) };
+        auto res = reader.read(decoded);
+
+        return res && reader.remaining().empty() && decoded.sequence_id == packet.sequence_id
+            && decoded.data.index() == packet.data.index();
+    };
+
+    auto binary_size = [](Packet const& packet) {
+        CountingStream stream {};
+        BinaryWriter { stream }.write(packet);
+        return stream.size();
+    };
+
+    ok &= std::ranges::all_of(sequenced, binary_round_trips);
+    ok &= binary_size(sequenced[1]) < binary_size(sequenced[0]);
+
+    std::string buffer;
+    PushBackStream stream { buffer };
+    ColumnarWriter { stream }.write(std::span<const Packet>(sequenced));
+
+    std::array<Packet, sequenced.size()> decoded;
+    ColumnarReader reader { std::span(reinterpret_cast<uint8_t const*>(buffer.data()), buffer.size()) };
+    auto res = reader.read(std::span<Packet>(decoded));
+    ok &= res && *res == sequenced.size();
+
+    for (size_t i = 0; ok && i < decoded.size(); i++) {
+        ok &= decoded[i].data.index() == sequenced[i].data.index();
+
+        if (auto const* sparse = std::get_if<SparseFullPacket>(&decoded[i].data)) {
+            auto const& expected = std::get<SparseFullPacket>(sequenced[i].data);
+            QuantizedFullPacket lhs = states[0];
+            QuantizedFullPacket rhs = states[0];
+            sparse->apply_to(lhs);
+            expected.apply_to(rhs);
+            ok &= sparse->present == expected.present && same(lhs, rhs);
+        }
+    }
+
+    return ok;
+}
+
+bool common_mode_test() {
+    bool ok = true;
+
+    using Codec = CommonModeCodec<BatteryVoltageGrid>;
+    using Cells = float[27];
+
+    auto encode = []<typename C = Codec>(Cells const& cells) {
+        std::string buffer;
+        PushBackStream stream { buffer };
+        BinaryWriter writer { stream };
+        C::write(writer, cells);
+        return buffer;
+    };
+
+    auto decode = []<typename C = Codec>(std::string_view buffer, Cells& cells) {
+        BinaryReader reader { std::span(reinterpret_cast<uint8_t const*>(buffer.data()), buffer.size()) };
+        auto res = C::read(reader, cells);
+        return res && reader.remaining().empty();
+    };
+
+    // bit for bit, -0.f must not come back as 0.f
+    auto round_trips = [&]<typename C = Codec>(Cells const& cells) {
+        Cells decoded;
+        return decode.template operator()<C>(encode.template operator()<C>(cells), decoded)
+            && std::memcmp(cells, decoded, sizeof(cells)) == 0;
+    };
+
+    auto on_grid = [](Cells& cells, auto raw_of) {
+        std::array<uint8_t, std::size(Cells {})> raw;
+        for (size_t i = 0; i < raw.size(); i++)
+            raw[i] = raw_of(i);
+
+        Kernels::scale_u8(raw, cells, BatteryVoltageGrid::value_step, BatteryVoltageGrid::min);
+    };
+
+    // cells as the CAN decoders produce them take a byte each
+    Cells cells;
+    on_grid(cells, [](size_t i) { return static_cast<uint8_t>(200 + i % 7); });
+    ok &= encode(cells).size() == 2 + std::size(cells) && encode(cells)[0] == Codec::common_mode;
+    ok &= round_trips(cells);
+
+    // residuals at the edges of an int8_t
+    on_grid(cells, [](size_t i) { return static_cast<uint8_t>(i == 0 ? 0 : i == 1 ? 255 : 128); });
+    ok &= encode(cells)[0] == Codec::common_mode;
+    ok &= round_trips(cells);
+
+    // residuals that don't fit
+    on_grid(cells, [](size_t i) { return static_cast<uint8_t>(i < 13 ? 0 : 255); });
+    ok &= encode(cells)[0] == Codec::raw;
+    ok &= round_trips(cells);
+
+    // values off of the grid
+    on_grid(cells, [](size_t) { return static_cast<uint8_t>(200); });
+    cells[5] = std::nextafter(cells[5], 0.f);
+    ok &= encode(cells)[0] == Codec::raw;
+    ok &= round_trips(cells);
+
+    cells[5] = -0.f;
+    ok &= round_trips(cells);
+
+    cells[5] = std::numeric_limits<float>::infinity();
+    ok &= round_trips(cells);
+
+    // cells nothing wrote to take a byte for the whole array
+    std::ranges::fill(cells, 0.f);
+    ok &= encode(cells).size() == 1 && encode(cells)[0] == Codec::unset;
+    ok &= round_trips(cells);
+
+    // the cells past the coded ones are left out, a shorter pack is still on the grid
+    using ShortCodec = CommonModeCodec<BatteryVoltageGrid, 20>;
+    on_grid(cells, [](size_t i) { return static_cast<uint8_t>(200 + i % 7); });
+    std::fill(std::begin(cells) + 20, std::end(cells), 0.f);
+    ok &= encode.operator()<ShortCodec>(cells).size() == 2 + 20;
+    ok &= encode.operator()<ShortCodec>(cells)[0] == ShortCodec::common_mode;
+    ok &= round_trips.operator()<ShortCodec>(cells);
+    ok &= encode(cells)[0] == Codec::raw;
+
+    // whole packets through the schema's codec, the series is on the grid and the batch is not
+    using PacketCodec = CommonModeCodec<BatteryVoltageGrid, k_battery_cell_count>;
+    for (Packet const& packet : make_packet_series()) {
+        FullPacket const& full = std::get<FullPacket>(packet.data);
+        ok &= round_trips.operator()<PacketCodec>(full.battery_voltages);
+        ok &= encode.operator()<PacketCodec>(full.battery_voltages)[0] == PacketCodec::common_mode;
+    }
+
+    for (Packet const& packet : make_packet_batch())
+        ok &= round_trips(std::get<FullPacket>(packet.data).battery_voltages);
+
+    // malformed input
+    on_grid(cells, [](size_t i) { return static_cast<uint8_t>(250 + i % 5); });
+    std::string buffer = encode(cells);
+    ok &= !decode(std::string_view(buffer).substr(0, buffer.size() - 1), cells);
+
+    buffer[1] = static_cast<char>(255);
+    buffer[2] = static_cast<char>(1);
+    ok &= !decode(buffer, cells);
+
+    buffer[0] = 3;
+    ok &= !decode(buffer, cells);
+
+    return ok;
+}
+
+bool resend_window_test() {
+    bool ok = true;
+
+    struct Entry {
+        uint32_t sequence_id;
+    };
+
+    ResendWindow<Entry, 4> window {};
+
+    auto ids = [&] {
+        std::array<Entry, 4> entries;
+        std::array<uint32_t, 4> ret {};
+        const size_t count = window.oldest(entries);
+
+        for (size_t i = 0; i < count; i++)
+            ret[i] = entries[i].sequence_id;
+
+        return std::pair { ret, count };
+    };
+
+    ok &= window.empty() && ids().second == 0;
+
+    for (uint32_t i = 0; i < 4; i++)
+        ok &= !window.push({ i });
+
+    // the oldest one makes room
+    const auto first_evicted = window.push({ 4 });
+    ok &= first_evicted && first_evicted->sequence_id == 0 && window.evictions() == 1;
+    ok &= ids() == std::pair { std::array<uint32_t, 4> { 1, 2, 3, 4 }, size_t(4) };
+
+    // acknowledging from the middle keeps the order
+    ok &= window.acknowledge(2, 3) == 2 && window.room() == 2;
+    ok &= ids() == std::pair { std::array<uint32_t, 4> { 1, 4, 0, 0 }, size_t(2) };
+
+    ok &= window.acknowledge(10, 20) == 0;
+    ok &= !window.push({ 5 }) && !window.push({ 6 });
+    const auto second_evicted = window.push({ 7 });
+    ok &= second_evicted && second_evicted->sequence_id == 1 && window.evictions() == 2;
+    ok &= ids() == std::pair { std::array<uint32_t, 4> { 4, 5, 6, 7 }, size_t(4) };
+
+    // a new session renumbers what is left, oldest first
+    uint32_t next_sequence_id = 0;
+    window.for_each([&](Entry& entry) { entry.sequence_id = next_sequence_id++; });
+    ok &= ids() == std::pair { std::array<uint32_t, 4> { 0, 1, 2, 3 }, size_t(4) };
+
+    // batches smaller than the window get the oldest
+    std::array<Entry, 2> batch;
+    ok &= window.oldest(batch) == 2 && batch[0].sequence_id == 0 && batch[1].sequence_id == 1;
+
+    ok &= window.acknowledge(0, UINT32_MAX) == 4 && window.empty();
+
+    // the packet_full endpoint's response
+    auto ack = GSM::Reply::parse_reply("+CST_ACK 12,345");
+    ok &= ack && std::holds_alternative<GSM::Reply::PacketAck>(*ack);
+    ok &= ack && std::get<GSM::Reply::PacketAck>(*ack).first_sequence_id == 12;
+    ok &= ack && std::get<GSM::Reply::PacketAck>(*ack).last_sequence_id == 345;
+    ok &= !GSM::Reply::parse_reply("+CST_ACK 345,12").has_value();
+
+    // with the window, lost requests and responses cost goodput but barely any packets
+    const float lossy = simulate_uplink(0.2f, true)[0];
+    ok &= lossy > simulate_uplink(0.2f, false)[0];
+    ok &= lossy > simulate_uplink(0.f, true)[0] - 0.01f;
+
+    return ok;
+}
+
+bool flash_spool_test() {
+    bool ok = true;
+
+    using Flash = EmulatedFlash<256, 4>;
+    static Flash flash {};
+    static Flash snapshot {};
+
+    auto record = [](uint32_t id) {
+        std::array<uint8_t, 20> bytes;
+        for (size_t i = 0; i < bytes.size(); i++)
+            bytes[i] = static_cast<uint8_t>(id * 31 + i);
+
+        return std::vector<uint8_t>(bytes.begin(), bytes.begin() + 8 + id % 13);
+    };
+
+    auto append = [&](FlashSpool& spool, uint32_t id) {
+        const auto bytes = record(id);
+        return spool.append(bytes).has_value();
+    };
+
+    auto drains_to = [&](FlashSpool& spool, std::span<const uint32_t> ids) {
+        std::array<uint8_t, 32> buffer;
+        bool ret = spool.pending() == ids.size();
+
+        for (uint32_t id : ids) {
+            const auto expected = record(id);
+            auto length = spool.peek(buffer);
+
+            ret &= length && std::ranges::equal(std::span(buffer).first(*length), expected);
+            ret &= spool.pop().has_value();
+        }
+
+        return ret && spool.pending() == 0 && spool.peek(buffer) == 0;
+    };
+
+    FlashSpool spool { flash };
+    ok &= spool.recover() == 0;
+    ok &= !spool.pop().has_value();
+
+    for (uint32_t id = 0; id < 5; id++)
+        ok &= append(spool, id);
+
+    ok &= spool.pending() == 5;
+
+    std::array<uint8_t, 32> buffer;
+    for (uint32_t id = 0; id < 2; id++)
+        ok &= spool.peek(buffer) == record(id).size() && spool.pop().has_value();
+
+    // what is pending survives a reset, appending carries on after it
+    FlashSpool rebooted { flash };
+    ok &= rebooted.recover() == 3;
+    ok &= append(rebooted, 5);
+    ok &= drains_to(rebooted, std::array<uint32_t, 4> { 2, 3, 4, 5 });
+
+    // records that were read stay pending until they are popped, a rewind or a reset has them read again
+    for (uint32_t id = 10; id < 13; id++)
+        ok &= append(rebooted, id);
+
+    uint32_t ticket;
+    const uint32_t first_ticket = rebooted.oldest_ticket();
+    ok &= rebooted.read(buffer, ticket) == record(10).size() && ticket == first_ticket;
+    ok &= rebooted.read(buffer, ticket) == record(11).size() && ticket == first_ticket + 1;
+    ok &= rebooted.pending() == 3 && rebooted.unread() == 1;
+
+    ok &= rebooted.pop().has_value() && rebooted.oldest_ticket() == first_ticket + 1 && rebooted.unread() == 1;
+    ok &= rebooted.read(buffer, ticket) == record(12).size() && ticket == first_ticket + 2;
+    ok &= rebooted.read(buffer, ticket) == 0;
+
+    rebooted.rewind();
+    ok &= rebooted.unread() == 2 && rebooted.read(buffer, ticket) == record(11).size() && ticket == first_ticket + 1;
+
+    FlashSpool reread { flash };
+    ok &= reread.recover() == 2 && reread.unread() == 2 && reread.oldest_ticket() == 0;
+    ok &= drains_to(rebooted, std::array<uint32_t, 2> { 11, 12 });
+
+    // a full spool drops its oldest records, sectors are reused evenly. records read before being dropped are gone
+    // from what was read too.
+    for (uint32_t id = 0; id < 200; id++) {
+        ok &= append(rebooted, id);
+
+        if (id == 3) {
+            for (uint32_t read_id = 0; read_id < 3; read_id++)
+                ok &= rebooted.read(buffer, ticket) == record(read_id).size();
+        }
+    }
+
+    const auto stats = rebooted.statistics();
+    ok &= stats.dropped != 0 && stats.pending + stats.dropped == 200;
+    ok &= rebooted.unread() == stats.pending;
+
+    const uint32_t oldest_id = static_cast<uint32_t>(200 - stats.pending);
+    ok &= rebooted.read(buffer, ticket) == record(oldest_id).size() && ticket == rebooted.oldest_ticket();
+
+    std::vector<uint32_t> newest(stats.pending);
+    std::iota(newest.begin(), newest.end(), 200 - stats.pending);
+    ok &= drains_to(rebooted, newest);
+
+    uint32_t min_erases = UINT32_MAX;
+    uint32_t max_erases = 0;
+    for (size_t sector = 0; sector < flash.sector_count(); sector++) {
+        min_erases = std::min(min_erases, flash.erase_count(sector));
+        max_erases = std::max(max_erases, flash.erase_count(sector));
+    }
+
+    ok &= max_erases - min_erases <= 1;
+
+    // blank and prepared sectors are started without an erase, one holding pending records is left alone
+    flash = Flash {};
+    FlashSpool preparing { flash };
+    preparing.recover();
+
+    auto started = [&](size_t sector) {
+        std::array<uint8_t, 4> magic;
+        flash.read(sector * flash.sector_size() + 12, magic);
+        return std::bit_cast<uint32_t>(magic) == FlashSpool::sector_magic;
+    };
+
+    ok &= preparing.prepare() == false && append(preparing, 0) && flash.erase_count(0) == 0;
+
+    for (uint32_t id = 1; !started(3) && id < 100; id++)
+        ok &= append(preparing, id);
+
+    ok &= started(3) && preparing.prepare() == false && flash.erase_count(0) == 0;
+    ok &= preparing.discard().has_value() && preparing.prepare() == true && flash.erase_count(0) == 1;
+
+    // a reset doesn't have it erased again
+    FlashSpool prepared_before { flash };
+    ok &= prepared_before.recover() == 0 && prepared_before.prepare() == false;
+
+    for (uint32_t id = 0; !started(0) && id < 100; id++)
+        ok &= append(prepared_before, id);
+
+    ok &= started(0) && flash.erase_count(0) == 1 && prepared_before.statistics().max_erase_count == 2;
+
+    // power is cut at every single erase and program of a workload that appends, consumes, drops records and prepares
+    // sectors. nothing is lost but what was being consumed or dropped at the time, nothing torn comes back.
+    flash = Flash {};
+    FlashSpool initial { flash };
+    initial.recover();
+
+    for (uint32_t id = 0; id < 30; id++)
+        ok &= append(initial, id);
+
+    for (uint32_t id = 0; id < 10; id++)
+        ok &= initial.pop().has_value();
+
+    snapshot = flash;
+
+    for (size_t cut = 0;; cut++) {
+        flash = snapshot;
+
+        FlashSpool crashing { flash };
+        crashing.recover();
+
+        std::vector<uint32_t> pending(20);
+        std::iota(pending.begin(), pending.end(), 10);
+        size_t popped = 0;
+
+        flash.cut_power_after(cut);
+
+        for (uint32_t id = 100; id < 130; id++) {
+            if (!append(crashing, id))
+                break;
+
+            pending.push_back(id);
+
+            if (id % 4 == 3) {
+                if (!crashing.pop().has_value())
+                    break;
+
+                popped++;
+            }
+
+            if (id % 8 == 0 && !crashing.prepare().has_value())
+                break;
+        }
+
+        const bool finished = flash.powered();
+        flash.restore_power();
+
+        FlashSpool recovered { flash };
+        recovered.recover();
+
+        ok &= append(recovered, 999);
+        pending.push_back(999);
+
+        const size_t gone = popped + crashing.statistics().dropped + recovered.statistics().dropped;
+        ok &= gone < pending.size() && drains_to(recovered, std::span(pending).subspan(gone));
+
+        if (finished)
+            break;
+    }
+
+    return ok;
+}
+
+}
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include <tl/expected.hpp>
+
+#include <Tele/MemberOrder.hpp>
+
+namespace Tele {
+
+enum class BinaryEncoding : uint8_t {
+    /// LEB128 varints for unsigned integers, zigzag varints for signed ones
+    Compact,
+
+    /// little endian, as wide as the type
+    Fixed,
+};
+
+namespace Detail {
+
+template<auto Member, BinaryEncoding Encoding, typename Codec = void> struct BinaryField {
+    inline static constexpr auto member = Member;
+    inline static constexpr BinaryEncoding encoding = Encoding;
+    using codec = Codec;
+};
+
+}
+
+/// The fields of a struct in wire order, see `BinaryWriter`.\n
+/// Declare one through an ADL function next to the struct's introspector:
+/// @code
+/// inline constexpr auto _tele_adl_binary_schema(FullPacket&&) {
+///     return Tele::BinarySchema<FullPacket> {} //
+///       .field<&FullPacket::rpm>()
+///       .field<&FullPacket::tick_counter, Tele::BinaryEncoding::Fixed>();
+/// }
+/// @endcode
+/// @remarks
+/// Fields are not tagged and arrays are not length prefixed, whoever decodes must know the schema. Version the schemas
+/// on the wire and bump the version whenever a field is added, removed, reordered or changes its type or codec.\n
+/// Fields added through `coded_field` are written by `Codec::write(writer, v)` and read by `Codec::read(reader, v)`
+/// instead. The columnar encoding doesn't use codecs, it codes every field by its type.\n
+/// Schemas of whole structs `static_assert` `is_complete`, so that they can't fall behind the struct.
+template<typename Struct, typename... Fields> struct BinarySchema {
+    inline static constexpr size_t field_count = sizeof...(Fields);
+
+    /// Whether the fields are every member of `Struct`, in the order they are declared in.
+    inline static constexpr bool is_complete = covers_every_member<Struct, Fields::member...>();
+
+    template<auto Member, BinaryEncoding Encoding = BinaryEncoding::Compact> constexpr auto field() const {
+        return BinarySchema<Struct, Fields..., Detail::BinaryField<Member, Encoding>> {};
+    }
+
+    template<auto Member, typename Codec> constexpr auto coded_field() const {
+        return BinarySchema<Struct, Fields..., Detail::BinaryField<Member, BinaryEncoding::Compact, Codec>> {};
+    }
+
+    template<typename Fn> static constexpr void for_each_field(Fn&& fn) { (fn(Fields {}), ...); }
+};
+
+template<typename T>
+concept BinarySchematized = requires(T&& v) { _tele_adl_binary_schema(std::move(v)); };
+
+/// Wrappers like `Fixed` are written as the integer `_tele_adl_binary_repr` returns a reference to.
+template<typename T>
+concept BinaryRepresented = requires(T& v) { _tele_adl_binary_repr(v); };
+
+/// Types with a layout of their own provide `_tele_adl_binary_write(writer, v)` and `_tele_adl_binary_read(reader, v)`,
+/// the latter returning a `tl::expected<void, std::string_view>`.
+template<typename T, typename Writer>
+concept BinaryCustomWritten = requires(Writer& writer, T const& v) { _tele_adl_binary_write(writer, v); };
+
+template<typename T, typename Reader>
+concept BinaryCustomRead = requires(Reader& reader, T& v) { _tele_adl_binary_read(reader, v); };
+
+namespace Detail {
+
+template<typename T> struct IsStdArray : std::false_type { };
+template<typename T, size_t N> struct IsStdArray<std::array<T, N>> : std::true_type { };
+
+template<typename T> struct IsVariant : std::false_type { };
+template<typename... Ts> struct IsVariant<std::variant<Ts...>> : std::true_type { };
+
+template<typename T> struct IsSpan : std::false_type { };
+template<typename T, size_t Extent> struct IsSpan<std::span<T, Extent>> : std::true_type { };
+
+template<std::signed_integral T> constexpr std::make_unsigned_t<T> zigzag_encode(T v) {
+    using U = std::make_unsigned_t<T>;
+    return static_cast<U>((static_cast<U>(v) << 1) ^ static_cast<U>(v >> (sizeof(T) * 8 - 1)));
+}
+
+template<std::unsigned_integral U> constexpr std::make_signed_t<U> zigzag_decode(U v) {
+    return static_cast<std::make_signed_t<U>>((v >> 1) ^ (~(v & 1) + 1));
+}
+
+}
+
+/// Writes values tag-less and little endian, structs through their `BinarySchema`.
+/// @remarks
+/// Floats are written as their four bytes. Spans are prefixed by their length as a varint, variants by their index.
+template<typename Stream> struct BinaryWriter {
+    constexpr BinaryWriter(Stream& stream)
+        : m_stream(stream) { }
+
+    constexpr void write_byte(uint8_t v) { m_stream << static_cast<char>(v); }
+
+    constexpr void write_varint(uint64_t v) {
+        std::array<char, 10> buffer;
+        size_t size = 0;
+
+        do {
+            const uint8_t low = v & 0x7F;
+            v >>= 7;
+            buffer[size++] = static_cast<char>(low | (v != 0 ? 0x80 : 0));
+        } while (v != 0);
+
+        m_stream << std::string_view(buffer.data(), size);
+    }
+
+    template<std::integral T> constexpr void write_fixed(T v) {
+        std::array<char, sizeof(T)> buffer;
+
+        for (size_t i = 0; i < sizeof(T); i++)
+            buffer[i] = static_cast<char>(static_cast<std::make_unsigned_t<T>>(v) >> (i * 8));
+
+        m_stream << std::string_view(buffer.data(), buffer.size());
+    }
+
+    template<typename T> constexpr void write(T const& v, BinaryEncoding encoding = BinaryEncoding::Compact) {
+        if constexpr (std::is_same_v<T, bool>) {
+            write_byte(v ? 1 : 0);
+        } else if constexpr (std::is_enum_v<T>) {
+            write(static_cast<std::underlying_type_t<T>>(v), encoding);
+        } else if constexpr (std::unsigned_integral<T>) {
+            if (encoding == BinaryEncoding::Fixed)
+                write_fixed(v);
+            else
+                write_varint(v);
+        } else if constexpr (std::signed_integral<T>) {
+            if (encoding == BinaryEncoding::Fixed)
+                write_fixed(v);
+            else
+                write_varint(Detail::zigzag_encode(v));
+        } else if constexpr (std::is_same_v<T, float>) {
+            write_fixed(std::bit_cast<uint32_t>(v));
+        } else if constexpr (std::is_array_v<T> || Detail::IsStdArray<T>::value) {
+            for (auto const& element : v)
+                write(element, encoding);
+        } else if constexpr (Detail::IsSpan<T>::value) {
+            write_varint(v.size());
+            for (auto const& element : v)
+                write(element, encoding);
+        } else if constexpr (Detail::IsVariant<T>::value) {
+            write_varint(v.index());
+            std::visit([this, encoding](auto const& alternative) { write(alternative, encoding); }, v);
+        } else if constexpr (BinaryCustomWritten<T, BinaryWriter>) {
+            _tele_adl_binary_write(*this, v);
+        } else if constexpr (BinaryRepresented<T>) {
+            write(_tele_adl_binary_repr(v), encoding);
+        } else if constexpr (BinarySchematized<T>) {
+            decltype(_tele_adl_binary_schema(T {}))::for_each_field([this, &v]<typename Field>(Field) {
+                write_field<Field>(v.*Field::member);
+            });
+        } else {
+            static_assert(!std::is_same_v<T, T>, "the type has no binary representation");
+        }
+    }
+
+    /// Writes the member `Field` of a `BinarySchema` describes, through its codec if it has one.
+    template<typename Field, typename T> constexpr void write_field(T const& v) {
+        if constexpr (std::is_void_v<typename Field::codec>)
+            write(v, Field::encoding);
+        else
+            Field::codec::write(*this, v);
+    }
+
+private:
+    Stream& m_stream;
+};
+
+/// Reads what `BinaryWriter` writes.
+struct BinaryReader {
+    constexpr BinaryReader(std::span<const uint8_t> data)
+        : m_data(data) { }
+
+    /// The bytes that have not been read yet.
+    constexpr std::span<const uint8_t> remaining() const { return m_data; }
+
+    constexpr tl::expected<uint8_t, std::string_view> read_byte() {
+        if (m_data.empty())
+            return tl::unexpected { "truncated input" };
+
+        const uint8_t ret = m_data[0];
+        m_data = m_data.subspan(1);
+        return ret;
+    }
+
+    constexpr tl::expected<uint64_t, std::string_view> read_varint() {
+        uint64_t ret = 0;
+
+        for (size_t shift = 0; shift < 64; shift += 7) {
+            auto byte = read_byte();
+            if (!byte)
+                return tl::unexpected { byte.error() };
+
+            ret |= static_cast<uint64_t>(*byte & 0x7F) << shift;
+
+            if ((*byte & 0x80) == 0)
+                return ret;
+        }
+
+        return tl::unexpected { "varint too long" };
+    }
+
+    template<std::integral T> constexpr tl::expected<T, std::string_view> read_fixed() {
+        if (m_data.size() < sizeof(T))
+            return tl::unexpected { "truncated input" };
+
+        std::make_unsigned_t<T> ret = 0;
+        for (size_t i = 0; i < sizeof(T); i++)
+            ret |= static_cast<std::make_unsigned_t<T>>(m_data[i]) << (i * 8);
+
+        m_data = m_data.subspan(sizeof(T));
+        return static_cast<T>(ret);
+    }
+
+    /// Spans are not supported as they don't own their elements.
+    template<typename T>
+    constexpr tl::expected<void, std::string_view> read(T& out, BinaryEncoding encoding = BinaryEncoding::Compact) {
+        if constexpr (std::is_same_v<T, bool>) {
+            auto byte = read_byte();
+            if (!byte)
+                return tl::unexpected { byte.error() };
+            out = *byte != 0;
+        } else if constexpr (std::is_enum_v<T>) {
+            std::underlying_type_t<T> raw;
+            if (auto res = read(raw, encoding); !res)
+                return res;
+            out = static_cast<T>(raw);
+        } else if constexpr (std::integral<T>) {
+            if (encoding == BinaryEncoding::Fixed) {
+                auto res = read_fixed<T>();
+                if (!res)
+                    return tl::unexpected { res.error() };
+                out = *res;
+            } else {
+                auto res = read_varint();
+                if (!res)
+                    return tl::unexpected { res.error() };
+
+                if constexpr (std::signed_integral<T>)
+                    out = static_cast<T>(Detail::zigzag_decode(*res));
+                else
+                    out = static_cast<T>(*res);
+            }
+        } else if constexpr (std::is_same_v<T, float>) {
+            auto res = read_fixed<uint32_t>();
+            if (!res)
+                return tl::unexpected { res.error() };
+            out = std::bit_cast<float>(*res);
+        } else if constexpr (std::is_array_v<T> || Detail::IsStdArray<T>::value) {
+            for (auto& element : out) {
+                if (auto res = read(element, encoding); !res)
+                    return res;
+            }
+        } else if constexpr (Detail::IsVariant<T>::value) {
+            auto index = read_varint();
+            if (!index)
+                return tl::unexpected { index.error() };
+            return read_alternative(out, *index, encoding, std::make_index_sequence<std::variant_size_v<T>> {});
+        } else if constexpr (BinaryCustomRead<T, BinaryReader>) {
+            return _tele_adl_binary_read(*this, out);
+        } else if constexpr (BinaryRepresented<T>) {
+            return read(_tele_adl_binary_repr(out), encoding);
+        } else if constexpr (BinarySchematized<T>) {
+            tl::expected<void, std::string_view> ret {};
+            decltype(_tele_adl_binary_schema(T {}))::for_each_field([this, &out, &ret]<typename Field>(Field) {
+                if (ret)
+                    ret = read_field<Field>(out.*Field::member);
+            });
+            return ret;
+        } else {
+            static_assert(!std::is_same_v<T, T>, "the type has no binary representation");
+        }
+
+        return {};
+    }
+
+    /// Reads what `BinaryWriter::write_field` writes.
+    template<typename Field, typename T> constexpr tl::expected<void, std::string_view> read_field(T& out) {
+        if constexpr (std::is_void_v<typename Field::codec>)
+            return read(out, Field::encoding);
+        else
+            return Field::codec::read(*this, out);
+    }
+
+private:
+    std::span<const uint8_t> m_data;
+
+    template<typename Variant, size_t... Is>
+    constexpr tl::expected<void, std::string_view>
+    read_alternative(Variant& out, uint64_t index, BinaryEncoding encoding, std::index_sequence<Is...>) {
+        tl::expected<void, std::string_view> ret = tl::unexpected { "bad variant index" };
+
+        std::ignore = ((index == Is ? (ret = read(out.template emplace<Is>(), encoding), true) : false) || ...);
+
+        return ret;
+    }
+};
+
+}
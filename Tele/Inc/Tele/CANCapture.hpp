@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include <tl/expected.hpp>
+
+#include <Tele/DataCollector.hpp>
+
+namespace Tele {
+
+struct CANFrame;
+
+/// A captured standard CAN frame.
+/// @remarks
+/// Records are stored and dumped as 16 little endian bytes:
+/// <br/>
+/// [0, 4): the microseconds from the start of the capture to the reception, wraps around every ~71 minutes
+/// <br/>
+/// [4, 6): the ID in bits [0, 11), the FIFO in bit 11 and the DLC in bits [12, 16)
+/// <br/>
+/// [6, 8): the capture sequence number, gaps indicate frames that were overwritten before the dump
+/// <br/>
+/// [8, 16): the payload, zero padded
+struct CANCaptureRecord {
+    inline static constexpr size_t size = 16;
+
+    uint32_t timestamp;
+    uint16_t id;
+    uint8_t fifo;
+    uint8_t length;
+    uint16_t sequence;
+    std::array<uint8_t, 8> data;
+
+    constexpr std::array<uint8_t, size> to_bytes() const {
+        const uint16_t id_flags = static_cast<uint16_t>((id & 0x7FF) | ((fifo & 1) << 11) | ((length & 0xF) << 12));
+
+        return {
+            static_cast<uint8_t>(timestamp),       static_cast<uint8_t>(timestamp >> 8),
+            static_cast<uint8_t>(timestamp >> 16), static_cast<uint8_t>(timestamp >> 24),
+            static_cast<uint8_t>(id_flags),        static_cast<uint8_t>(id_flags >> 8),
+            static_cast<uint8_t>(sequence),        static_cast<uint8_t>(sequence >> 8),
+            data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7],
+        };
+    }
+
+    static constexpr CANCaptureRecord from_bytes(std::span<const uint8_t, size> bytes) {
+        const uint16_t id_flags = static_cast<uint16_t>(bytes[4] | (bytes[5] << 8));
+
+        return {
+            .timestamp = static_cast<uint32_t>(bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24)),
+            .id = static_cast<uint16_t>(id_flags & 0x7FF),
+            .fifo = static_cast<uint8_t>((id_flags >> 11) & 1),
+            .length = static_cast<uint8_t>(std::min(id_flags >> 12, 8)),
+            .sequence = static_cast<uint16_t>(bytes[6] | (bytes[7] << 8)),
+            .data = { bytes[8], bytes[9], bytes[10], bytes[11], bytes[12], bytes[13], bytes[14], bytes[15] },
+        };
+    }
+};
+
+/// A RAM ring of the most recent CAN frames, for reproducing decoder issues and profiling without the vehicle.
+/// @remarks
+/// The ring is written from the RX ISR while running, it must be stopped before it is read, loaded or replayed.
+struct CANCapture {
+    inline static constexpr size_t capacity = 256;
+    /// Bumped whenever the layout or the meaning of a record changes, see `load`.
+    inline static constexpr uint16_t format_version = 2;
+
+    struct ReplayStatistics {
+        uint32_t frames;
+        uint32_t decoded;
+        uint32_t unknown;
+        uint32_t malformed;
+
+        /// FIFO1 frames, these are not decoded
+        uint32_t heartbeats;
+
+        /// the time span of the capture
+        uint64_t capture_us;
+
+        /// the time span of the replay, in cycles
+        uint64_t replay_cycles;
+
+        /// the time spent in the decoder alone
+        uint64_t decode_cycles;
+        uint32_t max_decode_cycles;
+    };
+
+    void start();
+
+    void stop() { m_running.store(false, std::memory_order_relaxed); }
+
+    bool running() const { return m_running.load(std::memory_order_relaxed); }
+
+    void clear();
+
+    /// @param timestamp
+    /// `cycle_count()` at the reception of the frame.
+    /// @remarks
+    /// This function must be called from an ISR, extended frames are not recorded.
+    void isr_record(CANFrame const& frame, uint32_t timestamp);
+
+    /// The amount of records held, at most `capacity`.
+    size_t size() const { return std::min<size_t>(m_written.load(std::memory_order_relaxed), capacity); }
+
+    /// @param index
+    /// 0 being the oldest record held.
+    CANCaptureRecord record(size_t index) const;
+
+    /// Appends a record as if it was captured, for replaying captures taken elsewhere.
+    /// @param version
+    /// The `format_version` the record was dumped with, records of other versions are refused.
+    tl::expected<void, std::string_view> load(uint16_t version, CANCaptureRecord const& record);
+
+    /// Decodes every record, oldest first, into `collector` as fast as possible.
+    ReplayStatistics replay(DataCollectorTask& collector) const;
+
+private:
+    std::atomic_bool m_running { false };
+    std::atomic<uint32_t> m_written { 0 };
+
+    /*
+     * The time since `start`, only touched by `start` and the ISR. The DWT cycle counter wraps every ~25 seconds, the
+     * high frequency ticks elapsed between two records tell how many times it did.
+     */
+    uint64_t m_elapsed_cycles = 0;
+    uint32_t m_last_cycles = 0;
+    uint32_t m_last_ticks = 0;
+
+    std::array<std::array<uint8_t, CANCaptureRecord::size>, capacity> m_records {};
+};
+
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+
+#include <main.h>
+
+namespace Tele {
+
+/// A 16 bit scale bxCAN filter bank for standard data frames.
+/// @remarks
+/// `values` are in the register format, `std_id << 5` with the RTR and IDE bits clear. In list mode these are four
+/// accepted IDs, in mask mode two (ID, mask) pairs. Masks always cover the RTR and IDE bits so that remote and extended
+/// frames are rejected.
+struct CANFilterBank {
+    inline static constexpr uint16_t rtr_ide_bits = 0x18;
+
+    bool mask_mode;
+    uint8_t fifo;
+    std::array<uint16_t, 4> values;
+
+    static constexpr uint16_t encode_id(uint16_t std_id) { return static_cast<uint16_t>((std_id & 0x7FF) << 5); }
+
+    static constexpr uint16_t encode_mask(uint16_t std_mask) {
+        return static_cast<uint16_t>(((std_mask & 0x7FF) << 5) | rtr_ide_bits);
+    }
+
+    /// Whether the bank lets a standard data frame with the ID `std_id` through, the same way the hardware does.
+    constexpr bool accepts(uint16_t std_id) const {
+        const uint16_t encoded = encode_id(std_id);
+
+        if (mask_mode)
+            return ((encoded ^ values[0]) & values[1]) == 0 || ((encoded ^ values[2]) & values[3]) == 0;
+
+        return std::ranges::find(values, encoded) != values.end();
+    }
+
+    CAN_FilterTypeDef to_hal(uint32_t bank, uint32_t slave_start_bank) const {
+        // HAL packs FR1 from the `Low` halves and FR2 from the `High` halves in 16 bit scale
+        return {
+            .FilterIdHigh = values[2],
+            .FilterIdLow = values[0],
+            .FilterMaskIdHigh = values[3],
+            .FilterMaskIdLow = values[1],
+            .FilterFIFOAssignment = fifo == 0 ? CAN_FILTER_FIFO0 : CAN_FILTER_FIFO1,
+            .FilterBank = bank,
+            .FilterMode = mask_mode ? CAN_FILTERMODE_IDMASK : CAN_FILTERMODE_IDLIST,
+            .FilterScale = CAN_FILTERSCALE_16BIT,
+            .FilterActivation = ENABLE,
+            .SlaveStartFilterBank = slave_start_bank,
+        };
+    }
+};
+
+/// A set of filter banks that accepts exactly a given set of standard IDs.
+template<size_t Capacity> struct CANFilterPlan {
+    std::array<CANFilterBank, Capacity> banks {};
+    size_t size = 0;
+
+    /// The FIFO a standard data frame with the ID `std_id` lands in, `std::nullopt` if it is filtered out.
+    /// @remarks
+    /// Like the hardware, the lowest numbered bank that accepts the frame wins.
+    constexpr std::optional<uint8_t> fifo_of(uint16_t std_id) const {
+        for (size_t i = 0; i < size; i++) {
+            if (banks[i].accepts(std_id))
+                return banks[i].fifo;
+        }
+
+        return std::nullopt;
+    }
+
+    /// Configures the banks starting from bank 0 of the CAN1 half.
+    HAL_StatusTypeDef configure(CAN_HandleTypeDef& handle, uint32_t slave_start_bank = 14) const {
+        for (size_t i = 0; i < size; i++) {
+            CAN_FilterTypeDef filter = banks[i].to_hal(i, slave_start_bank);
+
+            if (HAL_StatusTypeDef res = HAL_CAN_ConfigFilter(&handle, &filter); res != HAL_OK)
+                return res;
+        }
+
+        return HAL_OK;
+    }
+};
+
+namespace Detail {
+
+inline constexpr size_t k_standard_id_count = 0x800;
+
+/// Packs the IDs present in `present` into banks routed to `fifo`.
+/// @remarks
+/// Aligned power of two runs of at least four IDs become mask mode slots, two per bank, everything else goes into list
+/// mode slots, four per bank. Both the runs and the lone IDs are accepted exactly, nothing else gets through.
+template<size_t Capacity>
+constexpr void pack_can_filters(
+  CANFilterPlan<Capacity>& plan, std::array<bool, k_standard_id_count> present, uint8_t fifo
+) {
+    std::array<uint16_t, k_standard_id_count * 2> mask_slots {};
+    size_t mask_slot_count = 0;
+
+    for (size_t run = k_standard_id_count; run >= 4; run /= 2) {
+        for (size_t base = 0; base < k_standard_id_count; base += run) {
+            if (!std::all_of(present.begin() + base, present.begin() + base + run, std::identity {}))
+                continue;
+
+            std::fill(present.begin() + base, present.begin() + base + run, false);
+            mask_slots[mask_slot_count++] = CANFilterBank::encode_id(static_cast<uint16_t>(base));
+            mask_slots[mask_slot_count++] = CANFilterBank::encode_mask(static_cast<uint16_t>(~(run - 1)));
+        }
+    }
+
+    std::array<uint16_t, k_standard_id_count> list_slots {};
+    size_t list_slot_count = 0;
+
+    for (size_t id = 0; id < k_standard_id_count; id++) {
+        if (present[id])
+            list_slots[list_slot_count++] = CANFilterBank::encode_id(static_cast<uint16_t>(id));
+    }
+
+    // unused slots repeat the last used one of their bank
+    for (size_t i = 0; i < mask_slot_count; i += 4) {
+        CANFilterBank& bank = plan.banks[plan.size++];
+        bank = { .mask_mode = true, .fifo = fifo, .values {} };
+
+        for (size_t j = 0; j < 4; j++)
+            bank.values[j] = mask_slots[std::min(i + j, mask_slot_count - 2 + j % 2)];
+    }
+
+    for (size_t i = 0; i < list_slot_count; i += 4) {
+        CANFilterBank& bank = plan.banks[plan.size++];
+        bank = { .mask_mode = false, .fifo = fifo, .values {} };
+
+        for (size_t j = 0; j < 4; j++)
+            bank.values[j] = list_slots[std::min(i + j, list_slot_count - 1)];
+    }
+}
+
+}
+
+/// Computes the banks accepting exactly `fifo0_ids` into FIFO0 and `fifo1_ids` into FIFO1.
+/// @remarks
+/// An ID must not be in both sets. This is evaluated at compile time only as it needs a few kilobytes of scratch space.
+template<size_t N0, size_t N1>
+consteval auto plan_can_filters(std::array<uint16_t, N0> const& fifo0_ids, std::array<uint16_t, N1> const& fifo1_ids) {
+    // every mask slot replaces at least four list slots
+    CANFilterPlan<(N0 + 3) / 4 + 1 + (N1 + 3) / 4 + 1> plan {};
+
+    std::array<bool, Detail::k_standard_id_count> present_0 {};
+    for (uint16_t id : fifo0_ids)
+        present_0[id & 0x7FF] = true;
+
+    std::array<bool, Detail::k_standard_id_count> present_1 {};
+    for (uint16_t id : fifo1_ids) {
+        if (present_0[id & 0x7FF])
+            throw std::invalid_argument("an ID can't be routed to both FIFOs");
+
+        present_1[id & 0x7FF] = true;
+    }
+
+    Detail::pack_can_filters(plan, present_0, 0);
+    Detail::pack_can_filters(plan, present_1, 1);
+
+    return plan;
+}
+
+}
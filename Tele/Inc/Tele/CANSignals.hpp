@@ -0,0 +1,328 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <Tele/Channels.hpp>
+#include <Tele/DataCollector.hpp>
+#include <Tele/Kernels.hpp>
+
+namespace Tele {
+
+enum class SignalEncoding : uint8_t {
+    Unsigned,
+    Signed,
+
+    /// IEEE-754 binary32, `length` must be 32
+    Float,
+};
+
+/// Where a signal lives in a frame and how its raw value maps to a physical one, DBC style.
+/// @remarks
+/// Bits are numbered like in DBC files: bit `b` of byte `k` is `k * 8 + b`. `start_bit` is the least significant bit
+/// of little endian (Intel) signals and the most significant bit of big endian (Motorola) ones.
+/// <br/>
+/// A signal with a `count` greater than one describes `count` consecutive values, `stride` bits apart, written to
+/// consecutive elements of the target channel starting from `element`. The big endian start bits of elements are
+/// computed the same way and are thus only meaningful for byte aligned elements. A `count` of zero disables the signal,
+/// which comes in handy for layouts that depend on the configuration.
+struct SignalLayout {
+    uint8_t start_bit;
+    uint8_t length;
+    std::endian byte_order = std::endian::little;
+    SignalEncoding encoding = SignalEncoding::Unsigned;
+
+    /// physical = raw * scale + offset
+    float scale = 1.f;
+    float offset = 0.f;
+
+    uint8_t count = 1;
+    uint8_t stride = length;
+    uint16_t element = 0;
+
+    /// Scale and offset mapping the raw range [0, 2^length - 1] onto [min, max], like `Stf::map` does.
+    constexpr SignalLayout with_range(float min, float max) const {
+        SignalLayout ret = *this;
+        ret.scale = (max - min) / static_cast<float>((uint64_t(1) << length) - 1);
+        ret.offset = min;
+        return ret;
+    }
+};
+
+enum class DecodeResult : uint8_t {
+    Decoded,
+
+    /// no message in the table has the ID
+    Unknown,
+
+    /// the frame was shorter than the message
+    Malformed,
+};
+
+namespace Detail {
+
+struct FrameWords {
+    /// byte `k` at bits [k * 8, k * 8 + 8)
+    uint64_t little;
+
+    /// byte `k` at bits [(7 - k) * 8, (7 - k) * 8 + 8)
+    uint64_t big;
+};
+
+inline FrameWords load_frame(std::span<const uint8_t> data) {
+    FrameWords ret { 0, 0 };
+
+    for (size_t i = 0; i < 8; i++) {
+        const uint64_t byte = i < data.size() ? data[i] : 0;
+        ret.little |= byte << (i * 8);
+        ret.big = (ret.big << 8) | byte;
+    }
+
+    return ret;
+}
+
+template<SignalLayout Layout, size_t Index> inline float extract_signal(FrameWords const& words) {
+    constexpr size_t start = Layout.start_bit + Index * Layout.stride;
+    constexpr uint64_t mask = (uint64_t(1) << Layout.length) - 1;
+
+    static_assert(Layout.length != 0 && Layout.length <= 32, "signals are at most 32 bits long");
+
+    uint64_t raw;
+    if constexpr (Layout.byte_order == std::endian::little) {
+        static_assert(start + Layout.length <= 64, "the signal doesn't fit in a frame");
+        raw = (words.little >> start) & mask;
+    } else {
+        // the position of the msb in the big endian word
+        constexpr size_t msb = (7 - start / 8) * 8 + start % 8;
+        static_assert(msb + 1 >= Layout.length, "the signal doesn't fit in a frame");
+        raw = (words.big >> (msb + 1 - Layout.length)) & mask;
+    }
+
+    float value;
+    if constexpr (Layout.encoding == SignalEncoding::Float) {
+        static_assert(Layout.length == 32);
+        value = std::bit_cast<float>(static_cast<uint32_t>(raw));
+    } else if constexpr (Layout.encoding == SignalEncoding::Signed) {
+        constexpr size_t shift = 64 - Layout.length;
+        value = static_cast<float>(static_cast<int64_t>(raw << shift) >> shift);
+    } else {
+        value = static_cast<float>(raw);
+    }
+
+    if constexpr (Layout.scale != 1.f)
+        value *= Layout.scale;
+
+    if constexpr (Layout.offset != 0.f)
+        value += Layout.offset;
+
+    return value;
+}
+
+template<SignalLayout Layout> inline std::array<float, Layout.count> extract_signals(FrameWords const& words) {
+    std::array<float, Layout.count> values;
+
+    constexpr bool packed_bytes = Layout.length == 8 && Layout.stride == 8 && Layout.start_bit % 8 == 0
+                               && Layout.byte_order == std::endian::little
+                               && Layout.encoding == SignalEncoding::Unsigned;
+
+    if constexpr (packed_bytes && Layout.count >= 4 && std::endian::native == std::endian::little) {
+        const auto bytes = std::bit_cast<std::array<uint8_t, 8>>(words.little);
+        Kernels::scale_u8(
+          std::span(bytes).subspan(Layout.start_bit / 8, Layout.count), values, Layout.scale, Layout.offset
+        );
+    } else {
+        [&]<size_t... Is>(std::index_sequence<Is...>) {
+            ((values[Is] = extract_signal<Layout, Is>(words)), ...);
+        }(std::make_index_sequence<Layout.count> {});
+    }
+
+    return values;
+}
+
+template<SignalLayout Layout> constexpr size_t min_length_of() {
+    if (Layout.count == 0)
+        return 0;
+
+    const size_t last_start = Layout.start_bit + (Layout.count - 1) * Layout.stride;
+
+    if (Layout.byte_order == std::endian::little)
+        return (last_start + Layout.length - 1) / 8 + 1;
+
+    // big endian signals grow towards higher bytes from their msb
+    const size_t msb = (7 - last_start / 8) * 8 + last_start % 8;
+    const size_t lsb = msb + 1 - Layout.length;
+    return 7 - lsb / 8 + 1;
+}
+
+}
+
+/// A signal decoded into the channel `Target`.
+template<auto const& Target, SignalLayout Layout> struct Signal {
+    using channel_type = std::remove_cvref_t<decltype(Target)>;
+
+    inline static constexpr SignalLayout layout = Layout;
+
+    /// The minimum frame length this signal requires.
+    inline static constexpr size_t min_length = Detail::min_length_of<Layout>();
+
+    static_assert(std::is_same_v<typename channel_type::value_type, float>, "signals decode into float channels");
+    static_assert(Layout.element + Layout.count <= channel_type::extent, "the signal overruns its channel");
+    static_assert(min_length <= 8, "the signal doesn't fit in a frame");
+
+    /// Whether `decode` has anything to write for this frame.
+    template<typename State> static constexpr bool stage(Detail::FrameWords const&, State&) {
+        return Layout.count != 0;
+    }
+
+    template<typename State>
+    static void decode(Detail::FrameWords const& words, DataCollectorTask::Writer& writer, State&) {
+        if constexpr (Layout.count != 0) {
+            const std::array<float, Layout.count> values = Detail::extract_signals<Layout>(words);
+
+            if constexpr (channel_type::extent == 1) {
+                writer.set(Target, values[0]);
+            } else {
+                writer.set_array<float>(Target, values, Layout.element);
+            }
+        }
+    }
+};
+
+/// The first `Elements` elements of the array channel `Target`, gathered from several messages by `StagedSignal`s.
+/// @remarks
+/// The elements are written at once when all of them have been decoded, along with `Generation` which counts these
+/// commits. Both are written in the same publish so readers never see a mix of two sets.
+/// <br/>
+/// An element decoded again before the set is complete starts a new set, the partial one is discarded and counted in
+/// `discarded`.
+template<
+  auto const& Target, auto const& Generation, size_t Elements = std::remove_cvref_t<decltype(Target)>::extent>
+struct StagingBlock {
+    using channel_type = std::remove_cvref_t<decltype(Target)>;
+
+    static_assert(std::is_same_v<typename channel_type::value_type, float>, "signals decode into float channels");
+    static_assert(Elements <= channel_type::extent, "the block overruns its channel");
+    static_assert(Elements != 0 && Elements <= 64, "blocks track at most 64 elements");
+
+    inline static constexpr uint64_t complete_mask = Elements == 64 ? ~uint64_t(0) : (uint64_t(1) << Elements) - 1;
+
+    std::array<float, Elements> values {};
+    uint64_t staged = 0;
+    uint32_t generation = 0;
+    uint32_t discarded = 0;
+
+    /// Stages `vs` as the elements starting at `First`.
+    /// @return
+    /// Whether the set is complete, `commit` it then.
+    template<size_t First, size_t Count> bool stage(std::array<float, Count> const& vs) {
+        static_assert(First + Count <= Elements, "the signal overruns its block");
+
+        constexpr uint64_t mask = ((uint64_t(1) << Count) - 1) << First;
+
+        if ((staged & mask) != 0) {
+            discarded++;
+            staged = 0;
+        }
+
+        std::ranges::copy(vs, values.begin() + First);
+        staged |= mask;
+
+        if (staged != complete_mask)
+            return false;
+
+        staged = 0;
+        return true;
+    }
+
+    void commit(DataCollectorTask::Writer& writer) {
+        writer.set_array<float>(Target, values);
+        writer.set(Generation, ++generation);
+    }
+};
+
+/// A signal decoded into the `StagingBlock` `Block` instead of straight into its channel.
+/// @remarks
+/// The block lives in the decoder state that is passed to `MessageTable::decode`.
+template<typename Block, SignalLayout Layout> struct StagedSignal {
+    inline static constexpr SignalLayout layout = Layout;
+    inline static constexpr size_t min_length = Detail::min_length_of<Layout>();
+
+    static_assert(min_length <= 8, "the signal doesn't fit in a frame");
+
+    /// Stages the signal into its block.
+    /// @return
+    /// Whether that completed the block.
+    template<typename State> static bool stage(Detail::FrameWords const& words, State& state) {
+        if constexpr (Layout.count != 0) {
+            return std::get<Block>(state).template stage<Layout.element>(Detail::extract_signals<Layout>(words));
+        } else {
+            return false;
+        }
+    }
+
+    /// Commits the block, call only if `stage` completed it.
+    template<typename State>
+    static void decode(Detail::FrameWords const&, DataCollectorTask::Writer& writer, State& state) {
+        std::get<Block>(state).commit(writer);
+    }
+};
+
+/// A CAN message with the standard ID `Id`, all of its `Signals` are published at once.
+/// @remarks
+/// Nothing is published for a frame whose signals all went into incomplete `StagingBlock`s.
+template<auto Id, typename... Signals> struct Message {
+    inline static constexpr uint16_t id = static_cast<uint16_t>(Id);
+    inline static constexpr size_t min_length = std::max({ size_t(0), Signals::min_length... });
+
+    template<typename State>
+    static DecodeResult decode(std::span<const uint8_t> data, DataCollectorTask& collector, State& state) {
+        if (data.size() < min_length)
+            return DecodeResult::Malformed;
+
+        const Detail::FrameWords words = Detail::load_frame(data);
+
+        // braced initializers are evaluated in order, the signals are staged in the order they are listed in
+        const std::array<bool, sizeof...(Signals)> pending { Signals::stage(words, state)... };
+        if (std::ranges::none_of(pending, std::identity {}))
+            return DecodeResult::Decoded;
+
+        collector.publish([&](DataCollectorTask::Writer& writer) {
+            size_t index = 0;
+            ((pending[index++] ? Signals::decode(words, writer, state) : void()), ...);
+        });
+
+        return DecodeResult::Decoded;
+    }
+};
+
+/// A set of `Message`s, each compiled into its own straight-line decoder.
+/// @remarks
+/// Messages with `StagedSignal`s need a decoder state, a `std::tuple` holding their blocks, that outlives the frames of a
+/// set. Each decoding context (i.e. a live bus, a replay) needs its own.
+template<typename... Messages> struct MessageTable {
+    inline static constexpr std::array<uint16_t, sizeof...(Messages)> ids { Messages::id... };
+
+    static_assert(
+      std::ranges::all_of(ids, [](uint16_t id) { return std::ranges::count(ids, id) == 1; }),
+      "message IDs must be unique"
+    );
+
+    template<typename State = std::tuple<>>
+    static DecodeResult
+    decode(uint16_t id, std::span<const uint8_t> data, DataCollectorTask& collector, State&& state = {}) {
+        DecodeResult result = DecodeResult::Unknown;
+
+        std::ignore = ((id == Messages::id ? (result = Messages::decode(data, collector, state), true) : false) || ...);
+
+        return result;
+    }
+};
+
+}
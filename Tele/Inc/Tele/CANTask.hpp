@@ -1,12 +1,24 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <functional>
+#include <numbers>
+#include <optional>
+#include <span>
+#include <tuple>
 
 #include <cmsis_os.h>
 #include <semphr.h>
 
+#include <Tele/CANCapture.hpp>
+#include <Tele/CANFilters.hpp>
+#include <Tele/CANSignals.hpp>
 #include <Tele/DataCollector.hpp>
 #include <Tele/LIS3DSH.hpp>
+#include <Tele/SPSCRing.hpp>
+#include <Tele/StaticPriorityQueue.hpp>
 #include <Tele/STUtilities.hpp>
 #include <Tele/StaticTask.hpp>
 
@@ -37,29 +49,319 @@ enum class CANIDs : uint16_t {
     Hydrogen = 0x91,
 };
 
+namespace Detail {
+
+/// The amount of battery cells in [first, first + max) that exist in this configuration.
+consteval uint8_t battery_cells_in(size_t first, size_t max) {
+    return static_cast<uint8_t>(first >= k_battery_cell_count ? 0 : std::min(max, k_battery_cell_count - first));
+}
+
+inline constexpr float k_wheel_circumference_mm = 288.f * 2 * std::numbers::pi_v<float>;
+
+/// mm/min to km/h
+inline constexpr float k_rpm_to_speed = k_wheel_circumference_mm * 60.f / (1000.f * 1000.f);
+
+/// The length of a standard data frame carrying `length` bytes on the wire, interframe space included.
+/// @remarks
+/// This is the worst case: 44 + 8n bits of frame, 3 of interframe space and a stuff bit for every 4 of the 34 + 8n
+/// stuffed ones. Bus load estimates made with it err on the high side.
+constexpr uint32_t can_frame_bits(uint32_t length) { return 47 + 8 * length + (34 + 8 * length - 1) / 4; }
+
+}
+
+/// The cell voltages of BMS1 through BMS4, published once a whole pack has been received.
+using BatteryVoltageBlock
+  = StagingBlock<Channels::can_battery_voltage, Channels::can_battery_voltage_generation, k_battery_cell_count>;
+
+/// The decoder state of `CANMessageTable`.
+using CANDecodeState = std::tuple<BatteryVoltageBlock>;
+
+/// Everything the telemetry decodes off of the bus, one `Signal` per line.
+// clang-format off
+using CANMessageTable = MessageTable<
+    Message<CANIDs::EngineRPMTemp,
+        Signal<Channels::engine_rpm, SignalLayout { .start_bit = 0, .length = 32, .encoding = SignalEncoding::Float }>,
+        Signal<Channels::engine_speed, SignalLayout { .start_bit = 0, .length = 32, .encoding = SignalEncoding::Float, .scale = Detail::k_rpm_to_speed }>,
+        Signal<Channels::engine_temperature, SignalLayout { .start_bit = 32, .length = 32, .encoding = SignalEncoding::Float }>>,
+
+    Message<CANIDs::BMS1,
+        StagedSignal<BatteryVoltageBlock, SignalLayout { .start_bit = 0, .length = 8, .count = Detail::battery_cells_in(0, 8), .element = 0 }.with_range(2.4f, 4.3f)>>,
+    Message<CANIDs::BMS2,
+        StagedSignal<BatteryVoltageBlock, SignalLayout { .start_bit = 0, .length = 8, .count = Detail::battery_cells_in(8, 8), .element = 8 }.with_range(2.4f, 4.3f)>>,
+    Message<CANIDs::BMS3,
+        StagedSignal<BatteryVoltageBlock, SignalLayout { .start_bit = 0, .length = 8, .count = Detail::battery_cells_in(16, 8), .element = 16 }.with_range(2.4f, 4.3f)>>,
+    Message<CANIDs::BMS4,
+        StagedSignal<BatteryVoltageBlock, SignalLayout { .start_bit = 0, .length = 8, .count = Detail::battery_cells_in(24, 3), .element = 24 }.with_range(2.4f, 4.3f)>,
+        Signal<Channels::can_battery_temp, SignalLayout { .start_bit = 24, .length = 8, .count = 5 }.with_range(0.f, 100.f)>>,
+
+    Message<CANIDs::BMS5,
+        Signal<Channels::can_spent_mah, SignalLayout { .start_bit = 7, .length = 16, .byte_order = std::endian::big }.with_range(0.f, 15000.f)>,
+        Signal<Channels::can_spent_mwh, SignalLayout { .start_bit = 23, .length = 16, .byte_order = std::endian::big }.with_range(0.f, 15000.f * 256)>,
+        Signal<Channels::can_current, SignalLayout { .start_bit = 39, .length = 16, .byte_order = std::endian::big }.with_range(-10.f, 50.f)>,
+        Signal<Channels::can_soc_percent, SignalLayout { .start_bit = 55, .length = 16, .byte_order = std::endian::big }.with_range(-5.f, 105.f)>>,
+
+    Message<CANIDs::Hydrogen,
+        Signal<Channels::can_hydro_ppm, SignalLayout { .start_bit = 0, .length = 8 }>,
+        Signal<Channels::can_hydro_temp, SignalLayout { .start_bit = 8, .length = 8 }>>>;
+// clang-format on
+
+/// The heartbeats of the nodes whose data `CANMessageTable` decodes.
+inline constexpr std::array<uint16_t, 5> k_can_heartbeat_ids {
+    static_cast<uint16_t>(CANIDs::VCSHeartbeat),       static_cast<uint16_t>(CANIDs::EngineHeartbeat),
+    static_cast<uint16_t>(CANIDs::BMSHeartbeat),       static_cast<uint16_t>(CANIDs::IsolationHeartbeat),
+    static_cast<uint16_t>(CANIDs::HydrogenHeartbeat),
+};
+
+/// Data frames go into FIFO0 and heartbeats into FIFO1, everything else is dropped by the hardware.
+inline constexpr auto k_can_filter_plan = plan_can_filters(CANMessageTable::ids, k_can_heartbeat_ids);
+
+static_assert(k_can_filter_plan.size <= 14, "CAN1 only has 14 filter banks");
+
+/// Every ID the filters let through, data frames first, in the order of the `can_id_frames_per_second` elements.
+inline constexpr auto k_can_rx_ids = [] {
+    std::array<uint16_t, CANMessageTable::ids.size() + k_can_heartbeat_ids.size()> ret {};
+    std::ranges::copy(k_can_heartbeat_ids, std::ranges::copy(CANMessageTable::ids, ret.begin()).out);
+    return ret;
+}();
+
+static_assert(k_can_rx_ids.size() == decltype(Channels::can_id_frames_per_second)::extent);
+
+/// The fault confinement state of the controller, as published through `can_error_state`.
+enum class CANErrorState : uint8_t {
+    Active,
+
+    /// TEC or REC reached 96
+    Warning,
+
+    /// TEC or REC went above 127, the node can't signal errors anymore
+    Passive,
+
+    /// TEC went above 255, the node is off the bus
+    BusOff,
+};
+
+struct CANFrame {
+    uint32_t id;
+    bool extended;
+    uint8_t fifo;
+    uint8_t length;
+    std::array<uint8_t, 8> data;
+};
+
+/// Handles a received frame the way `CANTask` does, replays go through here too. The filters route heartbeats into
+/// FIFO1, these are passed to `on_heartbeat(id)`. The other standard frames are decoded into `collector`.
+/// @return
+/// The result of the decode, `std::nullopt` for heartbeats and extended frames.
+template<typename OnHeartbeat>
+std::optional<DecodeResult> process_can_frame(
+  CANFrame const& frame,
+  DataCollectorTask& collector,
+  CANDecodeState& state,
+  OnHeartbeat&& on_heartbeat
+) {
+    if (frame.extended)
+        return std::nullopt;
+
+    if (frame.fifo == CAN_RX_FIFO1) {
+        std::invoke(on_heartbeat, static_cast<uint16_t>(frame.id));
+        return std::nullopt;
+    }
+
+    const std::span<const uint8_t> data(frame.data.data(), frame.length);
+    return CANMessageTable::decode(static_cast<uint16_t>(frame.id), data, collector, state);
+}
+
+/// Decodes the frames that the RX FIFO interrupts push into a ring into the data collector and feeds the TX mailboxes
+/// from a priority queue.
 struct CANTask : StaticTask<1024> {
+    /// enough for ~14 ms worth of back to back frames at 500 kbit/s
+    inline static constexpr size_t rx_ring_size = 64;
+
+    inline static constexpr size_t tx_queue_size = 16;
+
+    /// `CANIDs::TelemetryHeartbeat` is sent this often, carrying a rolling counter
+    inline static constexpr uint32_t heartbeat_period_ms = 100;
+
+    /// the `can_` statistics channels are published this often
+    inline static constexpr uint32_t statistics_period_ms = 1000;
+
+    struct RxStatistics {
+        uint32_t received;
+        uint32_t processed;
+
+        /// frames that didn't fit in the ring
+        uint32_t dropped;
+
+        /// times a hardware FIFO overflowed before the ISR could drain it
+        uint32_t fifo_overruns;
+
+        uint32_t ring_high_watermark;
+    };
+
+    struct TxStatistics {
+        uint32_t enqueued;
+        uint32_t sent;
+
+        /// frames that didn't fit in the queue
+        uint32_t dropped;
+
+        /// frames that found all three mailboxes busy and had to wait in the queue
+        uint32_t mailbox_stalls;
+
+        /// pending frames aborted to make room for an urgent one, they are queued again
+        uint32_t preemptions;
+
+        /// frames that lost arbitration, they are queued again as automatic retransmission is disabled
+        uint32_t arbitration_losses;
+
+        /// frames dropped after a transmission error
+        uint32_t errors;
+
+        uint32_t queue_high_watermark;
+
+        /// enqueue to successful transmission, in cycles
+        uint32_t mean_latency_cycles;
+        uint32_t max_latency_cycles;
+        uint32_t max_urgent_latency_cycles;
+
+        /// the length of the frames sent on the wire, see `Detail::can_frame_bits`
+        uint32_t bits;
+    };
+
     CANTask(DataCollectorTask& data_collector, CAN_HandleTypeDef& handle)
         : m_data_collector(data_collector)
         , m_handle(handle) { }
 
     virtual ~CANTask() = default;
 
+    /// Enables the RX FIFO and the error interrupts, call this after `create`.
+    /// @remarks
+    /// Throws if the RX interrupts of the two FIFOs don't have the same priority, see `isr_receive`.
+    void begin_rx();
+
+    /// Enables the TX mailbox interrupts, call this after `create`.
+    void begin_tx();
+
+    /// Queues a standard data frame, queued frames go into the mailboxes in ID order, like they would on the bus.
+    /// @param urgent
+    /// If all mailboxes are busy, the one holding the lowest priority frame that is not urgent itself is aborted. This
+    /// bounds the latency of urgent frames to about the length of the frame on the wire plus the higher priority ones.
+    /// @return
+    /// false if the queue was full
+    bool transmit(uint16_t id, std::span<const uint8_t> data, bool urgent = false);
+
+    bool send_engine_control(std::span<const uint8_t> data) {
+        return transmit(static_cast<uint16_t>(CANIDs::TelemetryEngineControl), data, true);
+    }
+
+    /// @param mailbox
+    /// The index of the mailbox, not the `CAN_TX_MAILBOX*` bit.
+    /// @param sent
+    /// false if the transmission was aborted.
+    /// @remarks
+    /// This function must be called from an ISR (i.e. `HAL_CAN_TxMailbox0CompleteCallback`).
+    void isr_tx_done(size_t mailbox, bool sent);
+
+    /// Drains the hardware FIFO `fifo` into the ring.
+    /// @remarks
+    /// This function must be called from an ISR (i.e. `HAL_CAN_RxFifo0MsgPendingCallback`).
+    void isr_rx_pending(uint32_t fifo);
+
+    /// @remarks
+    /// This function must be called from an ISR (i.e. `HAL_CAN_ErrorCallback`).
+    void isr_error(uint32_t error_code);
+
+    /// Pushes a frame into the ring, call `isr_notify` once done pushing.
+    /// @remarks
+    /// This function is not thread safe, there must be only one producer at a time. The RX interrupts of both FIFOs
+    /// call it and must not preempt each other.
+    /// @return
+    /// false if the frame was dropped
+    bool isr_receive(CANFrame const& frame);
+
+    void isr_notify();
+
+    /// @return
+    /// The `HAL_GetTick` of the last heartbeat received from `node`, `std::nullopt` if there has been none.
+    std::optional<uint32_t> last_heartbeat(CANIDs node) const {
+        const auto it = std::ranges::find(k_can_heartbeat_ids, static_cast<uint16_t>(node));
+        if (it == k_can_heartbeat_ids.end())
+            return std::nullopt;
+
+        const size_t index = std::distance(k_can_heartbeat_ids.begin(), it);
+        if (!m_heartbeat_seen[index].load(std::memory_order_relaxed))
+            return std::nullopt;
+
+        return m_heartbeat_ticks[index].load(std::memory_order_relaxed);
+    }
+
+    CANCapture& capture() { return m_capture; }
+
+    /// The bit rate the controller was configured with, 0 if it wasn't.
+    uint32_t bitrate() const;
+
+    static constexpr CANErrorState error_state_of(uint32_t esr) {
+        if ((esr & CAN_ESR_BOFF) != 0)
+            return CANErrorState::BusOff;
+
+        if ((esr & CAN_ESR_EPVF) != 0)
+            return CANErrorState::Passive;
+
+        if ((esr & CAN_ESR_EWGF) != 0)
+            return CANErrorState::Warning;
+
+        return CANErrorState::Active;
+    }
+
+    TxStatistics tx_statistics() const;
+
+    RxStatistics rx_statistics() const {
+        return {
+            .received = m_rx_received.load(std::memory_order_relaxed),
+            .processed = m_rx_processed.load(std::memory_order_relaxed),
+            .dropped = m_rx_dropped.load(std::memory_order_relaxed),
+            .fifo_overruns = m_rx_fifo_overruns.load(std::memory_order_relaxed),
+            .ring_high_watermark = m_rx_high_watermark.load(std::memory_order_relaxed),
+        };
+    }
+
 protected:
     [[noreturn]] void operator()() final override {
+        TickType_t next_heartbeat = xTaskGetTickCount();
+
         for (;;) {
-            for (uint32_t fill_level = HAL_CAN_GetRxFifoFillLevel(&m_handle, CAN_RX_FIFO0); fill_level != 0;
-                 fill_level--) {
+            const TickType_t now = xTaskGetTickCount();
+            if (static_cast<int32_t>(now - next_heartbeat) >= 0) {
+                if (is_started())
+                    send_heartbeat();
+
+                // keeps to the period instead of drifting by however late we woke up, a stall skips the beats it
+                // missed rather than sending them back to back
+                next_heartbeat += pdMS_TO_TICKS(heartbeat_period_ms);
+                if (static_cast<int32_t>(now - next_heartbeat) >= 0)
+                    next_heartbeat = now + pdMS_TO_TICKS(heartbeat_period_ms);
+            }
+
+            std::ignore = ulTaskNotifyTake(pdTRUE, next_heartbeat - now);
+
+            while (auto frame = m_rx_ring.pop()) {
                 // tick_leds();
 
-                CAN_RxHeaderTypeDef header;
-                std::array<uint8_t, 8> data { 0xFF, 0xFE, 0xFD, 0xFC, 0xFB, 0xFA, 0xF9, 0xF8 };
-                HAL_CAN_GetRxMessage(&m_handle, CAN_RX_FIFO0, &header, data.data());
+                const auto result = process_can_frame(*frame, m_data_collector, m_decode_state, [this](uint16_t id) {
+                    note_heartbeat(id);
+                });
 
-                if (header.IDE == CAN_ID_STD) {
-                    process_can_rx(header.StdId, std::span(data.data(), header.DLC));
+                switch (result.value_or(DecodeResult::Decoded)) {
+                case DecodeResult::Decoded: break;
+                case DecodeResult::Unknown: m_unknown_frames++; break;
+                case DecodeResult::Malformed: m_decode_failures++; break;
                 }
+
+                m_rx_processed.store(m_rx_processed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
             }
-            portYIELD();
+
+            if (is_started() && HAL_GetTick() - m_window_start >= statistics_period_ms)
+                roll_statistics();
         }
     }
 
@@ -67,13 +369,93 @@ private:
     DataCollectorTask& m_data_collector;
     CAN_HandleTypeDef& m_handle;
 
+    SPSCRing<CANFrame, rx_ring_size> m_rx_ring {};
+    CANCapture m_capture {};
+
+    // written by a single context each, hence the lack of RMW operations
+    std::atomic<uint32_t> m_rx_received { 0 };
+    std::atomic<uint32_t> m_rx_processed { 0 };
+    std::atomic<uint32_t> m_rx_dropped { 0 };
+    std::atomic<uint32_t> m_rx_fifo_overruns { 0 };
+    std::atomic<uint32_t> m_rx_high_watermark { 0 };
+    std::atomic<uint32_t> m_rx_bits { 0 };
+    std::array<std::atomic<uint32_t>, k_can_rx_ids.size()> m_rx_id_frames {};
+    std::atomic<uint32_t> m_bus_off_events { 0 };
+    std::atomic<uint32_t> m_error_passive_events { 0 };
+
+    struct TxEntry {
+        CANFrame frame;
+        uint32_t enqueued_at;
+        uint32_t sequence;
+        bool urgent;
+    };
+
+    /// lower priority means a higher ID, or a later enqueue among equal IDs
+    struct TxEntryOrder {
+        constexpr bool operator()(TxEntry const& lhs, TxEntry const& rhs) const {
+            if (lhs.frame.id != rhs.frame.id)
+                return lhs.frame.id > rhs.frame.id;
+
+            return static_cast<int32_t>(lhs.sequence - rhs.sequence) > 0;
+        }
+    };
+
+    // the TX state is shared with the TX ISRs and guarded by critical sections
+    StaticPriorityQueue<TxEntry, tx_queue_size, TxEntryOrder> m_tx_queue {};
+    std::array<std::optional<TxEntry>, 3> m_tx_mailboxes {};
+    uint32_t m_tx_sequence = 0;
+    TxStatistics m_tx_statistics {};
+    uint64_t m_tx_latency_sum = 0;
+
+    uint8_t m_heartbeat_counter = 0;
+
+    // the statistics window, only touched by the task
+    uint32_t m_window_start = 0;
+    uint32_t m_window_rx_frames = 0;
+    uint32_t m_window_rx_bits = 0;
+    std::array<uint32_t, k_can_rx_ids.size()> m_window_id_frames {};
+    uint32_t m_window_tx_sent = 0;
+    uint32_t m_window_tx_bits = 0;
+    uint32_t m_decode_failures = 0;
+    uint32_t m_unknown_frames = 0;
+
+    CANDecodeState m_decode_state {};
+
+    std::array<std::atomic<uint32_t>, k_can_heartbeat_ids.size()> m_heartbeat_ticks {};
+    std::array<std::atomic_bool, k_can_heartbeat_ids.size()> m_heartbeat_seen {};
+
     // mutable std::atomic_bool m_spinlock { false };
     // mutable Spinlock m_spinlock {};
 
-    float m_engine_rpm;
-    float m_engine_temperature;
+    /// Whether the controller was started, the registers and the timing configuration are meaningless before that.
+    bool is_started() const { return m_handle.State == HAL_CAN_STATE_LISTENING; }
+
+    void send_heartbeat() {
+        const std::array<uint8_t, 1> payload { m_heartbeat_counter++ };
+        std::ignore = transmit(static_cast<uint16_t>(CANIDs::TelemetryHeartbeat), payload);
+    }
+
+    /// Moves queued frames into the free mailboxes, call with the TX state locked.
+    void fill_mailboxes();
+
+    /// Queues a frame that left its mailbox without being sent, call with the TX state locked.
+    void requeue(TxEntry const& entry);
+
+    /// Counts a frame that came off the bus, whether or not it fits in the ring.
+    void isr_count_frame(CANFrame const& frame);
 
-    void process_can_rx(uint16_t id, std::span<uint8_t> data);
+    /// Turns the counters of the window that just ended into rates and publishes them along with the error counters.
+    void roll_statistics();
+
+    void note_heartbeat(uint16_t id) {
+        const auto it = std::ranges::find(k_can_heartbeat_ids, id);
+        if (it == k_can_heartbeat_ids.end())
+            return;
+
+        const size_t index = std::distance(k_can_heartbeat_ids.begin(), it);
+        m_heartbeat_ticks[index].store(HAL_GetTick(), std::memory_order_relaxed);
+        m_heartbeat_seen[index].store(true, std::memory_order_relaxed);
+    }
 };
 
 }
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <type_traits>
+
+#include <Tele/Channels.hpp>
+#include <Tele/DataCollector.hpp>
+#include <Tele/MemberOrder.hpp>
+
+namespace Tele {
+
+namespace Detail {
+
+template<auto Member, auto const& BoundChannel> struct ChannelBinding {
+    inline static constexpr auto member = Member;
+    using channel_type = std::remove_cvref_t<decltype(BoundChannel)>;
+
+    static constexpr bool computed = requires() { BoundChannel.compute; };
+
+    /// @return
+    /// Whether the channel was fresh, the field is not touched otherwise.
+    template<typename Struct> static bool fill(Struct& out, DataCollectorTask::Reader const& reader) {
+        if (!reader.is_fresh(BoundChannel))
+            return false;
+
+        auto& field = out.*Member;
+
+        if constexpr (std::is_array_v<std::remove_cvref_t<decltype(field)>>) {
+            using value_type = typename channel_type::value_type;
+            reader.get_array<value_type, channel_type::extent>(BoundChannel, field);
+        } else {
+            field = reader.get(BoundChannel);
+        }
+
+        return true;
+    }
+};
+
+}
+
+/// Describes which channel each field of a struct is filled from, see `DataCollectorTask::snapshot`.\n
+/// Declare one through an ADL function next to the struct's introspector:
+/// @code
+/// inline constexpr auto _tele_adl_channel_binder(FullPacket&&) {
+///     return Tele::ChannelBinder<FullPacket> {} //
+///       .bind<&FullPacket::rpm, Tele::Channels::engine_rpm>();
+/// }
+/// @endcode
+/// @remarks
+/// Fields are bound in the order they are declared in, which is also the order of the bits of the stale masks.
+template<typename Struct, typename... Bindings> struct ChannelBinder {
+    static_assert(sizeof...(Bindings) <= 32, "stale binding masks are 32 bits wide");
+
+    /// A mask of the bindings to stored channels, bit `i` being the `i`th binding.
+    static constexpr uint32_t stored_mask() {
+        return []<size_t... Is>(std::index_sequence<Is...>) {
+            return ((Bindings::computed ? 0u : (1u << Is)) | ... | 0u);
+        }(std::index_sequence_for<Bindings...> {});
+    }
+
+    template<auto Member, auto const& BoundChannel> constexpr auto bind() const {
+        static_assert(
+          in_declaration_order<Struct, Bindings::member..., Member>(), "bind fields in the order they are declared in"
+        );
+
+        return ChannelBinder<Struct, Bindings..., Detail::ChannelBinding<Member, BoundChannel>> {};
+    }
+
+    /// Fills the stored channels, the caller must make sure that `reader` is consistent.
+    /// @return
+    /// A mask of the bindings that were stale.
+    uint32_t fill_stored(Struct& out, DataCollectorTask::Reader const& reader) const {
+        return [&]<size_t... Is>(std::index_sequence<Is...>) {
+            return ((fill_if<Bindings, false>(out, reader) ? 0u : (1u << Is)) | ... | 0u);
+        }(std::index_sequence_for<Bindings...> {});
+    }
+
+    /// Fills the computed channels, these are not part of any snapshot and should be filled outside of `read`.
+    void fill_computed(Struct& out, DataCollectorTask::Reader const& reader) const {
+        (static_cast<void>(fill_if<Bindings, true>(out, reader)), ...);
+    }
+
+private:
+    template<typename Binding, bool Computed>
+    static bool fill_if(Struct& out, DataCollectorTask::Reader const& reader) {
+        if constexpr (Binding::computed == Computed)
+            return Binding::fill(out, reader);
+        else
+            return true;
+    }
+};
+
+template<typename T> uint32_t DataCollectorTask::snapshot(T& out) const {
+    constexpr auto binder = _tele_adl_channel_binder(T {});
+
+    const uint32_t stale = read([&](Reader const& reader) { return binder.fill_stored(out, reader); });
+    binder.fill_computed(out, Reader { *this });
+
+    return stale;
+}
+
+}
@@ -0,0 +1,361 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include <FreeRTOS.h>
+#include <main.h>
+#include <secrets.hpp>
+
+namespace Tele {
+
+#if RACE_MODE == RACE_MODE_ELECTRO
+inline constexpr size_t k_battery_cell_count = 27;
+#elif RACE_MODE == RACE_MODE_HYDRO
+inline constexpr size_t k_battery_cell_count = 20;
+#endif
+
+/// The list of every value the data collector knows about.\n
+/// FACTORY(name, type, extent, history, ttl) where:\n
+/// type is one of float, uint32_t or int32_t,\n
+/// history is the amount of (timestamp, value) samples kept for the channel, a power of two or 0, only scalar channels
+/// can have a history,\n
+/// ttl is the amount of milliseconds after a write that the channel is considered fresh for, 0 if it never goes stale.
+// clang-format off
+#define TELE_CHANNEL_LIST(FACTORY)                                \
+    FACTORY(engine_rpm, float, 1, 0, 1000)                        \
+    FACTORY(engine_speed, float, 1, 64, 1000)                     \
+    FACTORY(engine_temperature, float, 1, 0, 1000)                \
+    FACTORY(can_battery_voltage, float, 27, 0, 3000)              \
+    FACTORY(can_battery_voltage_generation, uint32_t, 1, 0, 3000) \
+    FACTORY(can_battery_temp, float, 5, 0, 3000)                  \
+    FACTORY(can_spent_mah, float, 1, 0, 3000)                     \
+    FACTORY(can_spent_mwh, float, 1, 0, 3000)                     \
+    FACTORY(can_current, float, 1, 64, 3000)                      \
+    FACTORY(can_soc_percent, float, 1, 16, 3000)                  \
+    FACTORY(can_hydro_ppm, float, 1, 16, 3000)                    \
+    FACTORY(can_hydro_temp, float, 1, 0, 3000)                    \
+    FACTORY(gps_latitude, float, 1, 0, 5000)                      \
+    FACTORY(gps_longitude, float, 1, 0, 5000)                     \
+    /* derived, see TELE_AGGREGATE_LIST */                        \
+    FACTORY(can_battery_voltage_sum, float, 1, 0, 3000)           \
+    FACTORY(can_battery_voltage_min, float, 1, 0, 3000)           \
+    FACTORY(can_battery_voltage_max, float, 1, 0, 3000)           \
+    FACTORY(can_battery_voltage_avg, float, 1, 0, 3000)           \
+    FACTORY(can_battery_voltage_argmin, uint32_t, 1, 0, 3000)     \
+    FACTORY(can_battery_voltage_argmax, uint32_t, 1, 0, 3000)     \
+    FACTORY(can_battery_temp_sum, float, 1, 0, 3000)              \
+    FACTORY(can_battery_temp_min, float, 1, 0, 3000)              \
+    FACTORY(can_battery_temp_max, float, 1, 0, 3000)              \
+    FACTORY(can_battery_temp_avg, float, 1, 0, 3000)              \
+    FACTORY(can_battery_temp_argmin, uint32_t, 1, 0, 3000)        \
+    FACTORY(can_battery_temp_argmax, uint32_t, 1, 0, 3000)        \
+    /* data collector statistics, see DataCollectorTask */        \
+    FACTORY(collector_writes_per_second, uint32_t, 1, 0, 3000)    \
+    FACTORY(collector_reads_per_second, uint32_t, 1, 0, 3000)     \
+    FACTORY(collector_read_retries, uint32_t, 1, 0, 3000)         \
+    FACTORY(collector_read_wait_cycles, uint32_t, 1, 0, 3000)     \
+    FACTORY(collector_max_hold_cycles, uint32_t, 1, 0, 3000)      \
+    /* CAN bus statistics, see CANTask */                         \
+    FACTORY(can_rx_frames_per_second, uint32_t, 1, 0, 3000)       \
+    FACTORY(can_tx_frames_per_second, uint32_t, 1, 0, 3000)       \
+    FACTORY(can_id_frames_per_second, uint32_t, 12, 0, 3000)      \
+    FACTORY(can_bus_load_percent, float, 1, 16, 3000)             \
+    FACTORY(can_tec, uint32_t, 1, 0, 3000)                        \
+    FACTORY(can_rec, uint32_t, 1, 0, 3000)                        \
+    FACTORY(can_error_state, uint32_t, 1, 0, 3000)                \
+    FACTORY(can_bus_off_count, uint32_t, 1, 0, 3000)              \
+    FACTORY(can_error_passive_count, uint32_t, 1, 0, 3000)        \
+    FACTORY(can_fifo_overruns, uint32_t, 1, 0, 3000)              \
+    FACTORY(can_rx_dropped, uint32_t, 1, 0, 3000)                 \
+    FACTORY(can_tx_dropped, uint32_t, 1, 0, 3000)                 \
+    FACTORY(can_decode_failures, uint32_t, 1, 0, 3000)            \
+    FACTORY(can_unknown_frames, uint32_t, 1, 0, 3000)             \
+    FACTORY(can_staging_discards, uint32_t, 1, 0, 3000)
+// clang-format on
+
+enum class ChannelType : uint8_t {
+    Float,
+    Unsigned,
+    Signed,
+};
+
+template<typename T> inline constexpr bool is_channel_type_v = false;
+template<> inline constexpr bool is_channel_type_v<float> = true;
+template<> inline constexpr bool is_channel_type_v<uint32_t> = true;
+template<> inline constexpr bool is_channel_type_v<int32_t> = true;
+
+template<typename T>
+    requires is_channel_type_v<T>
+inline constexpr ChannelType channel_type_of = std::is_floating_point_v<T> ? ChannelType::Float
+                                             : std::is_signed_v<T>         ? ChannelType::Signed
+                                                                           : ChannelType::Unsigned;
+
+struct ChannelDescriptor {
+    std::string_view name;
+    ChannelType type;
+    uint16_t extent;
+
+    uint16_t history;
+    uint16_t ttl_ms;
+
+    /// index of the first slot of this channel in the value store
+    uint16_t offset = 0;
+
+    /// index of the first sample of this channel in the history store
+    uint16_t history_offset = 0;
+};
+
+/// A typed handle to a stored channel. Every handle is a compile time constant, see `Tele::Channels`.
+template<typename T, size_t Extent = 1>
+    requires is_channel_type_v<T>
+struct Channel {
+    using value_type = T;
+    static constexpr size_t extent = Extent;
+
+    uint16_t id;
+    uint16_t offset;
+
+    uint16_t history_offset;
+    uint16_t history_capacity;
+};
+
+/// A channel that is not stored but computed on every read (heap statistics etc.)
+template<typename T> struct ComputedChannel {
+    using value_type = T;
+
+    std::string_view name;
+    T (*compute)();
+};
+
+namespace Detail {
+
+enum class ChannelIndex : uint16_t {
+#pragma push_macro("FACTORY")
+#define FACTORY(_name, _type, _extent, _history, _ttl) _name,
+    TELE_CHANNEL_LIST(FACTORY)
+#undef FACTORY
+#pragma pop_macro("FACTORY")
+};
+
+inline constexpr auto k_channel_table_unlaid = std::to_array<ChannelDescriptor>({
+#pragma push_macro("FACTORY")
+#define FACTORY(_name, _type, _extent, _history, _ttl) { #_name, channel_type_of<_type>, _extent, _history, _ttl },
+  TELE_CHANNEL_LIST(FACTORY)
+#undef FACTORY
+#pragma pop_macro("FACTORY")
+});
+
+template<size_t N> constexpr std::array<ChannelDescriptor, N> lay_out_channels(std::array<ChannelDescriptor, N> table) {
+    uint16_t offset = 0;
+    uint16_t history_offset = 0;
+    for (auto& descriptor : table) {
+        descriptor.offset = offset;
+        offset += descriptor.extent;
+
+        descriptor.history_offset = history_offset;
+        history_offset += descriptor.history;
+    }
+
+    return table;
+}
+
+}
+
+inline constexpr auto k_channel_table = Detail::lay_out_channels(Detail::k_channel_table_unlaid);
+inline constexpr size_t k_channel_count = k_channel_table.size();
+inline constexpr size_t k_channel_slots = k_channel_table.back().offset + k_channel_table.back().extent;
+inline constexpr size_t k_history_slots = k_channel_table.back().history_offset + k_channel_table.back().history;
+
+static_assert(
+  std::ranges::none_of(
+    k_channel_table,
+    [](ChannelDescriptor const& descriptor) { return descriptor.extent != 1 && descriptor.history != 0; }
+  ),
+  "only scalar channels can have a history"
+);
+
+// the history heads run past the capacity and wrap at 2^32, which only a power of two divides
+static_assert(
+  std::ranges::all_of(
+    k_channel_table,
+    [](ChannelDescriptor const& descriptor) {
+        return descriptor.history == 0 || std::has_single_bit(descriptor.history);
+    }
+  ),
+  "channel histories must be a power of two long"
+);
+
+inline constexpr size_t k_channel_set_words = (k_channel_count + 31) / 32;
+
+/// A set of stored channels, one bit per channel.
+struct ChannelSet {
+    constexpr ChannelSet() = default;
+
+    template<typename... Handles>
+        requires(sizeof...(Handles) != 0)
+    constexpr ChannelSet(Handles const&... channels) {
+        (add(channels.id), ...);
+    }
+
+    static constexpr ChannelSet all() {
+        ChannelSet ret {};
+        for (uint16_t i = 0; i < k_channel_count; i++)
+            ret.add(i);
+
+        return ret;
+    }
+
+    constexpr void add(uint16_t id) { words[id / 32] |= 1u << (id % 32); }
+
+    constexpr bool contains(uint16_t id) const { return (words[id / 32] & (1u << (id % 32))) != 0; }
+
+    template<typename T, size_t Extent> constexpr bool contains(Channel<T, Extent> channel) const {
+        return contains(channel.id);
+    }
+
+    constexpr bool empty() const {
+        return std::ranges::all_of(words, [](uint32_t word) { return word == 0; });
+    }
+
+    constexpr ChannelSet operator&(ChannelSet const& other) const {
+        ChannelSet ret {};
+        for (size_t i = 0; i < k_channel_set_words; i++)
+            ret.words[i] = words[i] & other.words[i];
+
+        return ret;
+    }
+
+    constexpr ChannelSet operator|(ChannelSet const& other) const {
+        ChannelSet ret {};
+        for (size_t i = 0; i < k_channel_set_words; i++)
+            ret.words[i] = words[i] | other.words[i];
+
+        return ret;
+    }
+
+    std::array<uint32_t, k_channel_set_words> words {};
+};
+
+namespace Channels {
+
+#pragma push_macro("FACTORY")
+#define FACTORY(_name, _type, _extent, _history, _ttl)                                                            \
+    inline constexpr Channel<_type, _extent> _name {                                                              \
+        static_cast<uint16_t>(Detail::ChannelIndex::_name),                                                       \
+        k_channel_table[static_cast<uint16_t>(Detail::ChannelIndex::_name)].offset,                               \
+        k_channel_table[static_cast<uint16_t>(Detail::ChannelIndex::_name)].history_offset,                       \
+        _history,                                                                                                 \
+    };
+TELE_CHANNEL_LIST(FACTORY)
+#undef FACTORY
+#pragma pop_macro("FACTORY")
+
+inline constexpr ComputedChannel<uint32_t> hal_lf_ticks { "hal_lf_ticks", [] { return HAL_GetTick(); } };
+
+inline constexpr ComputedChannel<uint32_t> rtos_heap_free {
+    "rtos_heap_free",
+    [] {
+        HeapStats_t heap_stats;
+        vPortGetHeapStats(&heap_stats);
+        return static_cast<uint32_t>(heap_stats.xAvailableHeapSpaceInBytes);
+    },
+};
+
+inline constexpr ComputedChannel<uint32_t> rtos_heap_allocations {
+    "rtos_heap_allocations",
+    [] {
+        HeapStats_t heap_stats;
+        vPortGetHeapStats(&heap_stats);
+        return static_cast<uint32_t>(heap_stats.xNumberOfSuccessfulAllocations);
+    },
+};
+
+inline constexpr ComputedChannel<uint32_t> rtos_heap_deallocations {
+    "rtos_heap_deallocations",
+    [] {
+        HeapStats_t heap_stats;
+        vPortGetHeapStats(&heap_stats);
+        return static_cast<uint32_t>(heap_stats.xNumberOfSuccessfulFrees);
+    },
+};
+
+}
+
+/// The array channels whose first `count` elements are summarised into the `_sum`, `_min`, `_max`, `_avg`, `_argmin`
+/// and `_argmax` channels on every write.\n
+/// FACTORY(source, count), the derived channels must be in `TELE_CHANNEL_LIST` too.
+// clang-format off
+#define TELE_AGGREGATE_LIST(FACTORY)                     \
+    FACTORY(can_battery_voltage, k_battery_cell_count)   \
+    FACTORY(can_battery_temp, 5)
+// clang-format on
+
+struct AggregateDescriptor {
+    uint16_t source;
+    uint16_t count;
+
+    Channel<float> sum;
+    Channel<float> min;
+    Channel<float> max;
+    Channel<float> avg;
+    Channel<uint32_t> argmin;
+    Channel<uint32_t> argmax;
+};
+
+namespace Detail {
+
+template<size_t Extent>
+    requires(Extent > 1)
+constexpr AggregateDescriptor make_aggregate(
+  Channel<float, Extent> source,
+  size_t count,
+  Channel<float> sum,
+  Channel<float> min,
+  Channel<float> max,
+  Channel<float> avg,
+  Channel<uint32_t> argmin,
+  Channel<uint32_t> argmax
+) {
+    return {
+        .source = source.id,
+        .count = static_cast<uint16_t>(std::min(count, Extent)),
+        .sum = sum,
+        .min = min,
+        .max = max,
+        .avg = avg,
+        .argmin = argmin,
+        .argmax = argmax,
+    };
+}
+
+}
+
+inline constexpr auto k_aggregate_table = std::to_array<AggregateDescriptor>({
+#pragma push_macro("FACTORY")
+#define FACTORY(_source, _count)                                                                                  \
+    Detail::make_aggregate(                                                                                       \
+      Channels::_source, _count, Channels::_source##_sum, Channels::_source##_min, Channels::_source##_max,       \
+      Channels::_source##_avg, Channels::_source##_argmin, Channels::_source##_argmax                             \
+    ),
+  TELE_AGGREGATE_LIST(FACTORY)
+#undef FACTORY
+#pragma pop_macro("FACTORY")
+});
+
+/// @remarks
+/// This is a linear search, meant for the shell and such. Use the handles in `Tele::Channels` everywhere else.
+constexpr std::optional<uint16_t> find_channel(std::string_view name) {
+    for (uint16_t i = 0; i < k_channel_count; i++) {
+        if (k_channel_table[i].name == name)
+            return i;
+    }
+
+    return std::nullopt;
+}
+
+}
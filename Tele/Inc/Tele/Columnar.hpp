@@ -0,0 +1,500 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include <tl/expected.hpp>
+
+#include <Tele/Binary.hpp>
+#include <Tele/Sparse.hpp>
+
+namespace Tele {
+
+/// The most rows a columnar block can hold.
+inline constexpr size_t k_columnar_max_rows = 64;
+
+/// Writes bits most significant first, padding the last byte with zeroes on `flush`.
+template<typename Stream> struct BitWriter {
+    constexpr BitWriter(Stream& stream)
+        : m_stream(stream) { }
+
+    /// @param count
+    /// At most 64, the low `count` bits of `value` are written.
+    constexpr void write_bits(uint64_t value, size_t count) {
+        while (count != 0) {
+            const size_t amount = std::min<size_t>(count, 8 - m_used);
+            const uint8_t bits = static_cast<uint8_t>((value >> (count - amount)) & ((1u << amount) - 1));
+
+            m_byte |= static_cast<uint8_t>(bits << (8 - m_used - amount));
+            m_used += amount;
+            count -= amount;
+
+            if (m_used == 8)
+                flush();
+        }
+    }
+
+    constexpr void flush() {
+        if (m_used == 0)
+            return;
+
+        m_stream << static_cast<char>(m_byte);
+        m_byte = 0;
+        m_used = 0;
+    }
+
+private:
+    Stream& m_stream;
+
+    uint8_t m_byte = 0;
+    size_t m_used = 0;
+};
+
+/// Reads what `BitWriter` writes.
+/// @remarks
+/// Reading past the end yields zeroes and sets `overrun`, check it once done instead of after every read.
+struct BitReader {
+    constexpr BitReader(std::span<const uint8_t> data)
+        : m_data(data) { }
+
+    constexpr uint64_t read_bits(size_t count) {
+        uint64_t ret = 0;
+
+        while (count != 0) {
+            if (m_byte_index >= m_data.size()) {
+                m_overrun = true;
+                return 0;
+            }
+
+            const size_t amount = std::min<size_t>(count, 8 - m_used);
+            const uint8_t byte = m_data[m_byte_index];
+
+            ret = (ret << amount) | ((byte >> (8 - m_used - amount)) & ((1u << amount) - 1));
+            m_used += amount;
+            count -= amount;
+
+            if (m_used == 8) {
+                m_used = 0;
+                m_byte_index++;
+            }
+        }
+
+        return ret;
+    }
+
+    constexpr bool read_bit() { return read_bits(1) != 0; }
+
+    constexpr bool overrun() const { return m_overrun; }
+
+    /// The bytes after the last one that was read from, even partially.
+    constexpr std::span<const uint8_t> remaining() const {
+        return m_data.subspan(std::min(m_data.size(), m_byte_index + (m_used != 0 ? 1 : 0)));
+    }
+
+private:
+    std::span<const uint8_t> m_data;
+
+    size_t m_byte_index = 0;
+    size_t m_used = 0;
+    bool m_overrun = false;
+};
+
+namespace Detail {
+
+template<typename T> struct ColumnInteger {
+    using type = T;
+};
+
+template<typename T>
+    requires std::is_enum_v<T>
+struct ColumnInteger<T> {
+    using type = std::underlying_type_t<T>;
+};
+
+template<typename T> using BinaryReprOf = std::remove_cvref_t<decltype(_tele_adl_binary_repr(std::declval<T&>()))>;
+
+template<typename T> struct ArrayElement {
+    using type = std::remove_extent_t<T>;
+};
+
+template<typename T, size_t N> struct ArrayElement<std::array<T, N>> {
+    using type = T;
+};
+
+template<typename T> struct IsSparse : std::false_type { };
+template<typename T> struct IsSparse<Sparse<T>> : std::true_type { };
+
+template<typename T> inline constexpr size_t array_extent = std::extent_v<T>;
+template<typename T, size_t N> inline constexpr size_t array_extent<std::array<T, N>> = N;
+
+}
+
+/// Writes a batch of rows column by column, every field and every array element being a column of its own.
+/// @remarks
+/// Columns go through the `BinarySchema`s of the rows, their encodings are ignored:
+/// <br/>
+/// Floats are XOR coded against the previous row like in Facebook's Gorilla: a 0 bit for a repeat, otherwise the XOR
+/// with its leading and trailing zeroes cut. `10` reuses the previous cut, `11` is followed by 5 bits of leading zeroes
+/// and 5 bits of the length minus one.
+/// <br/>
+/// Integers, enums and wrappers like `Fixed` are delta-of-delta coded: the first row at its full width, then the zigzag
+/// encoded change in the delta as `0`, `10` + 7 bits, `110` + 9 bits, `1110` + 12 bits or `1111` + 36 bits.
+/// <br/>
+/// Variants are a column of indices, followed by the columns of every alternative over the rows holding it. `Sparse`s
+/// are likewise a column of field bitmaps followed by the columns of every field over the rows it is present in.
+template<typename Stream> struct ColumnarWriter {
+    constexpr ColumnarWriter(Stream& stream)
+        : m_stream(stream)
+        , m_bits(stream) { }
+
+    /// Writes the row count as a varint and then the columns, padded to a whole byte.
+    /// @throws std::length_error
+    /// If there are more than `k_columnar_max_rows` rows.
+    template<typename T> constexpr void write(std::span<const T> rows) {
+        if (rows.size() > k_columnar_max_rows)
+            throw std::length_error("too many rows for a columnar block");
+
+        BinaryWriter { m_stream }.write_varint(rows.size());
+
+        if (!rows.empty())
+            write_columns<T>(rows.size(), [rows](size_t i) -> T const& { return rows[i]; });
+
+        m_bits.flush();
+    }
+
+private:
+    Stream& m_stream;
+    BitWriter<Stream> m_bits;
+
+    template<typename T, typename Get> constexpr void write_columns(size_t count, Get const& get) {
+        if constexpr (std::is_same_v<T, float>) {
+            write_float_column(count, get);
+        } else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+            write_integer_column<T>(count, get);
+        } else if constexpr (std::is_array_v<T> || Detail::IsStdArray<T>::value) {
+            using Element = typename Detail::ArrayElement<T>::type;
+
+            for (size_t j = 0; j < Detail::array_extent<T>; j++)
+                write_columns<Element>(count, [&get, j](size_t i) -> Element const& { return get(i)[j]; });
+        } else if constexpr (Detail::IsVariant<T>::value) {
+            write_columns<uint32_t>(count, [&get](size_t i) { return static_cast<uint32_t>(get(i).index()); });
+
+            [&]<size_t... Is>(std::index_sequence<Is...>) {
+                (write_alternative<T, Is>(count, get), ...);
+            }(std::make_index_sequence<std::variant_size_v<T>> {});
+        } else if constexpr (Detail::IsSparse<T>::value) {
+            write_columns<uint32_t>(count, [&get](size_t i) { return get(i).present; });
+            size_t index = 0;
+
+            BinarySchemaOf<typename T::value_type>::for_each_field([&]<typename Field>(Field) {
+                using Member = std::remove_cvref_t<decltype(std::declval<T const&>().values.*Field::member)>;
+                const size_t bit = index++;
+
+                std::array<uint8_t, k_columnar_max_rows> rows;
+                size_t holding = 0;
+
+                for (size_t i = 0; i < count; i++) {
+                    if ((get(i).present >> bit) & 1)
+                        rows[holding++] = static_cast<uint8_t>(i);
+                }
+
+                if (holding != 0) {
+                    write_columns<Member>(holding, [&get, &rows](size_t j) -> Member const& {
+                        return get(rows[j]).values.*Field::member;
+                    });
+                }
+            });
+        } else if constexpr (BinaryRepresented<T>) {
+            using Repr = Detail::BinaryReprOf<T>;
+            write_columns<Repr>(count, [&get](size_t i) -> Repr const& { return _tele_adl_binary_repr(get(i)); });
+        } else if constexpr (BinarySchematized<T>) {
+            decltype(_tele_adl_binary_schema(T {}))::for_each_field([this, count, &get]<typename Field>(Field) {
+                using Member = std::remove_cvref_t<decltype(std::declval<T const&>().*Field::member)>;
+                write_columns<Member>(count, [&get](size_t i) -> Member const& { return get(i).*Field::member; });
+            });
+        } else {
+            static_assert(!std::is_same_v<T, T>, "the type has no columnar representation");
+        }
+    }
+
+    template<typename Variant, size_t I, typename Get> constexpr void write_alternative(size_t count, Get const& get) {
+        using Alternative = std::variant_alternative_t<I, Variant>;
+
+        std::array<uint8_t, k_columnar_max_rows> rows;
+        size_t holding = 0;
+
+        for (size_t i = 0; i < count; i++) {
+            if (get(i).index() == I)
+                rows[holding++] = static_cast<uint8_t>(i);
+        }
+
+        if (holding == 0)
+            return;
+
+        write_columns<Alternative>(holding, [&get, &rows](size_t j) -> Alternative const& {
+            return std::get<I>(get(rows[j]));
+        });
+    }
+
+    template<typename Get> constexpr void write_float_column(size_t count, Get const& get) {
+        uint32_t previous = std::bit_cast<uint32_t>(static_cast<float>(get(0)));
+        m_bits.write_bits(previous, 32);
+
+        size_t window_leading = 0;
+        size_t window_trailing = 0;
+        bool have_window = false;
+
+        for (size_t i = 1; i < count; i++) {
+            const uint32_t current = std::bit_cast<uint32_t>(static_cast<float>(get(i)));
+            const uint32_t xored = current ^ previous;
+            previous = current;
+
+            if (xored == 0) {
+                m_bits.write_bits(0, 1);
+                continue;
+            }
+
+            const size_t leading = std::countl_zero(xored);
+            const size_t trailing = std::countr_zero(xored);
+
+            if (have_window && leading >= window_leading && trailing >= window_trailing) {
+                m_bits.write_bits(0b10, 2);
+                m_bits.write_bits(xored >> window_trailing, 32 - window_leading - window_trailing);
+                continue;
+            }
+
+            const size_t length = 32 - leading - trailing;
+
+            m_bits.write_bits(0b11, 2);
+            m_bits.write_bits(leading, 5);
+            m_bits.write_bits(length - 1, 5);
+            m_bits.write_bits(xored >> trailing, length);
+
+            window_leading = leading;
+            window_trailing = trailing;
+            have_window = true;
+        }
+    }
+
+    template<typename T, typename Get> constexpr void write_integer_column(size_t count, Get const& get) {
+        using Integer = typename Detail::ColumnInteger<T>::type;
+        static_assert(sizeof(Integer) <= 4, "deltas of wider integers don't fit the buckets");
+
+        auto value_at = [&get](size_t i) { return static_cast<int64_t>(static_cast<Integer>(get(i))); };
+
+        int64_t previous = value_at(0);
+        int64_t previous_delta = 0;
+
+        m_bits.write_bits(static_cast<uint64_t>(previous), sizeof(Integer) * 8);
+
+        for (size_t i = 1; i < count; i++) {
+            const int64_t current = value_at(i);
+            const int64_t delta = current - previous;
+            const uint64_t encoded = Detail::zigzag_encode(delta - previous_delta);
+
+            previous = current;
+            previous_delta = delta;
+
+            if (encoded == 0) {
+                m_bits.write_bits(0, 1);
+            } else if (encoded < (1u << 7)) {
+                m_bits.write_bits(0b10, 2);
+                m_bits.write_bits(encoded, 7);
+            } else if (encoded < (1u << 9)) {
+                m_bits.write_bits(0b110, 3);
+                m_bits.write_bits(encoded, 9);
+            } else if (encoded < (1u << 12)) {
+                m_bits.write_bits(0b1110, 4);
+                m_bits.write_bits(encoded, 12);
+            } else {
+                m_bits.write_bits(0b1111, 4);
+                m_bits.write_bits(encoded, 36);
+            }
+        }
+    }
+};
+
+/// Reads what `ColumnarWriter` writes.
+struct ColumnarReader {
+    constexpr ColumnarReader(std::span<const uint8_t> data)
+        : m_data(data)
+        , m_bits(data) { }
+
+    /// The bytes after the block that was read.
+    constexpr std::span<const uint8_t> remaining() const { return m_bits.remaining(); }
+
+    /// @return
+    /// The amount of rows read into the start of `out`.
+    template<typename T> constexpr tl::expected<size_t, std::string_view> read(std::span<T> out) {
+        BinaryReader header { m_data };
+
+        auto count = header.read_varint();
+        if (!count)
+            return tl::unexpected { count.error() };
+
+        if (*count > out.size() || *count > k_columnar_max_rows)
+            return tl::unexpected { "too many rows" };
+
+        m_bits = BitReader { header.remaining() };
+
+        if (*count != 0)
+            read_columns<T>(*count, [out](size_t i) -> T& { return out[i]; });
+
+        if (m_bits.overrun())
+            return tl::unexpected { "truncated input" };
+
+        if (m_bad_variant)
+            return tl::unexpected { "bad variant index" };
+
+        return *count;
+    }
+
+private:
+    std::span<const uint8_t> m_data;
+    BitReader m_bits;
+    bool m_bad_variant = false;
+
+    template<typename T, typename At> constexpr void read_columns(size_t count, At const& at) {
+        if constexpr (std::is_same_v<T, float>) {
+            read_float_column(count, at);
+        } else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+            read_integer_column<T>(count, at);
+        } else if constexpr (std::is_array_v<T> || Detail::IsStdArray<T>::value) {
+            using Element = typename Detail::ArrayElement<T>::type;
+
+            for (size_t j = 0; j < Detail::array_extent<T>; j++)
+                read_columns<Element>(count, [&at, j](size_t i) -> Element& { return at(i)[j]; });
+        } else if constexpr (Detail::IsVariant<T>::value) {
+            std::array<uint32_t, k_columnar_max_rows> indices;
+            read_columns<uint32_t>(count, [&indices](size_t i) -> uint32_t& { return indices[i]; });
+
+            [&]<size_t... Is>(std::index_sequence<Is...>) {
+                (read_alternative<T, Is>(count, at, indices), ...);
+            }(std::make_index_sequence<std::variant_size_v<T>> {});
+
+            for (size_t i = 0; i < count; i++)
+                m_bad_variant |= indices[i] >= std::variant_size_v<T>;
+        } else if constexpr (Detail::IsSparse<T>::value) {
+            read_columns<uint32_t>(count, [&at](size_t i) -> uint32_t& { return at(i).present; });
+            size_t index = 0;
+
+            BinarySchemaOf<typename T::value_type>::for_each_field([&]<typename Field>(Field) {
+                using Member = std::remove_cvref_t<decltype(std::declval<T&>().values.*Field::member)>;
+                const size_t bit = index++;
+
+                std::array<uint8_t, k_columnar_max_rows> rows;
+                size_t holding = 0;
+
+                for (size_t i = 0; i < count; i++) {
+                    if ((at(i).present >> bit) & 1)
+                        rows[holding++] = static_cast<uint8_t>(i);
+                }
+
+                if (holding != 0) {
+                    read_columns<Member>(holding, [&at, &rows](size_t j) -> Member& {
+                        return at(rows[j]).values.*Field::member;
+                    });
+                }
+            });
+        } else if constexpr (BinaryRepresented<T>) {
+            using Repr = Detail::BinaryReprOf<T>;
+            read_columns<Repr>(count, [&at](size_t i) -> Repr& { return _tele_adl_binary_repr(at(i)); });
+        } else if constexpr (BinarySchematized<T>) {
+            decltype(_tele_adl_binary_schema(T {}))::for_each_field([this, count, &at]<typename Field>(Field) {
+                using Member = std::remove_cvref_t<decltype(std::declval<T&>().*Field::member)>;
+                read_columns<Member>(count, [&at](size_t i) -> Member& { return at(i).*Field::member; });
+            });
+        } else {
+            static_assert(!std::is_same_v<T, T>, "the type has no columnar representation");
+        }
+    }
+
+    template<typename Variant, size_t I, typename At>
+    constexpr void
+    read_alternative(size_t count, At const& at, std::array<uint32_t, k_columnar_max_rows> const& indices) {
+        using Alternative = std::variant_alternative_t<I, Variant>;
+
+        std::array<uint8_t, k_columnar_max_rows> rows;
+        size_t holding = 0;
+
+        for (size_t i = 0; i < count; i++) {
+            if (indices[i] != I)
+                continue;
+
+            at(i).template emplace<I>();
+            rows[holding++] = static_cast<uint8_t>(i);
+        }
+
+        if (holding == 0)
+            return;
+
+        read_columns<Alternative>(holding, [&at, &rows](size_t j) -> Alternative& { return std::get<I>(at(rows[j])); });
+    }
+
+    template<typename At> constexpr void read_float_column(size_t count, At const& at) {
+        uint32_t previous = static_cast<uint32_t>(m_bits.read_bits(32));
+        at(0) = std::bit_cast<float>(previous);
+
+        size_t window_leading = 0;
+        size_t window_trailing = 0;
+
+        for (size_t i = 1; i < count; i++) {
+            if (m_bits.read_bit()) {
+                if (m_bits.read_bit()) {
+                    window_leading = m_bits.read_bits(5);
+                    window_trailing = 32 - window_leading - (m_bits.read_bits(5) + 1);
+
+                    // a corrupt length may not fit next to the leading zeroes
+                    window_trailing = std::min<size_t>(window_trailing, 31);
+                }
+
+                const size_t length = 32 - std::min<size_t>(window_leading + window_trailing, 31);
+                previous ^= static_cast<uint32_t>(m_bits.read_bits(length) << window_trailing);
+            }
+
+            at(i) = std::bit_cast<float>(previous);
+        }
+    }
+
+    constexpr uint64_t read_delta_of_delta() {
+        if (!m_bits.read_bit())
+            return 0;
+        if (!m_bits.read_bit())
+            return m_bits.read_bits(7);
+        if (!m_bits.read_bit())
+            return m_bits.read_bits(9);
+        if (!m_bits.read_bit())
+            return m_bits.read_bits(12);
+
+        return m_bits.read_bits(36);
+    }
+
+    template<typename T, typename At> constexpr void read_integer_column(size_t count, At const& at) {
+        using Integer = typename Detail::ColumnInteger<T>::type;
+        using Unsigned = std::make_unsigned_t<std::conditional_t<std::is_same_v<Integer, bool>, uint8_t, Integer>>;
+
+        auto store = [&at](size_t i, int64_t value) { at(i) = static_cast<T>(static_cast<Integer>(value)); };
+
+        int64_t previous = static_cast<Integer>(static_cast<Unsigned>(m_bits.read_bits(sizeof(Integer) * 8)));
+        int64_t previous_delta = 0;
+
+        store(0, previous);
+
+        for (size_t i = 1; i < count; i++) {
+            previous_delta += Detail::zigzag_decode(read_delta_of_delta());
+            previous += previous_delta;
+
+            store(i, previous);
+        }
+    }
+};
+
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+#include <tl/expected.hpp>
+
+#include <Tele/Kernels.hpp>
+
+namespace Tele {
+
+/// Codes an array of floats lying on the grid of `Grid`, a `RangeFloat<uint8_t, ...>`, as the rounded mean of their raw
+/// values followed by every raw value's difference from it as an `int8_t`.\n
+/// Attach it to a field through `BinarySchema::coded_field`:
+/// @code
+/// .coded_field<&FullPacket::battery_voltages, Tele::CommonModeCodec<BatteryVoltageGrid, k_battery_cell_count>>()
+/// @endcode
+/// @remarks
+/// Only the first `Count` values are coded, the ones after them are never written and read back as 0. This is for
+/// arrays longer than the channels they are bound to.\n
+/// The first byte is the mode. Arrays that are all +0, which nothing has written to, are just an `unset` byte. Arrays
+/// with values off of the grid, or with residuals that don't fit in an `int8_t`, are written as they are after a `raw`
+/// byte, the rest after a `common_mode` one. Raw values are turned back into floats through `Kernels::scale_u8` like
+/// the CAN decoders do, the encoder checks that this gives back the exact same bits.
+template<typename Grid, size_t Count = SIZE_MAX>
+    requires(std::is_same_v<typename Grid::repr_type, uint8_t>)
+struct CommonModeCodec {
+    inline static constexpr uint8_t raw = 0;
+    inline static constexpr uint8_t common_mode = 1;
+    inline static constexpr uint8_t unset = 2;
+
+    template<typename Writer, size_t N> static void write(Writer& writer, float const (&values)[N]) {
+        constexpr size_t coded = std::min(N, Count);
+        const auto coded_values = std::span(values).template first<coded>();
+
+        if (std::ranges::all_of(coded_values, [](float v) { return std::bit_cast<uint32_t>(v) == 0; })) {
+            writer.write_byte(unset);
+            return;
+        }
+
+        std::array<uint8_t, coded> raw_values;
+        std::array<float, coded> restored;
+        Kernels::quantize_u8(coded_values, raw_values, Grid::value_step, Grid::min);
+        Kernels::scale_u8(raw_values, restored, Grid::value_step, Grid::min);
+
+        const auto reduction = Kernels::reduce_u8(raw_values);
+        const int mean = static_cast<int>((reduction.sum + coded / 2) / coded);
+
+        const bool on_grid = std::memcmp(values, restored.data(), sizeof(restored)) == 0;
+        const bool fits = reduction.max - mean <= INT8_MAX && reduction.min - mean >= INT8_MIN;
+
+        if (!on_grid || !fits) {
+            writer.write_byte(raw);
+            for (float value : coded_values)
+                writer.write(value);
+            return;
+        }
+
+        writer.write_byte(common_mode);
+        writer.write_byte(static_cast<uint8_t>(mean));
+
+        for (uint8_t value : raw_values)
+            writer.write_byte(static_cast<uint8_t>(value - mean));
+    }
+
+    template<typename Reader, size_t N>
+    static tl::expected<void, std::string_view> read(Reader& reader, float (&values)[N]) {
+        constexpr size_t coded = std::min(N, Count);
+        const auto coded_values = std::span(values).template first<coded>();
+
+        std::fill(std::begin(values), std::end(values), 0.f);
+
+        auto mode = reader.read_byte();
+        if (!mode)
+            return tl::unexpected { mode.error() };
+
+        if (*mode == unset)
+            return {};
+
+        if (*mode == raw) {
+            for (float& value : coded_values) {
+                if (auto res = reader.read(value); !res)
+                    return tl::unexpected { res.error() };
+            }
+
+            return {};
+        }
+
+        if (*mode != common_mode)
+            return tl::unexpected { "bad common mode tag" };
+
+        auto mean = reader.read_byte();
+        if (!mean)
+            return tl::unexpected { mean.error() };
+
+        std::array<uint8_t, coded> raw_values;
+
+        for (auto& value : raw_values) {
+            auto residual = reader.read_byte();
+            if (!residual)
+                return tl::unexpected { residual.error() };
+
+            const int restored = *mean + static_cast<int8_t>(*residual);
+            if (restored < 0 || restored > UINT8_MAX)
+                return tl::unexpected { "residual out of range" };
+
+            value = static_cast<uint8_t>(restored);
+        }
+
+        Kernels::scale_u8(raw_values, coded_values, Grid::value_step, Grid::min);
+
+        return {};
+    }
+};
+
+}
@@ -1,128 +1,652 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <functional>
+#include <limits>
+#include <optional>
 #include <span>
-#include <unordered_map>
-
-#include <fmt/format.h>
+#include <stdexcept>
+#include <type_traits>
 
 #include <FreeRTOS.h>
-#include <semphr.h>
+#include <event_groups.h>
+#include <task.h>
 
+#include <Tele/Channels.hpp>
+#include <Tele/STUtilities.hpp>
 #include <Tele/StaticTask.hpp>
 
 namespace Tele {
 
+template<typename T> struct HistorySample {
+    /// the value of `high_frequency_ticks()` at the time of the write
+    uint32_t timestamp;
+    T value;
+};
+
+/// Stores the latest value of every channel in `k_channel_table`.\n
+/// Writes are published as a whole through a sequence lock: a writer bumps the sequence to an odd value, stores the
+/// values and bumps it back to an even one. Readers never block, they copy what they need and retry if the sequence
+/// changed in the meantime.\n
+/// Channels with a nonzero history in `TELE_CHANNEL_LIST` also keep their last few writes in a ring, see
+/// `history_last` and `history_since`.\n
+/// The aggregates in `TELE_AGGREGATE_LIST` are kept up to date as their source arrays get written.\n
+/// Writes and reads are counted per channel, see `channel_statistics` and the `collector_` channels.\n
+/// Every write is timestamped, channels that weren't written within their TTL are stale, see `is_fresh`.\n
+/// Tasks can subscribe to a set of channels to get woken up when any of them is written instead of polling.
 struct DataCollectorTask {
-    DataCollectorTask()
-        : m_mutex(xSemaphoreCreateMutex()) { }
+    inline static constexpr size_t max_subscribers = 4;
 
-    ~DataCollectorTask() { }
+    struct Subscription {
+        uint8_t index;
+    };
 
-    template<std::floating_point T = float> void set(std::string_view key, T v) {
-        lock();
-        m_float_map[key] = static_cast<double>(v);
-        unlock();
-    }
+    struct Writer {
+        template<typename T> void set(Channel<T, 1> channel, std::type_identity_t<T> v) {
+            const uint32_t raw = std::bit_cast<uint32_t>(v);
 
-    template<std::integral T = int64_t> void set(std::string_view key, T v) {
-        lock();
-        m_integral_map[key] = static_cast<int64_t>(v);
-        unlock();
-    }
+            m_self.m_values[channel.offset].store(raw, std::memory_order_relaxed);
+            m_self.mark_written(channel.id, m_timestamp);
+            m_touched.add(channel.id);
 
-    template<typename T>
-    void set_array(std::string_view key_base, std::span<const T> vs, size_t offset = 0) {
-        for (size_t i = 0; auto v : vs) {
-            auto key = fmt::format("{}_{}", key_base, offset + i++);
-            set<T>(key, v);
+            if (channel.history_capacity != 0)
+                m_self.push_history(channel.id, channel.history_offset, channel.history_capacity, m_timestamp, raw);
         }
-    }
 
-    template<std::floating_point T = float> T get(std::string_view key, T def = T(0)) const {
-        if (auto it = std::find_if(
-              std::begin(m_special_floats), std::end(m_special_floats), [key](auto v) { return v.first == key; }
-            );
-            it != std::end(m_special_floats)) {
-            return static_cast<T>((it->second)());
+        template<typename T, size_t Extent>
+        void set_array(Channel<T, Extent> channel, std::span<const T> vs, size_t offset = 0) {
+            offset = std::min(offset, Extent);
+            const size_t count = std::min(vs.size(), Extent - offset);
+
+            std::array<uint32_t, Extent> previous;
+
+            for (size_t i = 0; i < count; i++) {
+                std::atomic<uint32_t>& slot = m_self.m_values[channel.offset + offset + i];
+
+                previous[i] = slot.load(std::memory_order_relaxed);
+                slot.store(std::bit_cast<uint32_t>(vs[i]), std::memory_order_relaxed);
+            }
+
+            m_self.mark_written(channel.id, m_timestamp);
+            m_touched.add(channel.id);
+
+            if constexpr (std::is_same_v<T, float>) {
+                for (size_t i = 0; i < k_aggregate_table.size(); i++) {
+                    if (k_aggregate_table[i].source == channel.id)
+                        update_aggregate(i, channel.offset, offset, std::span(previous).first(count));
+                }
+            }
         }
 
-        lock();
-        float ret = def;
-        if (auto it = m_float_map.find(key); it != m_float_map.end()) {
-            ret = it->second;
+    private:
+        friend struct DataCollectorTask;
+
+        constexpr Writer(DataCollectorTask& self, uint32_t timestamp)
+            : m_self(self)
+            , m_timestamp(timestamp) { }
+
+        DataCollectorTask& m_self;
+        uint32_t m_timestamp;
+        ChannelSet m_touched {};
+
+        /// Updates the aggregate at `index` of `k_aggregate_table` after a write of `previous.size()` elements
+        /// starting from `offset`, `previous` holds the overwritten values.
+        void update_aggregate(size_t index, uint16_t slots, size_t offset, std::span<const uint32_t> previous) {
+            AggregateDescriptor const& descriptor = k_aggregate_table[index];
+            AggregateState& state = m_self.m_aggregate_states[index];
+
+            auto element = [&](size_t i) {
+                return std::bit_cast<float>(m_self.m_values[slots + i].load(std::memory_order_relaxed));
+            };
+
+            // the sum drifts as it accumulates rounding errors, it is recomputed every now and then
+            bool rescan = ++state.updates_since_rescan >= aggregate_rescan_interval;
+
+            const size_t end = std::min<size_t>(offset + previous.size(), descriptor.count);
+            for (size_t i = offset; i < end; i++) {
+                const float value = element(i);
+                state.sum += value - std::bit_cast<float>(previous[i - offset]);
+
+                // the extremum itself got less extreme, another element might have taken its place
+                if ((i == state.argmin && value > state.min) || (i == state.argmax && value < state.max)) {
+                    rescan = true;
+                    continue;
+                }
+
+                if (value < state.min) {
+                    state.min = value;
+                    state.argmin = i;
+                }
+
+                if (value > state.max) {
+                    state.max = value;
+                    state.argmax = i;
+                }
+            }
+
+            if (rescan) {
+                state = AggregateState { .sum = 0.f, .min = element(0), .max = element(0) };
+
+                for (uint16_t i = 0; i < descriptor.count; i++) {
+                    const float value = element(i);
+                    state.sum += value;
+
+                    if (value < state.min) {
+                        state.min = value;
+                        state.argmin = i;
+                    }
+
+                    if (value > state.max) {
+                        state.max = value;
+                        state.argmax = i;
+                    }
+                }
+            }
+
+            set(descriptor.sum, state.sum);
+            set(descriptor.min, state.min);
+            set(descriptor.max, state.max);
+            set(descriptor.avg, state.sum / descriptor.count);
+            set(descriptor.argmin, state.argmin);
+            set(descriptor.argmax, state.argmax);
         }
-        unlock();
-        return ret;
-    }
+    };
+
+    /// @remarks
+    /// The values a reader returns may be torn until `read` validates them, don't act on them inside the callback.
+    struct Reader {
+        template<typename T> T get(Channel<T, 1> channel, std::type_identity_t<T> def = T(0)) const {
+            m_read.add(channel.id);
 
-    template<std::integral T = int64_t> T get(std::string_view key, T def = T(0)) const {
-        if (auto it = std::find_if(
-              std::begin(m_special_integrals), std::end(m_special_integrals), [key](auto v) { return v.first == key; }
-            );
-            it != std::end(m_special_integrals)) {
-            return static_cast<T>((it->second)());
+            if (!m_self.was_written(channel.id))
+                return def;
+
+            return std::bit_cast<T>(m_self.m_values[channel.offset].load(std::memory_order_relaxed));
         }
 
-        lock();
-        uint64_t ret = def;
-        if (auto it = m_integral_map.find(key); it == m_integral_map.end()) {
-            ret = it->second;
+        template<typename T> T get(ComputedChannel<T> channel) const { return channel.compute(); }
+
+        /// @return
+        /// The value of `channel` if it was written in the last `max_age` high frequency ticks.
+        template<typename T> std::optional<T> get_if_fresh(Channel<T, 1> channel, uint32_t max_age) const {
+            m_read.add(channel.id);
+
+            if (!is_fresh(channel, max_age))
+                return std::nullopt;
+
+            return std::bit_cast<T>(m_self.m_values[channel.offset].load(std::memory_order_relaxed));
+        }
+
+        /// Same as the other overload but uses the channel's TTL from `TELE_CHANNEL_LIST`.
+        template<typename T> std::optional<T> get_if_fresh(Channel<T, 1> channel) const {
+            return get_if_fresh(channel, ttl_of(channel.id));
+        }
+
+        /// @return
+        /// The value of `high_frequency_ticks()` when `channel` was last written, `std::nullopt` if it never was.
+        template<typename T, size_t Extent> std::optional<uint32_t> written_at(Channel<T, Extent> channel) const {
+            if (!m_self.was_written(channel.id))
+                return std::nullopt;
+
+            return m_self.m_write_timestamps[channel.id].load(std::memory_order_relaxed);
+        }
+
+        template<typename T, size_t Extent> bool is_fresh(Channel<T, Extent> channel, uint32_t max_age) const {
+            const auto timestamp = written_at(channel);
+            if (!timestamp)
+                return false;
+
+            return high_frequency_ticks() - *timestamp <= max_age;
+        }
+
+        /// Same as the other overload but uses the channel's TTL from `TELE_CHANNEL_LIST`.
+        template<typename T, size_t Extent> bool is_fresh(Channel<T, Extent> channel) const {
+            return is_fresh(channel, ttl_of(channel.id));
+        }
+
+        template<typename T> constexpr bool is_fresh(ComputedChannel<T>) const { return true; }
+
+        template<typename T, size_t Extent> void get_array(Channel<T, Extent> channel, std::span<T> vs) const {
+            m_read.add(channel.id);
+
+            const size_t count = std::min(vs.size(), Extent);
+
+            for (size_t i = 0; i < count; i++) {
+                vs[i] = std::bit_cast<T>(m_self.m_values[channel.offset + i].load(std::memory_order_relaxed));
+            }
+        }
+
+        /// Copies the last `out.size()` samples of `channel` into `out`, oldest first.
+        /// @return
+        /// The amount of samples copied, this is less than `out.size()` if the channel does not have that many.
+        template<typename T>
+        size_t history_last(Channel<T, 1> channel, std::span<HistorySample<std::type_identity_t<T>>> out) const {
+            m_read.add(channel.id);
+
+            const uint32_t head = m_self.m_history_heads[channel.id].load(std::memory_order_relaxed);
+            const size_t available = std::min<size_t>(head, channel.history_capacity);
+            const size_t count = std::min(out.size(), available);
+
+            for (size_t i = 0; i < count; i++) {
+                out[i] = sample_at<T>(channel, head - count + i);
+            }
+
+            return count;
+        }
+
+        /// Copies the samples of `channel` written at or after `since` into `out`, oldest first.
+        /// @remarks
+        /// If `out` is too small, the newest `out.size()` of those samples are copied.
+        /// @return
+        /// The amount of samples copied.
+        template<typename T>
+        size_t history_since(
+          Channel<T, 1> channel,
+          uint32_t since,
+          std::span<HistorySample<std::type_identity_t<T>>> out
+        ) const {
+            m_read.add(channel.id);
+
+            const uint32_t head = m_self.m_history_heads[channel.id].load(std::memory_order_relaxed);
+            const size_t available = std::min<size_t>(head, channel.history_capacity);
+
+            size_t newer = 0;
+            for (; newer < available; newer++) {
+                const auto sample = sample_at<T>(channel, head - 1 - newer);
+                // wraparound-safe `sample.timestamp < since`
+                if (static_cast<int32_t>(sample.timestamp - since) < 0)
+                    break;
+            }
+
+            const size_t count = std::min(out.size(), newer);
+
+            for (size_t i = 0; i < count; i++) {
+                out[i] = sample_at<T>(channel, head - count + i);
+            }
+
+            return count;
+        }
+
+    private:
+        friend struct DataCollectorTask;
+
+        constexpr Reader(DataCollectorTask const& self)
+            : m_self(self) { }
+
+        DataCollectorTask const& m_self;
+
+        /// the channels read by the current attempt, counted once it validates
+        mutable ChannelSet m_read {};
+
+        static constexpr uint32_t ttl_of(uint16_t id) {
+            const uint32_t ttl_ms = k_channel_table[id].ttl_ms;
+            return ttl_ms == 0 ? std::numeric_limits<uint32_t>::max() : ms_to_high_frequency_ticks(ttl_ms);
+        }
+
+        template<typename T> HistorySample<T> sample_at(Channel<T, 1> channel, uint32_t index) const {
+            const size_t slot = channel.history_offset + (index & (channel.history_capacity - 1));
+
+            return {
+                .timestamp = m_self.m_history[slot].timestamp.load(std::memory_order_relaxed),
+                .value = std::bit_cast<T>(m_self.m_history[slot].value.load(std::memory_order_relaxed)),
+            };
+        }
+    };
+
+    DataCollectorTask() = default;
+
+    ~DataCollectorTask() = default;
+
+    /// Runs `fn` with a `Writer` and publishes everything it wrote at once.
+    /// @remarks
+    /// This function must be called from a FreeRTOS thread.\n
+    /// `fn` runs with the scheduler suspended, keep it short and don't block in it.
+    template<typename Fn> void publish(Fn&& fn) {
+        /*
+         * There is a single core and readers are tasks, suspending the scheduler is enough to keep other writers out
+         * and guarantees that no reader can observe an odd sequence (and spin on it, starving us if it has a higher
+         * priority). The sequence is still needed for readers that we preempt.
+         */
+        vTaskSuspendAll();
+
+        const uint32_t hold_start = cycle_count();
+
+        Writer writer { *this, high_frequency_ticks() };
+
+        const uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        std::invoke(fn, writer);
+
+        if (writer.m_timestamp - m_window_start.load(std::memory_order_relaxed) >= k_high_frequency_tick_rate)
+            roll_statistics(writer);
+
+        m_sequence.store(sequence + 2, std::memory_order_release);
+
+        const uint32_t hold_cycles = cycle_count() - hold_start;
+        if (hold_cycles > m_max_hold_cycles.load(std::memory_order_relaxed))
+            m_max_hold_cycles.store(hold_cycles, std::memory_order_relaxed);
+
+        xTaskResumeAll();
+
+        notify_subscribers(writer.m_touched);
+    }
+
+    /// Runs `fn` with a `Reader` until it has seen a consistent snapshot and returns its result.
+    /// @remarks
+    /// This function is thread safe and never blocks. It must be called from a FreeRTOS thread, it publishes the
+    /// statistics once a window ends without a write.\n
+    /// `fn` may be invoked more than once, the channels it reads are counted once per call.
+    template<typename Fn> std::invoke_result_t<Fn, Reader const&> read(Fn&& fn) const {
+        const Reader reader { *this };
+        const uint32_t start = cycle_count();
+
+        for (bool retried = false;; retried = true) {
+            const uint32_t sequence = m_sequence.load(std::memory_order_acquire);
+            reader.m_read = {};
+
+            if ((sequence & 1) == 0) {
+                if constexpr (std::is_void_v<std::invoke_result_t<Fn, Reader const&>>) {
+                    std::invoke(fn, reader);
+                    if (validate(sequence, retried, start)) {
+                        finish_read(reader);
+                        return;
+                    }
+                } else {
+                    auto ret = std::invoke(fn, reader);
+                    if (validate(sequence, retried, start)) {
+                        finish_read(reader);
+                        return ret;
+                    }
+                }
+            }
+
+            m_read_retries.fetch_add(1, std::memory_order_relaxed);
         }
-        unlock();
+    }
+
+    template<typename T> void set(Channel<T, 1> channel, std::type_identity_t<T> v) {
+        publish([&](Writer& writer) { writer.set(channel, v); });
+    }
+
+    template<typename T, size_t Extent>
+    void set_array(Channel<T, Extent> channel, std::span<const T> vs, size_t offset = 0) {
+        publish([&](Writer& writer) { writer.set_array(channel, vs, offset); });
+    }
+
+    template<typename T> T get(Channel<T, 1> channel, std::type_identity_t<T> def = T(0)) const {
+        return read([&](Reader const& reader) { return reader.get(channel, def); });
+    }
+
+    template<typename T> T get(ComputedChannel<T> channel) const { return channel.compute(); }
+
+    template<typename T> std::optional<T> get_if_fresh(Channel<T, 1> channel, uint32_t max_age) const {
+        return read([&](Reader const& reader) { return reader.get_if_fresh(channel, max_age); });
+    }
+
+    template<typename T> std::optional<T> get_if_fresh(Channel<T, 1> channel) const {
+        return read([&](Reader const& reader) { return reader.get_if_fresh(channel); });
+    }
+
+    template<typename T, size_t Extent> bool is_fresh(Channel<T, Extent> channel) const {
+        return read([&](Reader const& reader) { return reader.is_fresh(channel); });
+    }
+
+    template<typename T, size_t Extent> void get_array(Channel<T, Extent> channel, std::span<T> vs) const {
+        read([&](Reader const& reader) { reader.get_array(channel, vs); });
+    }
+
+    template<typename T, size_t Extent> std::array<T, Extent> get_array(Channel<T, Extent> channel) const {
+        std::array<T, Extent> ret;
+        get_array<T, Extent>(channel, ret);
         return ret;
     }
 
     template<typename T>
-    void get_array(std::string_view key_base, std::span<T> vs) {
-        for (size_t i = 0; auto& v : vs) {
-            auto key = fmt::format("{}_{}", key_base, i++);
-            v = get<T>(key);
-        }
+    size_t history_last(Channel<T, 1> channel, std::span<HistorySample<std::type_identity_t<T>>> out) const {
+        return read([&](Reader const& reader) { return reader.history_last(channel, out); });
+    }
+
+    template<typename T>
+    size_t history_since(Channel<T, 1> channel, uint32_t since, std::span<HistorySample<std::type_identity_t<T>>> out)
+      const {
+        return read([&](Reader const& reader) { return reader.history_since(channel, since, out); });
+    }
+
+    /// Sets the notification bits `bits` of `task` (as in `xTaskNotify(task, bits, eSetBits)`) whenever any of
+    /// `channels` is written.
+    /// @remarks
+    /// This function is not thread safe with respect to other `subscribe` calls, subscribe from one place (i.e.
+    /// during initialisation or from the subscribing task itself before it starts waiting).\n
+    /// Throws if there are more than `max_subscribers` subscriptions.
+    Subscription subscribe_task(ChannelSet channels, TaskHandle_t task, uint32_t bits) {
+        return add_subscriber(channels, task, nullptr, bits);
     }
 
-    template<typename T, size_t N>
-    std::array<T, N> get_array(std::string_view key_base) {
-        std::array<T, N> ret;
-        get_array<T>(key_base, std::span<T>{ ret.data(), ret.size() });
+    /// Sets `bits` of `event_group` whenever any of `channels` is written, see `subscribe_task`.
+    Subscription subscribe_event_group(ChannelSet channels, EventGroupHandle_t event_group, EventBits_t bits) {
+        return add_subscriber(channels, nullptr, event_group, bits);
+    }
+
+    /// @return
+    /// The channels of `subscription` that were written since the last call to this function.
+    ChannelSet take_dirty(Subscription subscription) {
+        Subscriber& subscriber = m_subscribers[subscription.index];
+
+        ChannelSet ret {};
+        for (size_t i = 0; i < k_channel_set_words; i++)
+            ret.words[i] = subscriber.dirty[i].exchange(0, std::memory_order_relaxed);
+
         return ret;
     }
 
+    /// Fills the fields of `out` from their channels in one consistent snapshot. Fields of stale channels are left
+    /// untouched.
+    /// @remarks
+    /// The fields are described by a `ChannelBinder` found through `_tele_adl_channel_binder(T&&)`, include
+    /// `Tele/ChannelBinder.hpp` to use this.
+    /// @return
+    /// A mask of the bindings that were stale, bit `i` being the `i`th binding.
+    template<typename T> uint32_t snapshot(T& out) const;
+
+    /// @return
+    /// The amount of times a reader had to start over because a writer got in the way.
+    uint32_t read_retries() const { return m_read_retries.load(std::memory_order_relaxed); }
+
+    struct ChannelStatistics {
+        uint32_t writes;
+        uint32_t reads;
+
+        /// over the last second or so, as of the last write to any channel or the first read after a quiet second
+        uint32_t writes_per_second;
+    };
+
+    /// @remarks
+    /// The counters are relaxed and independent of each other, they are not a consistent snapshot.
+    ChannelStatistics channel_statistics(uint16_t id) const {
+        return {
+            .writes = m_write_counts[id].load(std::memory_order_relaxed),
+            .reads = m_read_counts[id].load(std::memory_order_relaxed),
+            .writes_per_second = m_write_rates[id].load(std::memory_order_relaxed),
+        };
+    }
+
 private:
-    SemaphoreHandle_t m_mutex;
+    std::atomic<uint32_t> m_sequence { 0 };
+    mutable std::atomic<uint32_t> m_read_retries { 0 };
 
-    std::unordered_map<std::string_view, double> m_float_map {};
-    std::unordered_map<std::string_view, int64_t> m_integral_map {};
+    std::array<std::atomic<uint32_t>, k_channel_slots> m_values {};
+    std::array<std::atomic<uint32_t>, k_channel_set_words> m_written {};
+    std::array<std::atomic<uint32_t>, k_channel_count> m_write_timestamps {};
 
-    inline static std::pair<std::string_view, double (*)()> m_special_floats[] {
-        { "rtos_cpu_usage", []() -> double { return 3.1415926f; } },
+    struct StoredSample {
+        std::atomic<uint32_t> timestamp;
+        std::atomic<uint32_t> value;
     };
 
-    inline static std::pair<std::string_view, int64_t (*)()> m_special_integrals[] {
-        { "hal_lf_ticks", []() -> int64_t { return HAL_GetTick(); } },
-        { "rtos_heap_free",
-          []() -> int64_t {
-              HeapStats_t heap_stats;
-              vPortGetHeapStats(&heap_stats);
-              return heap_stats.xAvailableHeapSpaceInBytes;
-          } },
-        { "rtos_heap_allocations",
-          []() -> int64_t {
-              HeapStats_t heap_stats;
-              vPortGetHeapStats(&heap_stats);
-              return heap_stats.xNumberOfSuccessfulAllocations;
-          } },
-        { "rtos_heap_deallocations",
-          []() -> int64_t {
-              HeapStats_t heap_stats;
-              vPortGetHeapStats(&heap_stats);
-              return heap_stats.xNumberOfSuccessfulFrees;
-          } },
+    /// the total amount of samples ever pushed into each channel's ring
+    std::array<std::atomic<uint32_t>, k_channel_count> m_history_heads {};
+    std::array<StoredSample, k_history_slots> m_history {};
+
+    /*
+     * Statistics. Writers are serialised, the write counters get away with plain loads and stores. Everything is
+     * relaxed, these are only counters.
+     */
+    std::array<std::atomic<uint32_t>, k_channel_count> m_write_counts {};
+    std::array<std::atomic<uint32_t>, k_channel_count> m_write_rates {};
+    mutable std::array<std::atomic<uint32_t>, k_channel_count> m_read_counts {};
+    mutable std::atomic<uint32_t> m_read_wait_cycles { 0 };
+    std::atomic<uint32_t> m_max_hold_cycles { 0 };
+
+    // only ever written by writers, readers look at it to tell whether they have to roll the statistics
+    std::atomic<uint32_t> m_window_start { 0 };
+
+    // only ever touched by writers
+    std::array<uint32_t, k_channel_count> m_window_writes {};
+    uint32_t m_window_reads = 0;
+
+    void mark_written(uint16_t id, uint32_t timestamp) {
+        m_written[id / 32].fetch_or(1u << (id % 32), std::memory_order_relaxed);
+        m_write_timestamps[id].store(timestamp, std::memory_order_relaxed);
+        m_write_counts[id].store(m_write_counts[id].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    /// Counts the channels of a validated read, and rolls the statistics if no writer did so since the window ended.
+    void finish_read(Reader const& reader) const {
+        for (size_t word = 0; word < k_channel_set_words; word++) {
+            for (uint32_t bits = reader.m_read.words[word]; bits != 0; bits &= bits - 1)
+                m_read_counts[word * 32 + std::countr_zero(bits)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        const uint32_t window_start = m_window_start.load(std::memory_order_relaxed);
+        if (high_frequency_ticks() - window_start >= k_high_frequency_tick_rate) {
+            // the collector is never const itself, only handed out as such. an empty publish rolls the window.
+            const_cast<DataCollectorTask*>(this)->publish([](Writer&) { });
+        }
+    }
+
+    /// Turns the counters of the window that just ended into rates and publishes them through `writer`.
+    void roll_statistics(Writer& writer) {
+        const uint32_t elapsed = writer.m_timestamp - m_window_start.load(std::memory_order_relaxed);
+        m_window_start.store(writer.m_timestamp, std::memory_order_relaxed);
+
+        auto per_second = [elapsed](uint32_t count) {
+            return static_cast<uint32_t>(static_cast<uint64_t>(count) * k_high_frequency_tick_rate / elapsed);
+        };
+
+        uint32_t total_writes = 0;
+        uint32_t total_reads = 0;
+
+        for (size_t i = 0; i < k_channel_count; i++) {
+            const uint32_t writes = m_write_counts[i].load(std::memory_order_relaxed);
+            total_reads += m_read_counts[i].load(std::memory_order_relaxed);
+
+            const uint32_t rate = per_second(writes - m_window_writes[i]);
+            m_write_rates[i].store(rate, std::memory_order_relaxed);
+            m_window_writes[i] = writes;
+            total_writes += rate;
+        }
+
+        writer.set(Channels::collector_writes_per_second, total_writes);
+        writer.set(Channels::collector_reads_per_second, per_second(total_reads - m_window_reads));
+        writer.set(Channels::collector_read_retries, m_read_retries.load(std::memory_order_relaxed));
+        writer.set(Channels::collector_read_wait_cycles, m_read_wait_cycles.load(std::memory_order_relaxed));
+        writer.set(Channels::collector_max_hold_cycles, m_max_hold_cycles.load(std::memory_order_relaxed));
+
+        m_window_reads = total_reads;
+    }
+
+    bool was_written(uint16_t id) const {
+        return (m_written[id / 32].load(std::memory_order_relaxed) & (1u << (id % 32))) != 0;
+    }
+
+    struct Subscriber {
+        ChannelSet channels;
+        TaskHandle_t task;
+        EventGroupHandle_t event_group;
+        uint32_t bits;
+
+        std::array<std::atomic<uint32_t>, k_channel_set_words> dirty {};
+    };
+
+    inline static constexpr uint16_t aggregate_rescan_interval = 32;
+
+    /// only ever touched by writers
+    struct AggregateState {
+        float sum = 0.f;
+        float min = 0.f;
+        float max = 0.f;
+        uint16_t argmin = 0;
+        uint16_t argmax = 0;
+        uint16_t updates_since_rescan = 0;
     };
 
-    void lock() const { xSemaphoreTake(m_mutex, portMAX_DELAY); }
+    std::array<AggregateState, k_aggregate_table.size()> m_aggregate_states {};
+
+    std::atomic<uint8_t> m_subscriber_count { 0 };
+    std::array<Subscriber, max_subscribers> m_subscribers {};
+
+    Subscription add_subscriber(ChannelSet channels, TaskHandle_t task, EventGroupHandle_t event_group, uint32_t bits) {
+        const uint8_t index = m_subscriber_count.load(std::memory_order_relaxed);
+        if (index == max_subscribers) {
+            throw std::runtime_error("too many data collector subscribers");
+        }
+
+        Subscriber& subscriber = m_subscribers[index];
+        subscriber.channels = channels;
+        subscriber.task = task;
+        subscriber.event_group = event_group;
+        subscriber.bits = bits;
+
+        m_subscriber_count.store(index + 1, std::memory_order_release);
+
+        return { index };
+    }
+
+    void notify_subscribers(ChannelSet const& touched) {
+        const uint8_t count = m_subscriber_count.load(std::memory_order_acquire);
+
+        for (uint8_t i = 0; i < count; i++) {
+            Subscriber& subscriber = m_subscribers[i];
+            const ChannelSet dirty = subscriber.channels & touched;
+
+            if (dirty.empty())
+                continue;
 
-    void unlock() const { xSemaphoreGive(m_mutex); }
+            for (size_t j = 0; j < k_channel_set_words; j++)
+                subscriber.dirty[j].fetch_or(dirty.words[j], std::memory_order_relaxed);
+
+            if (subscriber.task != nullptr) {
+                xTaskNotify(subscriber.task, subscriber.bits, eSetBits);
+            } else {
+                xEventGroupSetBits(subscriber.event_group, subscriber.bits);
+            }
+        }
+    }
+
+    void push_history(uint16_t id, uint16_t offset, uint16_t capacity, uint32_t timestamp, uint32_t raw) {
+        const uint32_t head = m_history_heads[id].load(std::memory_order_relaxed);
+        StoredSample& sample = m_history[offset + (head & (capacity - 1))];
+
+        sample.timestamp.store(timestamp, std::memory_order_relaxed);
+        sample.value.store(raw, std::memory_order_relaxed);
+        m_history_heads[id].store(head + 1, std::memory_order_relaxed);
+    }
+
+    bool validate(uint32_t sequence, bool retried, uint32_t start) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_sequence.load(std::memory_order_relaxed) != sequence)
+            return false;
+
+        if (retried)
+            m_read_wait_cycles.fetch_add(cycle_count() - start, std::memory_order_relaxed);
+
+        return true;
+    }
 };
 
-}
\ No newline at end of file
+}
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <concepts>
 #include <cstdint>
+#include <limits>
 #include <type_traits>
 
 #include <Stuff/Maths/Scalar.hpp>
@@ -9,7 +11,10 @@
 
 namespace Tele {
 
+/// A binary fixed point number, `data * 2^Power`.
 template<std::integral Repr, int Power> struct Fixed {
+    using repr_type = Repr;
+
     Repr data;
 
     constexpr Fixed() = default;
@@ -18,9 +23,18 @@ template<std::integral Repr, int Power> struct Fixed {
 
     template<std::integral T> constexpr Fixed(T v) { *this = v; }
 
+    /// Rounds to the nearest, saturates out of range values. NaNs become 0.
     template<std::floating_point T> constexpr Fixed& operator=(T v) {
+        // a NaN fails every comparison below and converting it is UB
+        if (v != v) {
+            data = 0;
+            return *this;
+        }
+
         constexpr T multiplier = Stf::pow(static_cast<T>(2), -Power);
         v *= multiplier;
+        v += v < 0 ? static_cast<T>(-0.5) : static_cast<T>(0.5);
+
         if (v >= std::numeric_limits<Repr>::max()) {
             data = std::numeric_limits<Repr>::max();
         } else if (v <= std::numeric_limits<Repr>::min()) {
@@ -50,16 +64,31 @@ template<std::integral Repr, int Power> struct Fixed {
     }
 };
 
-template<typename Serializer, std::signed_integral Repr, Repr Power>
+template<typename Serializer, std::integral Repr, int Power>
 constexpr tl::expected<void, std::string_view> _libstf_adl_serializer(Serializer& serializer, Fixed<Repr, Power> v) {
     return Stf::serialize(serializer, v.data);
 }
 
+template<std::integral Repr, int Power> constexpr Repr& _tele_adl_binary_repr(Fixed<Repr, Power>& v) { return v.data; }
+
+template<std::integral Repr, int Power> constexpr Repr const& _tele_adl_binary_repr(Fixed<Repr, Power> const& v) {
+    return v.data;
+}
+
+/// [Min, Max] mapped onto every value of `Repr`, both ends included.
+/// @remarks
+/// This is the mapping `SignalLayout::with_range` decodes and `Kernels::quantize_u8` encodes, values quantized through
+/// either round trip exactly.
 template<std::unsigned_integral Repr, float Min, float Max>
-    requires(Max > Min)
+    requires(Max > Min && std::numeric_limits<Repr>::digits <= 16)
 struct RangeFloat {
+    using repr_type = Repr;
+
+    static constexpr float min = Min;
+    static constexpr float max = Max;
     static constexpr float value_range = Max - Min;
-    static constexpr float value_step = value_range / (1 << std::numeric_limits<Repr>::digits);
+    static constexpr float max_data = static_cast<float>(std::numeric_limits<Repr>::max());
+    static constexpr float value_step = value_range / max_data;
 
     Repr data;
 
@@ -67,16 +96,17 @@ struct RangeFloat {
 
     template<std::floating_point T> constexpr RangeFloat(T v) { *this = v; }
 
+    /// Rounds to the nearest, saturates out of range values. NaNs become `Min`.
     template<std::floating_point T> constexpr RangeFloat& operator=(T v) {
-        v = Stf::clamp(v, Min, Max);
-        const float offset = v - Min;
-        const float step_offset = offset / value_step;
-        data = std::floor(step_offset);
+        const float inverse_step = 1.f / value_step;
+        const float scaled = (static_cast<float>(v) - Min) * inverse_step;
+        const float step_offset = scaled != scaled ? 0.f : std::clamp(scaled, 0.f, max_data);
+        data = static_cast<Repr>(step_offset + 0.5f);
 
         return *this;
     }
 
-    template<std::floating_point T> constexpr operator T() const { return Min + data * value_step; }
+    template<std::floating_point T> constexpr operator T() const { return static_cast<T>(data * value_step + Min); }
 };
 
 template<typename Serializer, std::unsigned_integral Repr, float Min, float Max>
@@ -85,4 +115,14 @@ _libstf_adl_serializer(Serializer& serializer, RangeFloat<Repr, Min, Max> v) {
     return Stf::serialize(serializer, v.data);
 }
 
+template<std::unsigned_integral Repr, float Min, float Max>
+constexpr Repr& _tele_adl_binary_repr(RangeFloat<Repr, Min, Max>& v) {
+    return v.data;
+}
+
+template<std::unsigned_integral Repr, float Min, float Max>
+constexpr Repr const& _tele_adl_binary_repr(RangeFloat<Repr, Min, Max> const& v) {
+    return v.data;
+}
+
 }
\ No newline at end of file
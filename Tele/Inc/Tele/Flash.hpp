@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include <tl/expected.hpp>
+
+namespace Tele {
+
+/// A NOR flash made of equally sized sectors, addressed by byte offsets from its start.
+/// @remarks
+/// Erased bytes read as 0xFF. A byte can be programmed once after its sector is erased, programming can only clear
+/// bits. Implementations are not thread safe.
+struct FlashDevice {
+    virtual ~FlashDevice() = default;
+
+    virtual size_t sector_size() const = 0;
+
+    virtual size_t sector_count() const = 0;
+
+    virtual tl::expected<void, std::string_view> erase(size_t sector) = 0;
+
+    virtual tl::expected<void, std::string_view> program(size_t offset, std::span<const uint8_t> data) = 0;
+
+    virtual void read(size_t offset, std::span<uint8_t> out) const = 0;
+
+    constexpr size_t size() const { return sector_size() * sector_count(); }
+};
+
+/// A `FlashDevice` in RAM to test what is built on flash with, the power can be cut after a given amount of operations.
+/// @remarks
+/// Erasing a sector and programming a byte are one operation each, an erase is either done as a whole or not at all.
+/// Once the power is cut nothing is erased or programmed until `restore_power`. Programming a byte that isn't erased is
+/// an error, as is everything out of bounds.
+template<size_t SectorSize, size_t SectorCount> struct EmulatedFlash final : FlashDevice {
+    EmulatedFlash() { m_storage.fill(0xFF); }
+
+    size_t sector_size() const override { return SectorSize; }
+
+    size_t sector_count() const override { return SectorCount; }
+
+    tl::expected<void, std::string_view> erase(size_t sector) override {
+        if (sector >= SectorCount)
+            return tl::unexpected { "sector out of bounds" };
+
+        if (!consume_operation())
+            return tl::unexpected { "power lost" };
+
+        std::fill_n(m_storage.begin() + sector * SectorSize, SectorSize, 0xFF);
+        m_erase_counts[sector]++;
+
+        return {};
+    }
+
+    tl::expected<void, std::string_view> program(size_t offset, std::span<const uint8_t> data) override {
+        if (offset + data.size() > m_storage.size())
+            return tl::unexpected { "program out of bounds" };
+
+        for (size_t i = 0; i < data.size(); i++) {
+            if (m_storage[offset + i] != 0xFF)
+                return tl::unexpected { "programming a byte that isn't erased" };
+
+            if (!consume_operation())
+                return tl::unexpected { "power lost" };
+
+            m_storage[offset + i] = data[i];
+        }
+
+        return {};
+    }
+
+    void read(size_t offset, std::span<uint8_t> out) const override {
+        std::copy_n(m_storage.begin() + offset, out.size(), out.begin());
+    }
+
+    /// Cuts the power once `operations` more erases and byte programs went through.
+    void cut_power_after(size_t operations) { m_operations_left = operations; }
+
+    void restore_power() { m_operations_left = SIZE_MAX; }
+
+    bool powered() const { return m_operations_left != 0; }
+
+    uint32_t erase_count(size_t sector) const { return m_erase_counts[sector]; }
+
+private:
+    std::array<uint8_t, SectorSize * SectorCount> m_storage;
+    std::array<uint32_t, SectorCount> m_erase_counts {};
+    size_t m_operations_left = SIZE_MAX;
+
+    bool consume_operation() {
+        if (m_operations_left == 0)
+            return false;
+
+        if (m_operations_left != SIZE_MAX)
+            m_operations_left--;
+
+        return true;
+    }
+};
+
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include <tl/expected.hpp>
+
+#include <Tele/Flash.hpp>
+
+namespace Tele {
+
+/// A log of byte records on a `FlashDevice` that outlives resets and power losses, read back oldest first.
+/// @remarks
+/// Sectors are filled one after the other and reused round robin so that they wear evenly. Once the spool is full, the
+/// sector after the newest one is erased and whatever was pending in it is dropped. Sectors begin with a header:
+/// <br/>
+/// [0, 4): the erase count of the sector, best effort, programmed right after the erase
+/// <br/>
+/// [4, 8): the sequence number of the sector, one more than that of the sector before it
+/// <br/>
+/// [8, 12): reserved
+/// <br/>
+/// [12, 16): `sector_magic`, programmed last
+/// <br/>
+/// Records follow, each aligned to 4 bytes:
+/// <br/>
+/// [0, 2): the length of the payload, 0xFFFF past the last record
+/// <br/>
+/// [2, 3): zero once the payload is programmed
+/// <br/>
+/// [3, 4): zero once the record is consumed
+/// <br/>
+/// [4, 8): the CRC-32 of the length and the payload
+/// <br/>
+/// [8, 8 + length): the payload
+/// <br/>
+/// A record cut short by a power loss fails its check, `recover` treats its sector as full. Erases are assumed to
+/// either complete or leave the sector without a valid header.\n
+/// Records can be read ahead of consuming them, so that they stay in the spool until whatever they were read for is
+/// done with them. Pending records are numbered in order through tickets, the oldest one after `recover` gets 0.\n
+/// This is not thread safe.
+struct FlashSpool {
+    inline static constexpr uint32_t sector_magic = 0x4C50'5354; // "TSPL"
+    inline static constexpr size_t sector_header_size = 16;
+    inline static constexpr size_t record_header_size = 8;
+
+    struct Statistics {
+        size_t pending;
+        uint32_t appended;
+        uint32_t consumed;
+        uint32_t dropped;
+        uint32_t max_erase_count;
+    };
+
+    FlashSpool(FlashDevice& flash);
+
+    /// Finds the pending records and where to append, call it before anything else.
+    /// @return
+    /// The number of pending records.
+    size_t recover();
+
+    /// @remarks
+    /// Erases a sector whenever the current one fills up, the internal flash stalls the CPU for a second or two then.
+    /// `prepare` does that ahead of time.
+    tl::expected<void, std::string_view> append(std::span<const uint8_t> payload);
+
+    /// Erases the sector that `append` moves on to next and programs its erase count, unless something is pending in
+    /// it or it is blank or prepared already.
+    /// @remarks
+    /// This is for moving the erase to a time when the stall it causes is affordable. A sector that holds nothing but
+    /// its erase count is recognized as prepared after a reset, it is read through once then.
+    /// @return
+    /// true if a sector was erased
+    tl::expected<bool, std::string_view> prepare();
+
+    /// Copies the oldest pending record into `out`.
+    /// @return
+    /// The length of the record, zero if there are none.
+    tl::expected<size_t, std::string_view> peek(std::span<uint8_t> out) const;
+
+    /// Copies the oldest pending record that was not read yet into `out`, leaving it pending.
+    /// @return
+    /// The length of the record, zero if there are none. `ticket` is set to the ticket of the record.
+    tl::expected<size_t, std::string_view> read(std::span<uint8_t> out, uint32_t& ticket);
+
+    /// Makes `read` start over from the oldest pending record.
+    void rewind() { m_read_ahead = 0; }
+
+    /// Consumes the oldest pending record.
+    tl::expected<void, std::string_view> pop();
+
+    /// Consumes every pending record.
+    tl::expected<void, std::string_view> discard();
+
+    size_t pending() const { return m_pending; }
+
+    /// The number of pending records that `read` did not return yet.
+    size_t unread() const { return m_pending - m_read_ahead; }
+
+    /// The ticket of the oldest pending record, records with tickets before it were consumed or dropped.
+    uint32_t oldest_ticket() const { return m_oldest_ticket; }
+
+    size_t max_payload_size() const;
+
+    Statistics statistics() const;
+
+private:
+    inline static constexpr size_t no_sector = SIZE_MAX;
+
+    struct SectorHeader {
+        bool valid;
+        uint32_t erase_count;
+        uint32_t sequence;
+    };
+
+    struct Record {
+        uint16_t length;
+        bool committed;
+        bool consumed;
+        uint32_t crc;
+    };
+
+    enum class ScanResult {
+        /// a valid record
+        Record,
+
+        /// the erased space past the last record
+        End,
+
+        /// a record that was cut short or is corrupt, nothing past it can be trusted
+        Broken,
+    };
+
+    FlashDevice& m_flash;
+
+    size_t m_head_sector = no_sector;
+    uint32_t m_head_sequence = 0;
+    size_t m_head_offset = 0;
+
+    // only meaningful while there are pending records
+    size_t m_tail_sector = 0;
+    size_t m_tail_offset = 0;
+
+    // `read` continues from the first pending record at or after this, only meaningful while m_read_ahead != 0
+    size_t m_read_sector = 0;
+    size_t m_read_offset = 0;
+    // the number of pending records, from the oldest one on, that were read
+    size_t m_read_ahead = 0;
+    uint32_t m_oldest_ticket = 0;
+
+    // the sector `prepare` found prepared last
+    size_t m_prepared_sector = no_sector;
+
+    size_t m_pending = 0;
+    uint32_t m_appended = 0;
+    uint32_t m_consumed = 0;
+    uint32_t m_dropped = 0;
+
+    SectorHeader read_sector_header(size_t sector) const;
+
+    Record read_record(size_t sector, size_t offset) const;
+
+    ScanResult scan_record(size_t sector, size_t offset, Record& out) const;
+
+    /// Counts the pending records of a sector, returning where appending could continue through `end`.
+    size_t count_pending(size_t sector, size_t& end) const;
+
+    /// Moves `sector` and `offset` to the first pending record at or after them, moving on to newer sectors.
+    /// @return
+    /// false if there is no such record
+    bool find_pending(size_t& sector, size_t& offset) const;
+
+    /// Points the tail at the first pending record at or after `offset` in `sector`.
+    void seek_tail(size_t sector, size_t offset);
+
+    /// Checks that a sector is erased but for its erase count, which is read into `erase_count`.
+    bool is_prepared(size_t sector, uint32_t& erase_count) const;
+
+    /// Starts the next sector, dropping what was pending in it.
+    tl::expected<void, std::string_view> rotate();
+
+    size_t next_sector(size_t sector) const { return (sector + 1) % m_flash.sector_count(); }
+
+    size_t address(size_t sector, size_t offset) const { return sector * m_flash.sector_size() + offset; }
+
+    static constexpr size_t record_span(size_t length) { return record_header_size + (length + 3) / 4 * 4; }
+};
+
+}
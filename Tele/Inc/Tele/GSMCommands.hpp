@@ -8,8 +8,23 @@
 #include <fmt/core.h>
 #include <tl/expected.hpp>
 
+namespace Tele {
+
+struct TransmitTask;
+
+}
+
 namespace Tele::GSM {
 
+/// Produces an HTTP body while it is being sent, see `Command::HTTPData`.
+struct HTTPBodyWriter {
+    virtual ~HTTPBodyWriter() = default;
+
+    /// Called from the coordinator task once the modem is ready for data, must transmit exactly as many bytes as were
+    /// announced.
+    virtual void write(TransmitTask& transmit_task) = 0;
+};
+
 enum class CFUNType : int {
     Minimum = 0,
     // default
@@ -90,10 +105,11 @@ struct HTTPReadyForData;
 struct ResetChallenge;
 struct ResetFailure;
 struct ResetSuccess;
+struct PacketAck;
 
 using reply_type = std::variant<
   PeriodicMessage, Okay, Error, Ready, CFUN, CPIN, BearerParameters, CallReady, SMSReady, GPRSStatus, PositionAndTime,
-  HTTPResponseReady, HTTPResponse, HTTPReadyForData, ResetChallenge, ResetFailure, ResetSuccess>;
+  HTTPResponseReady, HTTPResponse, HTTPReadyForData, ResetChallenge, ResetFailure, ResetSuccess, PacketAck>;
 
 tl::expected<reply_type, std::string_view> parse_reply(std::string_view line);
 
@@ -254,6 +270,16 @@ struct ResetSuccess {
     std::array<uint32_t, 4> prng_vector;
 };
 
+/// A line of the packet_full endpoint's response, the server sends one for every range of sequence IDs it received.
+struct PacketAck {
+    using solicit_type = Command::HTTPRead;
+    inline static constexpr const char* name = "CST_ACK";
+
+    // inclusive
+    uint32_t first_sequence_id;
+    uint32_t last_sequence_id;
+};
+
 };
 
 namespace Command {
@@ -385,10 +411,18 @@ struct HTTPRead {
 
 /// IMPORTANT NOTICE: the data `data` is pointing to *must* stay valid until an OK is received. NEVER EVER send this
 /// without waiting for a reply.
+/// @remarks
+/// With a `body_writer`, `body_size` bytes are produced by it instead and `data` is not used. The same notice applies to
+/// the writer.
 struct HTTPData {
     inline static constexpr const char* name = "HTTPDATA";
 
     std::span<const char> data;
+
+    HTTPBodyWriter* body_writer = nullptr;
+    size_t body_size = 0;
+
+    constexpr size_t size() const { return body_writer != nullptr ? body_size : data.size(); }
 };
 
 };
@@ -427,7 +461,7 @@ FORMATTER_FACTORY(Tele::GSM::Command::HTTPSetUA, "AT+HTTPPARA=\"UA\",\"{}\"", v.
 FORMATTER_FACTORY(Tele::GSM::Command::HTTPContentType, "AT+HTTPPARA=\"CONTENT\",\"{}\"", v.content_type);
 FORMATTER_FACTORY(Tele::GSM::Command::HTTPMakeRequest, "AT+HTTPACTION={}", static_cast<int>(v.request_type));
 FORMATTER_FACTORY(Tele::GSM::Command::HTTPRead, "AT+HTTPREAD");
-FORMATTER_FACTORY(Tele::GSM::Command::HTTPData, "AT+HTTPDATA={},{}", v.data.size(), std::max(1000uz, std::min(120000uz, v.data.size() * 10 / 9600)));
+FORMATTER_FACTORY(Tele::GSM::Command::HTTPData, "AT+HTTPDATA={},{}", v.size(), std::max(1000uz, std::min(120000uz, v.size() * 10 / 9600)));
 // clang-format on
 
 #undef FORMATTER_FACTORY
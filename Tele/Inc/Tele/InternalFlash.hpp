@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstring>
+
+#include <main.h>
+
+#include <Tele/Flash.hpp>
+
+extern "C" {
+// from the linker script, the initial values of .data are the last thing in the image
+extern uint8_t _sidata;
+extern uint8_t _sdata;
+extern uint8_t _edata;
+}
+
+namespace Tele {
+
+/// The 128 KiB sectors of the STM32F407's own flash, sectors 5 through 11, as a `FlashDevice`.
+/// @remarks
+/// There is a single bank that the CPU fetches its instructions from, so the CPU stalls while a sector is being erased
+/// (one to two seconds) or a word is being programmed (16 microseconds). Interrupts aren't served during the stall
+/// either, so peripherals such as the CAN FIFOs overrun, erase when that is affordable (see `FlashSpool::prepare`).
+/// Aligned words are programmed at once, the rest byte by byte.
+template<uint32_t FirstSector, size_t SectorCount>
+    requires(FirstSector >= 5 && SectorCount != 0 && FirstSector + SectorCount <= 12)
+struct InternalFlash final : FlashDevice {
+    inline static constexpr size_t k_sector_size = 128 * 1024;
+    inline static constexpr uintptr_t k_base = FLASH_BASE + 0x2'0000 + (FirstSector - 5) * k_sector_size;
+
+    size_t sector_size() const override { return k_sector_size; }
+
+    size_t sector_count() const override { return SectorCount; }
+
+    /// @return
+    /// true if the firmware image reaches into the sectors
+    static bool overlaps_image() {
+        const uintptr_t image_end = reinterpret_cast<uintptr_t>(&_sidata) + (&_edata - &_sdata);
+        return image_end > k_base;
+    }
+
+    tl::expected<void, std::string_view> erase(size_t sector) override {
+        if (sector >= SectorCount)
+            return tl::unexpected { "sector out of bounds" };
+
+        FLASH_EraseInitTypeDef erase_init {
+            .TypeErase = FLASH_TYPEERASE_SECTORS,
+            .Banks = FLASH_BANK_1,
+            .Sector = FirstSector + sector,
+            .NbSectors = 1,
+            .VoltageRange = FLASH_VOLTAGE_RANGE_3,
+        };
+
+        uint32_t sector_error;
+
+        HAL_FLASH_Unlock();
+        const auto status = HAL_FLASHEx_Erase(&erase_init, &sector_error);
+        HAL_FLASH_Lock();
+
+        flush_data_cache();
+
+        if (status != HAL_OK)
+            return tl::unexpected { "flash erase failed" };
+
+        return {};
+    }
+
+    tl::expected<void, std::string_view> program(size_t offset, std::span<const uint8_t> data) override {
+        if (offset + data.size() > size())
+            return tl::unexpected { "program out of bounds" };
+
+        HAL_StatusTypeDef status = HAL_OK;
+
+        HAL_FLASH_Unlock();
+
+        for (size_t i = 0; i < data.size() && status == HAL_OK;) {
+            const uintptr_t address = k_base + offset + i;
+
+            if (address % 4 == 0 && data.size() - i >= 4) {
+                uint32_t word;
+                std::memcpy(&word, data.data() + i, sizeof(word));
+                status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address, word);
+                i += 4;
+            } else {
+                status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_BYTE, address, data[i]);
+                i += 1;
+            }
+        }
+
+        HAL_FLASH_Lock();
+
+        flush_data_cache();
+
+        if (status != HAL_OK)
+            return tl::unexpected { "flash program failed" };
+
+        return {};
+    }
+
+    void read(size_t offset, std::span<uint8_t> out) const override {
+        std::memcpy(out.data(), reinterpret_cast<const void*>(k_base + offset), out.size());
+    }
+
+private:
+    // the data cache may still hold what was there before an erase or a program
+    static void flush_data_cache() {
+        if (READ_BIT(FLASH->ACR, FLASH_ACR_DCEN) == 0)
+            return;
+
+        __HAL_FLASH_DATA_CACHE_DISABLE();
+        __HAL_FLASH_DATA_CACHE_RESET();
+        __HAL_FLASH_DATA_CACHE_ENABLE();
+    }
+};
+
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <tuple>
+
+#if defined(__ARM_FEATURE_DSP)
+#include <cmsis_compiler.h>
+#endif
+
+/// Small array kernels with a portable scalar implementation and, where the core has the DSP extension, one that
+/// works on four bytes at a time.
+/// @remarks
+/// The Cortex-M4 FPU is scalar, the SIMD instructions only operate on integers. Kernels converting between bytes and
+/// floats still go element by element, their DSP variants only save on loads and stores. Byte reductions are where the
+/// SIMD instructions pay off.
+namespace Tele::Kernels {
+
+/// Indices are those of the first extremum, everything is zero for empty arrays.
+template<typename T, typename Sum> struct Reduction {
+    Sum sum;
+    T min;
+    T max;
+    size_t argmin;
+    size_t argmax;
+};
+
+namespace Scalar {
+
+/// out[i] = in[i] * scale + offset
+inline void scale_u8(std::span<const uint8_t> in, std::span<float> out, float scale, float offset) {
+    const size_t count = std::min(in.size(), out.size());
+
+    for (size_t i = 0; i < count; i++)
+        out[i] = static_cast<float>(in[i]) * scale + offset;
+}
+
+/// The inverse of `scale_u8`, rounded to the nearest and saturated. NaNs become 0.
+inline void quantize_u8(std::span<const float> in, std::span<uint8_t> out, float scale, float offset) {
+    const size_t count = std::min(in.size(), out.size());
+    const float inverse_scale = 1.f / scale;
+
+    for (size_t i = 0; i < count; i++) {
+        const float scaled = (in[i] - offset) * inverse_scale;
+        // std::clamp passes NaNs through and casting them is UB
+        const float raw = std::isnan(scaled) ? 0.f : std::clamp(scaled, 0.f, 255.f);
+        out[i] = static_cast<uint8_t>(raw + 0.5f);
+    }
+}
+
+inline Reduction<uint8_t, uint32_t> reduce_u8(std::span<const uint8_t> in) {
+    Reduction<uint8_t, uint32_t> ret { 0, 0, 0, 0, 0 };
+    if (in.empty())
+        return ret;
+
+    ret.min = ret.max = in[0];
+
+    for (size_t i = 0; i < in.size(); i++) {
+        ret.sum += in[i];
+
+        if (in[i] < ret.min) {
+            ret.min = in[i];
+            ret.argmin = i;
+        }
+
+        if (in[i] > ret.max) {
+            ret.max = in[i];
+            ret.argmax = i;
+        }
+    }
+
+    return ret;
+}
+
+inline Reduction<float, float> reduce(std::span<const float> in) {
+    Reduction<float, float> ret { 0.f, 0.f, 0.f, 0, 0 };
+    if (in.empty())
+        return ret;
+
+    ret.min = ret.max = in[0];
+
+    for (size_t i = 0; i < in.size(); i++) {
+        ret.sum += in[i];
+
+        if (in[i] < ret.min) {
+            ret.min = in[i];
+            ret.argmin = i;
+        }
+
+        if (in[i] > ret.max) {
+            ret.max = in[i];
+            ret.argmax = i;
+        }
+    }
+
+    return ret;
+}
+
+}
+
+#if defined(__ARM_FEATURE_DSP)
+
+namespace DSP {
+
+namespace Detail {
+
+inline uint32_t load_word(uint8_t const* bytes) {
+    uint32_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+}
+
+inline void scale_u8(std::span<const uint8_t> in, std::span<float> out, float scale, float offset) {
+    const size_t count = std::min(in.size(), out.size());
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        const uint32_t word = Detail::load_word(in.data() + i);
+
+        out[i + 0] = static_cast<float>(word & 0xFF) * scale + offset;
+        out[i + 1] = static_cast<float>((word >> 8) & 0xFF) * scale + offset;
+        out[i + 2] = static_cast<float>((word >> 16) & 0xFF) * scale + offset;
+        out[i + 3] = static_cast<float>(word >> 24) * scale + offset;
+    }
+
+    Scalar::scale_u8(in.subspan(i, count - i), out.subspan(i), scale, offset);
+}
+
+inline void quantize_u8(std::span<const float> in, std::span<uint8_t> out, float scale, float offset) {
+    const size_t count = std::min(in.size(), out.size());
+    const float inverse_scale = 1.f / scale;
+
+    auto quantize = [inverse_scale, offset](float value) {
+        const float scaled = (value - offset) * inverse_scale;
+        const float raw = std::isnan(scaled) ? 0.f : std::clamp(scaled, 0.f, 255.f);
+        return static_cast<uint32_t>(raw + 0.5f);
+    };
+
+    size_t i = 0;
+
+    // one store per four bytes
+    for (; i + 4 <= count; i += 4) {
+        const uint32_t word = quantize(in[i]) | (quantize(in[i + 1]) << 8) //
+                            | (quantize(in[i + 2]) << 16) | (quantize(in[i + 3]) << 24);
+
+        std::memcpy(out.data() + i, &word, sizeof(word));
+    }
+
+    Scalar::quantize_u8(in.subspan(i, count - i), out.subspan(i), scale, offset);
+}
+
+inline Reduction<uint8_t, uint32_t> reduce_u8(std::span<const uint8_t> in) {
+    if (in.size() < 4)
+        return Scalar::reduce_u8(in);
+
+    uint32_t sum = 0;
+    uint32_t mins = 0xFFFF'FFFF;
+    uint32_t maxs = 0;
+
+    size_t i = 0;
+
+    for (; i + 4 <= in.size(); i += 4) {
+        const uint32_t word = Detail::load_word(in.data() + i);
+
+        // the sum of absolute differences against zero is the sum of the bytes
+        sum = __USADA8(word, 0, sum);
+
+        // `__USUB8` sets the GE flag of every byte lane where the first operand is not less than the second
+        std::ignore = __USUB8(word, mins);
+        mins = __SEL(mins, word);
+
+        std::ignore = __USUB8(word, maxs);
+        maxs = __SEL(word, maxs);
+    }
+
+    Reduction<uint8_t, uint32_t> ret { sum, 0xFF, 0, 0, 0 };
+
+    for (size_t lane = 0; lane < 4; lane++) {
+        ret.min = std::min(ret.min, static_cast<uint8_t>(mins >> (lane * 8)));
+        ret.max = std::max(ret.max, static_cast<uint8_t>(maxs >> (lane * 8)));
+    }
+
+    for (; i < in.size(); i++) {
+        ret.sum += in[i];
+        ret.min = std::min(ret.min, in[i]);
+        ret.max = std::max(ret.max, in[i]);
+    }
+
+    ret.argmin = std::distance(in.begin(), std::ranges::find(in, ret.min));
+    ret.argmax = std::distance(in.begin(), std::ranges::find(in, ret.max));
+
+    return ret;
+}
+
+}
+
+namespace Default = DSP;
+
+#else
+
+namespace Default = Scalar;
+
+#endif
+
+inline void scale_u8(std::span<const uint8_t> in, std::span<float> out, float scale, float offset) {
+    Default::scale_u8(in, out, scale, offset);
+}
+
+inline void quantize_u8(std::span<const float> in, std::span<uint8_t> out, float scale, float offset) {
+    Default::quantize_u8(in, out, scale, offset);
+}
+
+inline Reduction<uint8_t, uint32_t> reduce_u8(std::span<const uint8_t> in) { return Default::reduce_u8(in); }
+
+/// @remarks
+/// There is no SIMD path for floats.
+inline Reduction<float, float> reduce(std::span<const float> in) { return Scalar::reduce(in); }
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace Tele {
+
+namespace Detail {
+
+/// Converts to anything, for counting the initializers an aggregate takes. Never defined, only used unevaluated.
+struct AnyInitializer {
+    template<typename T> operator T() const;
+};
+
+template<size_t> using any_initializer = AnyInitializer;
+
+template<typename Struct, size_t... Is> consteval bool initializable_from(std::index_sequence<Is...>) {
+    return requires { Struct { any_initializer<Is> {}... }; };
+}
+
+/// The largest count in [Low, High) that `Struct` can be brace-initialized from.
+template<typename Struct, size_t Low, size_t High> consteval size_t initializer_count() {
+    if constexpr (High - Low <= 1) {
+        return Low;
+    } else {
+        constexpr size_t middle = Low + (High - Low) / 2;
+
+        if constexpr (initializable_from<Struct>(std::make_index_sequence<middle> {}))
+            return initializer_count<Struct, middle, High>();
+        else
+            return initializer_count<Struct, Low, middle>();
+    }
+}
+
+template<typename Struct, auto Member> inline constexpr size_t element_count = [] {
+    using T = std::remove_cvref_t<decltype(std::declval<Struct const&>().*Member)>;
+    return sizeof(T) / sizeof(std::remove_all_extents_t<T>);
+}();
+
+}
+
+/// Whether the data members `Members` of `Struct` are listed in the order they are declared in, none of them twice.
+/// @remarks
+/// For the member lists kept next to a struct's introspector (schemas, binders, quantizations), so that they can't
+/// drift from the declaration unnoticed. `Struct` must be constant-initializable.
+template<typename Struct, auto... Members> consteval bool in_declaration_order() {
+    if constexpr (sizeof...(Members) < 2) {
+        return true;
+    } else {
+        const Struct object {};
+        const std::array<const void*, sizeof...(Members)> addresses { static_cast<const void*>(&(object.*Members))... };
+
+        for (size_t i = 1; i < addresses.size(); i++) {
+            if (!(addresses[i - 1] < addresses[i]))
+                return false;
+        }
+
+        return true;
+    }
+}
+
+/// Whether `Members` are every data member of the aggregate `Struct`, in the order they are declared in.
+/// @remarks
+/// The members are counted through the initializers `Struct` takes with its braces elided, a C array counts as many
+/// members as it has elements. The introspectors can't be walked at compile time, so the lists that ought to cover a
+/// whole struct are checked against its declaration instead.
+template<typename Struct, auto... Members> consteval bool covers_every_member() {
+    static_assert(std::is_aggregate_v<Struct>);
+
+    constexpr size_t declared = Detail::initializer_count<Struct, 0, 1024>();
+    static_assert(declared < 1023, "the struct is too large to be counted");
+
+    return in_declaration_order<Struct, Members...>() && (Detail::element_count<Struct, Members> + ... + 0) == declared;
+}
+
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+#include <Tele/Fixed.hpp>
+#include <Tele/Kernels.hpp>
+#include <Tele/MemberOrder.hpp>
+
+namespace Tele {
+
+namespace Detail {
+
+template<auto Source, auto Target> struct QuantizedField {
+    inline static constexpr auto source = Source;
+    inline static constexpr auto target = Target;
+};
+
+template<typename T> struct IsByteRangeFloat : std::false_type { };
+template<float Min, float Max> struct IsByteRangeFloat<RangeFloat<uint8_t, Min, Max>> : std::true_type { };
+
+}
+
+/// Maps the fields of a struct of floats onto those of a struct of `Fixed`s and `RangeFloat`s.\n
+/// The types of the target fields are the precision spec, declare one through an ADL function next to the quantized
+/// struct:
+/// @code
+/// inline constexpr auto _tele_adl_quantization(QuantizedFullPacket&&) {
+///     return Tele::Quantization<FullPacket, QuantizedFullPacket> {} //
+///       .field<&FullPacket::battery_voltages, &QuantizedFullPacket::battery_voltages>()
+///       .field<&FullPacket::rpm, &QuantizedFullPacket::rpm>();
+/// }
+/// @endcode
+/// @remarks
+/// Arrays must have the same extent on both sides. Arrays of `RangeFloat<uint8_t, ...>` go through
+/// `Kernels::quantize_u8`, everything else is converted element by element.
+template<typename Source, typename Target, typename... Fields> struct Quantization {
+    using source_type = Source;
+    using target_type = Target;
+
+    /// Whether the fields map every member of `Source` onto every member of `Target`, both in declaration order.
+    inline static constexpr bool is_complete = covers_every_member<Source, Fields::source...>()
+                                            && covers_every_member<Target, Fields::target...>();
+
+    template<auto SourceMember, auto TargetMember> constexpr auto field() const {
+        return Quantization<Source, Target, Fields..., Detail::QuantizedField<SourceMember, TargetMember>> {};
+    }
+
+    static void quantize(Source const& in, Target& out) { (quantize_field<Fields>(in, out), ...); }
+
+    static void restore(Target const& in, Source& out) { (restore_field<Fields>(in, out), ...); }
+
+private:
+    template<typename Field> static void quantize_field(Source const& in, Target& out) {
+        auto const& from = in.*Field::source;
+        auto& to = out.*Field::target;
+
+        using From = std::remove_cvref_t<decltype(from)>;
+        using To = std::remove_cvref_t<decltype(to)>;
+
+        if constexpr (std::is_array_v<To>) {
+            using Element = std::remove_extent_t<To>;
+            static_assert(std::extent_v<From> == std::extent_v<To>);
+
+            if constexpr (Detail::IsByteRangeFloat<Element>::value) {
+                std::array<uint8_t, std::extent_v<To>> raw;
+                Kernels::quantize_u8(from, raw, Element::value_step, Element::min);
+
+                for (size_t i = 0; i < raw.size(); i++)
+                    to[i].data = raw[i];
+            } else {
+                for (size_t i = 0; i < std::extent_v<To>; i++)
+                    to[i] = static_cast<Element>(from[i]);
+            }
+        } else {
+            to = static_cast<To>(from);
+        }
+    }
+
+    template<typename Field> static void restore_field(Target const& in, Source& out) {
+        auto const& from = in.*Field::target;
+        auto& to = out.*Field::source;
+
+        using To = std::remove_cvref_t<decltype(to)>;
+
+        if constexpr (std::is_array_v<To>) {
+            for (size_t i = 0; i < std::extent_v<To>; i++)
+                to[i] = static_cast<std::remove_extent_t<To>>(from[i]);
+        } else {
+            to = static_cast<To>(from);
+        }
+    }
+};
+
+template<typename T>
+concept Quantized = requires(T&& v) { _tele_adl_quantization(std::move(v)); };
+
+template<Quantized T> T quantize(typename decltype(_tele_adl_quantization(T {}))::source_type const& in) {
+    T ret {};
+    decltype(_tele_adl_quantization(T {}))::quantize(in, ret);
+    return ret;
+}
+
+template<Quantized T> auto restore(T const& in) {
+    using Spec = decltype(_tele_adl_quantization(T {}));
+
+    typename Spec::source_type ret {};
+    Spec::restore(in, ret);
+    return ret;
+}
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+
+namespace Tele {
+
+/// Statically sized storage for the packets that were sent but not acknowledged yet, oldest first.
+/// @remarks
+/// This is not thread safe. Sequence IDs must increase from one `push` to the next, give the packets in the window new
+/// ones (see `for_each`) whenever they are reset.
+template<typename T, size_t Capacity>
+    requires(Capacity != 0 && requires(T const& v) {
+        { v.sequence_id } -> std::convertible_to<uint32_t>;
+    })
+struct ResendWindow {
+    inline static constexpr size_t capacity = Capacity;
+
+    constexpr size_t size() const { return m_size; }
+
+    constexpr bool empty() const { return m_size == 0; }
+
+    constexpr void clear() { m_size = 0; }
+
+    /// Evicts the oldest packet to make room if the window is full.
+    /// @return
+    /// The evicted packet, if any. Packets sparse relative to it are undecodable unless a keyframe follows.
+    constexpr std::optional<T> push(T const& value) {
+        std::optional<T> evicted = std::nullopt;
+
+        if (m_size == Capacity) {
+            evicted = std::move(at(0));
+            m_head = (m_head + 1) % Capacity;
+            m_size--;
+            m_evictions++;
+        }
+
+        at(m_size++) = value;
+
+        return evicted;
+    }
+
+    /// The number of packets `push` evicted before they were acknowledged.
+    constexpr size_t evictions() const { return m_evictions; }
+
+    constexpr size_t room() const { return Capacity - m_size; }
+
+    /// Drops the packets with sequence IDs in [first, last].
+    /// @return
+    /// The number of packets dropped.
+    constexpr size_t acknowledge(uint32_t first, uint32_t last) {
+        size_t kept = 0;
+
+        for (size_t i = 0; i < m_size; i++) {
+            const uint32_t sequence_id = at(i).sequence_id;
+            if (sequence_id >= first && sequence_id <= last)
+                continue;
+
+            if (kept != i)
+                at(kept) = std::move(at(i));
+
+            kept++;
+        }
+
+        return std::exchange(m_size, kept) - kept;
+    }
+
+    /// Copies the oldest packets into `out`, these are the ones to (re)transmit first.
+    /// @return
+    /// The number of packets copied.
+    constexpr size_t oldest(std::span<T> out) const {
+        const size_t count = std::min(m_size, out.size());
+
+        for (size_t i = 0; i < count; i++)
+            out[i] = at(i);
+
+        return count;
+    }
+
+    /// Calls `fn` with every packet, oldest first.
+    template<typename Fn>
+        requires std::invocable<Fn&, T&>
+    constexpr void for_each(Fn&& fn) {
+        for (size_t i = 0; i < m_size; i++)
+            fn(at(i));
+    }
+
+private:
+    std::array<T, Capacity> m_storage {};
+    size_t m_head = 0;
+    size_t m_size = 0;
+    size_t m_evictions = 0;
+
+    constexpr T& at(size_t i) { return m_storage[(m_head + i) % Capacity]; }
+
+    constexpr T const& at(size_t i) const { return m_storage[(m_head + i) % Capacity]; }
+};
+
+}
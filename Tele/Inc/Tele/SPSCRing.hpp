@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace Tele {
+
+/// A statically sized, lock-free ring buffer for exactly one producer and one consumer.
+/// @remarks
+/// `push` must only ever be called from one context (i.e. an ISR) and `pop` from another (i.e. a task).
+template<typename T, size_t Capacity>
+    requires(std::has_single_bit(Capacity))
+struct SPSCRing {
+    inline static constexpr size_t capacity = Capacity;
+
+    /// @remarks
+    /// This function is interrupt safe
+    /// @return
+    /// false if the ring was full, the value is discarded in that case
+    bool push(T const& value) {
+        const uint32_t head = m_head.load(std::memory_order_relaxed);
+        const uint32_t tail = m_tail.load(std::memory_order_acquire);
+
+        if (head - tail == Capacity)
+            return false;
+
+        m_storage[head % Capacity] = value;
+        m_head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /// @remarks
+    /// This function is interrupt safe
+    std::optional<T> pop() {
+        const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        const uint32_t head = m_head.load(std::memory_order_acquire);
+
+        if (head == tail)
+            return std::nullopt;
+
+        T ret = m_storage[tail % Capacity];
+        m_tail.store(tail + 1, std::memory_order_release);
+
+        return ret;
+    }
+
+    /// @remarks
+    /// The result is only a hint if called from neither the producer nor the consumer.
+    size_t size() const { return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire); }
+
+private:
+    std::atomic<uint32_t> m_head { 0 };
+    std::atomic<uint32_t> m_tail { 0 };
+
+    std::array<T, Capacity> m_storage {};
+};
+
+}
@@ -91,6 +91,29 @@ private:
     std::atomic_bool m_lock { false };
 };
 
+/// The rate of `g_high_frequency_ticks` (TIM2, 84 MHz / 16801 / 2), this is also the FreeRTOS run time counter.
+inline constexpr uint32_t k_high_frequency_tick_rate = 2500;
+
+/// @remarks
+/// This function is interrupt safe
+inline uint32_t high_frequency_ticks() { return *static_cast<volatile uint32_t*>(&g_high_frequency_ticks); }
+
+constexpr uint32_t ms_to_high_frequency_ticks(uint32_t ms) {
+    return static_cast<uint32_t>(static_cast<uint64_t>(ms) * k_high_frequency_tick_rate / 1000);
+}
+
+/// Enables the DWT cycle counter, see `cycle_count`.
+inline void enable_cycle_counter() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/// @remarks
+/// This function is interrupt safe\n
+/// The counter wraps around every ~25 seconds, only use it for short intervals.
+inline uint32_t cycle_count() { return DWT->CYCCNT; }
+
 inline bool debugger_attached() {
     return (CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk) != 0;
 }
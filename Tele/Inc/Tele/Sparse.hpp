@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include <tl/expected.hpp>
+
+#include <Tele/Binary.hpp>
+
+namespace Tele {
+
+template<BinarySchematized T> using BinarySchemaOf = decltype(_tele_adl_binary_schema(T {}));
+
+/// The fields of a `T` that changed against a previous one, bit `i` of `present` standing for the `i`th field of the
+/// `BinarySchema` of `T`.
+/// @remarks
+/// Only the present fields of `values` are meaningful, the others are left as they were in the previous `T`. The
+/// binary encodings write only the present fields, after `present` as a varint.
+template<BinarySchematized T>
+    requires(BinarySchemaOf<T>::field_count <= 32)
+struct Sparse {
+    using value_type = T;
+
+    uint32_t present = 0;
+    T values {};
+
+    /// Fields are compared by their bytes, -0.0 differs from 0.0 and NaNs equal themselves.
+    static constexpr Sparse changes(T const& previous, T const& current) {
+        Sparse ret { 0, current };
+        size_t index = 0;
+
+        BinarySchemaOf<T>::for_each_field([&]<typename Field>(Field) {
+            auto const& lhs = previous.*Field::member;
+            auto const& rhs = current.*Field::member;
+
+            if (std::memcmp(&lhs, &rhs, sizeof(lhs)) != 0)
+                ret.present |= uint32_t(1) << index;
+
+            index++;
+        });
+
+        return ret;
+    }
+
+    /// Overwrites the present fields of `state`.
+    constexpr void apply_to(T& state) const {
+        size_t index = 0;
+
+        BinarySchemaOf<T>::for_each_field([&]<typename Field>(Field) {
+            if ((present >> index++) & 1)
+                std::memcpy(&(state.*Field::member), &(values.*Field::member), sizeof(values.*Field::member));
+        });
+    }
+};
+
+template<typename Writer, typename T> constexpr void _tele_adl_binary_write(Writer& writer, Sparse<T> const& v) {
+    writer.write_varint(v.present);
+    size_t index = 0;
+
+    BinarySchemaOf<T>::for_each_field([&]<typename Field>(Field) {
+        if ((v.present >> index++) & 1)
+            writer.template write_field<Field>(v.values.*Field::member);
+    });
+}
+
+template<typename Reader, typename T>
+constexpr tl::expected<void, std::string_view> _tele_adl_binary_read(Reader& reader, Sparse<T>& v) {
+    auto present = reader.read_varint();
+    if (!present)
+        return tl::unexpected { present.error() };
+
+    if (*present >> BinarySchemaOf<T>::field_count != 0)
+        return tl::unexpected { "bad field bitmap" };
+
+    v.present = static_cast<uint32_t>(*present);
+
+    tl::expected<void, std::string_view> ret {};
+    size_t index = 0;
+
+    BinarySchemaOf<T>::for_each_field([&]<typename Field>(Field) {
+        if (ret && ((v.present >> index) & 1))
+            ret = reader.template read_field<Field>(v.values.*Field::member);
+
+        index++;
+    });
+
+    return ret;
+}
+
+}
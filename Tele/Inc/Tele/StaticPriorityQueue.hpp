@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <optional>
+
+namespace Tele {
+
+/// A statically sized binary heap, like `std::priority_queue` the element for which `Compare` holds against every
+/// other one is popped last.
+/// @remarks
+/// This is not thread safe.
+template<typename T, size_t Capacity, typename Compare = std::less<T>> struct StaticPriorityQueue {
+    inline static constexpr size_t capacity = Capacity;
+
+    constexpr size_t size() const { return m_size; }
+
+    constexpr bool empty() const { return m_size == 0; }
+
+    constexpr bool full() const { return m_size == Capacity; }
+
+    /// @return
+    /// false if the queue was full, the value is discarded in that case
+    constexpr bool push(T const& value) {
+        if (full())
+            return false;
+
+        m_storage[m_size++] = value;
+        std::push_heap(m_storage.begin(), m_storage.begin() + m_size, Compare {});
+
+        return true;
+    }
+
+    constexpr std::optional<T> pop() {
+        if (empty())
+            return std::nullopt;
+
+        std::pop_heap(m_storage.begin(), m_storage.begin() + m_size, Compare {});
+        return m_storage[--m_size];
+    }
+
+    constexpr T const* top() const { return empty() ? nullptr : &m_storage[0]; }
+
+private:
+    std::array<T, Capacity> m_storage {};
+    size_t m_size = 0;
+};
+
+}
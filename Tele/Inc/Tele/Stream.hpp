@@ -1,7 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <span>
 #include <string_view>
+#include <tuple>
+#include <utility>
 
 namespace Tele {
 
@@ -60,4 +64,112 @@ private:
     Container& m_container;
 };
 
+/// Collects writes into a fixed buffer and hands them to `Sink` as a `std::string_view` whenever the buffer fills up.
+/// @remarks
+/// Whatever is left in the buffer is only handed over by `flush`, call it once done writing.
+template<size_t Size, typename Sink> struct ChunkedStream {
+    constexpr ChunkedStream(Sink sink)
+        : m_sink(std::move(sink)) { }
+
+    template<typename Char, typename Traits>
+    constexpr ChunkedStream& operator<<(std::basic_string_view<Char, Traits> v) {
+        while (!v.empty()) {
+            const size_t amount = std::min(v.size(), Size - m_size);
+            std::copy_n(v.data(), amount, m_buffer.data() + m_size);
+
+            m_size += amount;
+            v.remove_prefix(amount);
+
+            if (m_size == Size)
+                flush();
+        }
+
+        return *this;
+    }
+
+    constexpr ChunkedStream& operator<<(const char* str) { return *this << std::string_view(str); }
+
+    constexpr ChunkedStream& operator<<(char v) {
+        m_buffer[m_size++] = v;
+
+        if (m_size == Size)
+            flush();
+
+        return *this;
+    }
+
+    constexpr void flush() {
+        if (m_size == 0)
+            return;
+
+        m_sink(std::string_view(m_buffer.data(), m_size));
+        m_size = 0;
+    }
+
+private:
+    Sink m_sink;
+
+    std::array<char, Size> m_buffer;
+    size_t m_size = 0;
+};
+
+/// Discards what is written, counting it.
+struct CountingStream {
+    template<typename Char, typename Traits>
+    constexpr CountingStream& operator<<(std::basic_string_view<Char, Traits> v) {
+        m_size += v.size();
+        return *this;
+    }
+
+    constexpr CountingStream& operator<<(const char* str) { return *this << std::string_view(str); }
+
+    constexpr CountingStream& operator<<(char) {
+        m_size++;
+        return *this;
+    }
+
+    constexpr size_t size() const { return m_size; }
+
+private:
+    size_t m_size = 0;
+};
+
+/// Forwards writes to `Stream` while feeding them to every one of `Digests`, hashing or checksumming what is serialized
+/// without a second pass over it.
+/// @remarks
+/// Digests taking a `std::string_view` like `Stf::Hash::SHA256State` are fed whole writes, others like `Stf::CRCState`
+/// are fed byte by byte. Writes to a serializer are often only a few bytes long, put a `ChunkedStream` in front to feed
+/// the digests in larger blocks.
+template<typename Stream, typename... Digests> struct DigestStream {
+    constexpr DigestStream(Stream& stream, Digests&... digests)
+        : m_stream(stream)
+        , m_digests(digests...) { }
+
+    template<typename Char, typename Traits>
+    constexpr DigestStream& operator<<(std::basic_string_view<Char, Traits> v) {
+        const std::string_view bytes { reinterpret_cast<const char*>(v.data()), v.size() * sizeof(Char) };
+        std::apply([bytes](Digests&... digests) { (update(digests, bytes), ...); }, m_digests);
+
+        m_stream << v;
+        return *this;
+    }
+
+    constexpr DigestStream& operator<<(const char* str) { return *this << std::string_view(str); }
+
+    constexpr DigestStream& operator<<(char v) { return *this << std::string_view(&v, 1); }
+
+private:
+    Stream& m_stream;
+    std::tuple<Digests&...> m_digests;
+
+    template<typename Digest> static constexpr void update(Digest& digest, std::string_view bytes) {
+        if constexpr (requires { digest.update(bytes); }) {
+            digest.update(bytes);
+        } else {
+            for (char c : bytes)
+                digest.update(static_cast<uint8_t>(c));
+        }
+    }
+};
+
 }
@@ -0,0 +1,117 @@
+#include <Tele/CANCapture.hpp>
+
+#include <Tele/CANTask.hpp>
+#include <Tele/STUtilities.hpp>
+
+namespace Tele {
+
+void CANCapture::start() {
+    m_elapsed_cycles = 0;
+    m_last_cycles = cycle_count();
+    m_last_ticks = high_frequency_ticks();
+
+    m_running.store(true, std::memory_order_release);
+}
+
+void CANCapture::clear() { m_written.store(0, std::memory_order_relaxed); }
+
+void CANCapture::isr_record(CANFrame const& frame, uint32_t timestamp) {
+    if (!running() || frame.extended)
+        return;
+
+    // the cycles since the last record are only known modulo 2^32, the ticks are off by at most one tick
+    const uint32_t ticks = high_frequency_ticks();
+    const int64_t coarse = static_cast<int64_t>(
+      static_cast<uint64_t>(ticks - m_last_ticks) * SystemCoreClock / k_high_frequency_tick_rate
+    );
+    const uint32_t fine = timestamp - m_last_cycles;
+    const uint64_t wraps = static_cast<uint64_t>(coarse - fine + (int64_t(1) << 31)) >> 32;
+
+    m_elapsed_cycles += (wraps << 32) + fine;
+    m_last_cycles = timestamp;
+    m_last_ticks = ticks;
+
+    const uint32_t written = m_written.load(std::memory_order_relaxed);
+
+    CANCaptureRecord record {
+        .timestamp = static_cast<uint32_t>(m_elapsed_cycles / (SystemCoreClock / 1'000'000)),
+        .id = static_cast<uint16_t>(frame.id),
+        .fifo = frame.fifo,
+        .length = frame.length,
+        .sequence = static_cast<uint16_t>(written),
+        .data = frame.data,
+    };
+
+    m_records[written % capacity] = record.to_bytes();
+    m_written.store(written + 1, std::memory_order_relaxed);
+}
+
+CANCaptureRecord CANCapture::record(size_t index) const {
+    const uint32_t written = m_written.load(std::memory_order_relaxed);
+    const uint32_t oldest = written - size();
+
+    return CANCaptureRecord::from_bytes(m_records[(oldest + index) % capacity]);
+}
+
+tl::expected<void, std::string_view> CANCapture::load(uint16_t version, CANCaptureRecord const& record) {
+    if (version != format_version)
+        return tl::unexpected { "the record is of another capture format version" };
+
+    const uint32_t written = m_written.load(std::memory_order_relaxed);
+
+    m_records[written % capacity] = record.to_bytes();
+    m_written.store(written + 1, std::memory_order_relaxed);
+
+    return {};
+}
+
+CANCapture::ReplayStatistics CANCapture::replay(DataCollectorTask& collector) const {
+    ReplayStatistics stats {};
+
+    const size_t count = size();
+    if (count == 0)
+        return stats;
+
+    CANDecodeState state {};
+
+    uint32_t last_timestamp = record(0).timestamp;
+    const uint32_t replay_start = cycle_count();
+
+    for (size_t i = 0; i < count; i++) {
+        const CANCaptureRecord current = record(i);
+
+        stats.frames++;
+        stats.capture_us += current.timestamp - last_timestamp;
+        last_timestamp = current.timestamp;
+
+        const CANFrame frame {
+            .id = current.id,
+            .extended = false,
+            .fifo = current.fifo,
+            .length = current.length,
+            .data = current.data,
+        };
+
+        const uint32_t decode_start = cycle_count();
+        const auto result = process_can_frame(frame, collector, state, [&stats](uint16_t) { stats.heartbeats++; });
+        const uint32_t decode_cycles = cycle_count() - decode_start;
+
+        if (!result)
+            continue;
+
+        stats.decode_cycles += decode_cycles;
+        stats.max_decode_cycles = std::max(stats.max_decode_cycles, decode_cycles);
+
+        switch (*result) {
+        case DecodeResult::Decoded: stats.decoded++; break;
+        case DecodeResult::Unknown: stats.unknown++; break;
+        case DecodeResult::Malformed: stats.malformed++; break;
+        }
+    }
+
+    stats.replay_cycles = cycle_count() - replay_start;
+
+    return stats;
+}
+
+}
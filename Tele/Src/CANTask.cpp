@@ -1,110 +1,352 @@
 #include <Tele/CANTask.hpp>
 
-#include <cstring>
-
-#include <Stuff/Maths/Bit.hpp>
+#include <algorithm>
+#include <bit>
+#include <tuple>
+#include <utility>
 
 #include <Tele/Log.hpp>
 #include <secrets.hpp>
 
 namespace Tele {
 
-void CANTask::process_can_rx(uint16_t id, std::span<uint8_t> data) {
-    /*std::string can_text = fmt::format("Received {} bytes from {:04X}: ", data.size(), id);
-    for (uint8_t b : data) {
-        fmt::format_to(std::back_inserter(can_text), "{:02X} ", b);
+void CANTask::begin_rx() {
+    // both FIFOs push into the ring, which takes only one producer at a time, see `isr_receive`
+    const auto [fifo0_irq, fifo1_irq] = m_handle.Instance == CAN1 ? std::pair { CAN1_RX0_IRQn, CAN1_RX1_IRQn }
+                                                                   : std::pair { CAN2_RX0_IRQn, CAN2_RX1_IRQn };
+
+    if (NVIC_GetPriority(fifo0_irq) != NVIC_GetPriority(fifo1_irq)) {
+        throw std::runtime_error("the CAN RX interrupts must have the same priority");
     }
-    Log::debug("{}", can_text);*/
 
-    // std::array<float, 8> temp;
-    float temp_f;
+    const uint32_t notifications = CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO0_OVERRUN //
+                                 | CAN_IT_RX_FIFO1_MSG_PENDING | CAN_IT_RX_FIFO1_OVERRUN //
+                                 | CAN_IT_ERROR | CAN_IT_ERROR_PASSIVE | CAN_IT_BUSOFF;
 
-    auto read_battery_voltages = [data](std::span<float> out) {
-        for (size_t i = 0; float& f : out) {
-            f = Stf::map<float>(data[i++], 0, 255, 2.4, 4.3);
-        }
+    if (HAL_CAN_ActivateNotification(&m_handle, notifications) != HAL_OK) {
+        throw std::runtime_error("HAL_CAN_ActivateNotification");
+    }
+}
+
+void CANTask::begin_tx() {
+    if (HAL_CAN_ActivateNotification(&m_handle, CAN_IT_TX_MAILBOX_EMPTY) != HAL_OK) {
+        throw std::runtime_error("HAL_CAN_ActivateNotification");
+    }
+}
+
+bool CANTask::transmit(uint16_t id, std::span<const uint8_t> data, bool urgent) {
+    TxEntry entry {
+        .frame = {
+            .id = id,
+            .extended = false,
+            .fifo = 0,
+            .length = static_cast<uint8_t>(std::min(data.size(), 8uz)),
+            .data {},
+        },
+        .enqueued_at = cycle_count(),
+        .sequence = 0,
+        .urgent = urgent,
     };
+    std::copy_n(data.begin(), entry.frame.length, entry.frame.data.begin());
 
-    switch (id) {
-    case static_cast<uint16_t>(CANIDs::EngineRPMTemp):
-        if (data.size() != 8)
-            break;
+    taskENTER_CRITICAL();
 
-        std::memcpy(&temp_f, data.data(), sizeof(float));
-        std::memcpy(&m_engine_temperature, data.data() + sizeof(float), sizeof(float));
+    entry.sequence = m_tx_sequence++;
+    m_tx_statistics.enqueued++;
 
-        static constexpr float diameter_mm = 288.f;
-        static constexpr float circumference_mm = diameter_mm * 2 * std::numbers::pi_v<float>;
+    const bool mailboxes_busy = HAL_CAN_GetTxMailboxesFreeLevel(&m_handle) == 0;
+    if (mailboxes_busy)
+        m_tx_statistics.mailbox_stalls++;
 
-        m_data_collector.set<float>("engine_rpm", temp_f);
-        m_data_collector.set<float>("engine_speed", (circumference_mm * temp_f) * 60.f / (1000.f * 1000.f));
+    const bool queued = m_tx_queue.push(entry);
+    if (!queued) {
+        m_tx_statistics.dropped++;
+    } else {
+        m_tx_statistics.queue_high_watermark
+          = std::max<uint32_t>(m_tx_statistics.queue_high_watermark, m_tx_queue.size());
+    }
 
-        break;
+    if (queued && urgent && mailboxes_busy) {
+        // abort the lowest priority frame that this one would otherwise wait behind, it returns through `isr_tx_done`
+        std::optional<size_t> victim = std::nullopt;
 
-        // clang-format off
-    /*case static_cast<uint16_t>(CANIDs::BMS1): if (data.size() != 8) break; read_battery_voltages({ temp.data(), 8 }); m_data_collector.set_array<float>("can_battery_voltage", {temp.data(), 8}, 0); break;
-    case static_cast<uint16_t>(CANIDs::BMS2): if (data.size() != 8) break; read_battery_voltages({ temp.data(), 8 }); m_data_collector.set_array<float>("can_battery_voltage", {temp.data(), 8}, 8); break;
-    case static_cast<uint16_t>(CANIDs::BMS3): if (data.size() != 8) break; read_battery_voltages({ temp.data(), 8 }); m_data_collector.set_array<float>("can_battery_voltage", {temp.data(), 8}, 16); break;
-    case static_cast<uint16_t>(CANIDs::BMS4): if (data.size() != 8) break; read_battery_voltages({ temp.data(), 3 }); m_data_collector.set_array<float>("can_battery_voltage", {temp.data(), 3}, 24);
+        for (size_t i = 0; i < m_tx_mailboxes.size(); i++) {
+            std::optional<TxEntry> const& pending = m_tx_mailboxes[i];
+            if (!pending || pending->urgent || pending->frame.id <= id)
+                continue;
 
-        for (size_t i = 0; auto& f : temp) {
-            f = Stf::map<float>(data[i++ + 3], 0, 255, 0, 100);
+            if (!victim || pending->frame.id > m_tx_mailboxes[*victim]->frame.id)
+                victim = i;
         }
-        m_data_collector.set_array<float>("can_battery_temp", std::span { temp.data(), 5 });
-        break;*/
-        // clang-format on
-
-    case static_cast<uint16_t>(CANIDs::BMS1):
-    case static_cast<uint16_t>(CANIDs::BMS2):
-    case static_cast<uint16_t>(CANIDs::BMS3):
-    case static_cast<uint16_t>(CANIDs::BMS4): {
-        std::array<float, 8> voltages_buffer {};
-        read_battery_voltages(voltages_buffer);
-
-        size_t bms_idx = id - static_cast<uint16_t>(CANIDs::BMS1);
-        size_t stride = bms_idx * 8;
-
-#if RACE_MODE == RACE_MODE_ELECTRO
-        static constexpr size_t cell_count = 27;
-#elif RACE_MODE == RACE_MODE_HYDRO
-        static constexpr size_t cell_count = 20;
-#endif
-
-        size_t cur_excess = (stride + 8 < cell_count) ? 0 : std::min(8uz, stride + 8 - cell_count);
-        for (size_t i = 0; i < cur_excess; i++) {
-            voltages_buffer[7 - i] = 0.f;
+
+        if (victim && HAL_CAN_AbortTxRequest(&m_handle, CAN_TX_MAILBOX0 << *victim) == HAL_OK)
+            m_tx_statistics.preemptions++;
+    }
+
+    fill_mailboxes();
+
+    taskEXIT_CRITICAL();
+
+    return queued;
+}
+
+void CANTask::isr_tx_done(size_t mailbox, bool sent) {
+    const UBaseType_t saved_interrupt_status = taskENTER_CRITICAL_FROM_ISR();
+
+    if (std::optional<TxEntry> const& entry = m_tx_mailboxes[mailbox]; entry) {
+        if (sent) {
+            const uint32_t latency = cycle_count() - entry->enqueued_at;
+
+            m_tx_statistics.sent++;
+            m_tx_statistics.bits += Detail::can_frame_bits(entry->frame.length);
+            m_tx_latency_sum += latency;
+            m_tx_statistics.max_latency_cycles = std::max(m_tx_statistics.max_latency_cycles, latency);
+
+            if (entry->urgent) {
+                m_tx_statistics.max_urgent_latency_cycles
+                  = std::max(m_tx_statistics.max_urgent_latency_cycles, latency);
+            }
+        } else {
+            requeue(*entry);
         }
+    }
 
-        m_data_collector.set_array<float>("can_battery_voltage", voltages_buffer, stride);
+    m_tx_mailboxes[mailbox] = std::nullopt;
+    fill_mailboxes();
+
+    taskEXIT_CRITICAL_FROM_ISR(saved_interrupt_status);
+}
+
+CANTask::TxStatistics CANTask::tx_statistics() const {
+    taskENTER_CRITICAL();
+
+    TxStatistics ret = m_tx_statistics;
+    ret.mean_latency_cycles = ret.sent == 0 ? 0 : static_cast<uint32_t>(m_tx_latency_sum / ret.sent);
+
+    taskEXIT_CRITICAL();
+
+    return ret;
+}
+
+void CANTask::fill_mailboxes() {
+    while (!m_tx_queue.empty() && HAL_CAN_GetTxMailboxesFreeLevel(&m_handle) != 0) {
+        const TxEntry entry = *m_tx_queue.pop();
+
+        CAN_TxHeaderTypeDef header {
+            .StdId = entry.frame.id,
+            .ExtId = 0,
+            .IDE = CAN_ID_STD,
+            .RTR = CAN_RTR_DATA,
+            .DLC = entry.frame.length,
+            .TransmitGlobalTime = DISABLE,
+        };
+
+        uint32_t mailbox_bit;
+        if (HAL_CAN_AddTxMessage(&m_handle, &header, entry.frame.data.data(), &mailbox_bit) != HAL_OK) {
+            m_tx_statistics.errors++;
+            continue;
+        }
+
+        m_tx_mailboxes[std::countr_zero(mailbox_bit)] = entry;
+    }
+}
+
+void CANTask::requeue(TxEntry const& entry) {
+    if (!m_tx_queue.push(entry))
+        m_tx_statistics.dropped++;
+}
+
+void CANTask::isr_rx_pending(uint32_t fifo) {
+    while (HAL_CAN_GetRxFifoFillLevel(&m_handle, fifo) != 0) {
+        CAN_RxHeaderTypeDef header;
+        CANFrame frame {};
+
+        if (HAL_CAN_GetRxMessage(&m_handle, fifo, &header, frame.data.data()) != HAL_OK)
+            break;
+
+        frame.extended = header.IDE == CAN_ID_EXT;
+        frame.id = frame.extended ? header.ExtId : header.StdId;
+        frame.fifo = static_cast<uint8_t>(fifo);
+        frame.length = static_cast<uint8_t>(std::min<uint32_t>(header.DLC, 8));
+
+        m_capture.isr_record(frame, cycle_count());
+        isr_count_frame(frame);
+        std::ignore = isr_receive(frame);
+    }
 
-        if (id == static_cast<uint16_t>(CANIDs::BMS4)) {
-            std::array<float, 5> temperatures {};
-            for (size_t i = 0; auto& f : temperatures) {
-                f = Stf::map<float>(data[i++ + 3], 0, 255, 0, 100);
+    isr_notify();
+}
+
+void CANTask::isr_error(uint32_t error_code) {
+    if ((error_code & (HAL_CAN_ERROR_RX_FOV0 | HAL_CAN_ERROR_RX_FOV1)) != 0) {
+        m_rx_fifo_overruns.store(
+          m_rx_fifo_overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed
+        );
+    }
+
+    // the error interrupt fires as the controller enters either state, being bus-off implies being error passive
+    if ((error_code & HAL_CAN_ERROR_BOF) != 0) {
+        m_bus_off_events.store(m_bus_off_events.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    } else if ((error_code & HAL_CAN_ERROR_EPV) != 0) {
+        m_error_passive_events.store(
+          m_error_passive_events.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed
+        );
+    }
+
+    static constexpr std::array<std::pair<uint32_t, uint32_t>, 3> tx_errors { {
+      { HAL_CAN_ERROR_TX_ALST0, HAL_CAN_ERROR_TX_TERR0 },
+      { HAL_CAN_ERROR_TX_ALST1, HAL_CAN_ERROR_TX_TERR1 },
+      { HAL_CAN_ERROR_TX_ALST2, HAL_CAN_ERROR_TX_TERR2 },
+    } };
+
+    const bool tx_failed = std::ranges::any_of(tx_errors, [error_code](auto bits) {
+        return (error_code & (bits.first | bits.second)) != 0;
+    });
+
+    if (tx_failed) {
+        const UBaseType_t saved_interrupt_status = taskENTER_CRITICAL_FROM_ISR();
+
+        for (size_t i = 0; i < tx_errors.size(); i++) {
+            const auto [arbitration_lost, transmission_error] = tx_errors[i];
+            std::optional<TxEntry>& entry = m_tx_mailboxes[i];
+
+            if ((error_code & (arbitration_lost | transmission_error)) == 0 || !entry)
+                continue;
+
+            if ((error_code & arbitration_lost) != 0) {
+                m_tx_statistics.arbitration_losses++;
+                requeue(*entry);
+            } else {
+                m_tx_statistics.errors++;
             }
-            m_data_collector.set_array<float>("can_battery_temp", temperatures);
+
+            entry = std::nullopt;
         }
+
+        fill_mailboxes();
+
+        taskEXIT_CRITICAL_FROM_ISR(saved_interrupt_status);
+    }
+
+    // the HAL accumulates the error code until it is reset, which would count the same error again next time
+    HAL_CAN_ResetError(&m_handle);
+}
+
+void CANTask::isr_count_frame(CANFrame const& frame) {
+    m_rx_bits.store(
+      m_rx_bits.load(std::memory_order_relaxed) + Detail::can_frame_bits(frame.length), std::memory_order_relaxed
+    );
+
+    if (frame.extended)
+        return;
+
+    const auto it = std::ranges::find(k_can_rx_ids, static_cast<uint16_t>(frame.id));
+    if (it == k_can_rx_ids.end())
+        return;
+
+    std::atomic<uint32_t>& count = m_rx_id_frames[std::distance(k_can_rx_ids.begin(), it)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+bool CANTask::isr_receive(CANFrame const& frame) {
+    /*
+     * The FIFO 0 and FIFO 1 interrupts both get here. They have the same priority (`begin_rx` checks), so neither can
+     * preempt the other and the ring only ever sees one producer at a time.
+     */
+    if (!m_rx_ring.push(frame)) {
+        m_rx_dropped.store(m_rx_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    m_rx_received.store(m_rx_received.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    const uint32_t fill = m_rx_ring.size();
+    if (fill > m_rx_high_watermark.load(std::memory_order_relaxed))
+        m_rx_high_watermark.store(fill, std::memory_order_relaxed);
+
+    return true;
+}
+
+void CANTask::isr_notify() {
+    BaseType_t higher_prio_task_awoken = pdFALSE;
+    vTaskNotifyGiveFromISR(handle(), &higher_prio_task_awoken);
+    portYIELD_FROM_ISR(higher_prio_task_awoken);
+}
+
+uint32_t CANTask::bitrate() const {
+    if (m_handle.Init.Prescaler == 0)
+        return 0;
+
+    const uint32_t bs1 = ((m_handle.Init.TimeSeg1 & CAN_BTR_TS1_Msk) >> CAN_BTR_TS1_Pos) + 1;
+    const uint32_t bs2 = ((m_handle.Init.TimeSeg2 & CAN_BTR_TS2_Msk) >> CAN_BTR_TS2_Pos) + 1;
+
+    return HAL_RCC_GetPCLK1Freq() / (m_handle.Init.Prescaler * (1 + bs1 + bs2));
+}
+
+void CANTask::roll_statistics() {
+    const uint32_t now = HAL_GetTick();
+    const uint32_t elapsed = now - m_window_start;
+    m_window_start = now;
+
+    auto per_second = [elapsed](uint32_t count) {
+        return static_cast<uint32_t>(static_cast<uint64_t>(count) * 1000 / elapsed);
+    };
+
+    const RxStatistics rx = rx_statistics();
+    const TxStatistics tx = tx_statistics();
+    const uint32_t esr = m_handle.Instance->ESR;
+
+    const uint32_t rx_frames = rx.received + rx.dropped;
+    const uint32_t rx_bits = m_rx_bits.load(std::memory_order_relaxed);
+
+    std::array<uint32_t, k_can_rx_ids.size()> id_rates;
+    for (size_t i = 0; i < id_rates.size(); i++) {
+        const uint32_t frames = m_rx_id_frames[i].load(std::memory_order_relaxed);
+        id_rates[i] = per_second(frames - m_window_id_frames[i]);
+        m_window_id_frames[i] = frames;
     }
 
-    case static_cast<uint16_t>(CANIDs::BMS5): {
-        uint16_t raw_mah = Stf::convert_endian(*reinterpret_cast<const uint16_t*>(data.data()), std::endian::big);
-        uint16_t raw_mwh = Stf::convert_endian(*reinterpret_cast<const uint16_t*>(data.data() + 2), std::endian::big);
-        uint16_t raw_current
-          = Stf::convert_endian(*reinterpret_cast<const uint16_t*>(data.data() + 4), std::endian::big);
-        uint16_t raw_percent
-          = Stf::convert_endian(*reinterpret_cast<const uint16_t*>(data.data() + 6), std::endian::big);
-        m_data_collector.set<float>("can_spent_mah", Stf::map<float>(raw_mah, 0, 65535, 0, 15000));
-        m_data_collector.set<float>("can_spent_mwh", Stf::map<float>(raw_mwh, 0, 65535, 0, 15000 * 256));
-        m_data_collector.set<float>("can_current", Stf::map<float>(raw_current, 0, 65535, -10, 50));
-        m_data_collector.set<float>("can_soc_percent", Stf::map<float>(raw_percent, 0, 65535, -5, 105));
-    } break;
-
-    case static_cast<uint16_t>(CANIDs::Hydrogen): {
-        m_data_collector.set<float>("can_hydro_ppm", data[0]);
-        m_data_collector.set<float>("can_hydro_temp", data[1]);
+    const uint64_t window_bits = static_cast<uint64_t>(rx_bits - m_window_rx_bits) + (tx.bits - m_window_tx_bits);
+    const uint32_t bits_per_second = bitrate();
+    float bus_load = 0.f;
+    if (bits_per_second != 0) {
+        bus_load = static_cast<float>(window_bits) * 100.f * 1000.f
+                 / (static_cast<float>(bits_per_second) * static_cast<float>(elapsed));
     }
 
-    default: break;
+    const CANErrorState error_state = error_state_of(esr);
+
+    const uint32_t staging_discards
+      = std::apply([](auto const&... blocks) { return (blocks.discarded + ... + 0u); }, m_decode_state);
+
+    m_data_collector.publish([&](DataCollectorTask::Writer& writer) {
+        writer.set(Channels::can_rx_frames_per_second, per_second(rx_frames - m_window_rx_frames));
+        writer.set(Channels::can_tx_frames_per_second, per_second(tx.sent - m_window_tx_sent));
+        writer.set_array<uint32_t>(Channels::can_id_frames_per_second, id_rates);
+        writer.set(Channels::can_bus_load_percent, bus_load);
+        writer.set(Channels::can_tec, (esr & CAN_ESR_TEC_Msk) >> CAN_ESR_TEC_Pos);
+        writer.set(Channels::can_rec, (esr & CAN_ESR_REC_Msk) >> CAN_ESR_REC_Pos);
+        writer.set(Channels::can_error_state, static_cast<uint32_t>(error_state));
+        writer.set(Channels::can_bus_off_count, m_bus_off_events.load(std::memory_order_relaxed));
+        writer.set(Channels::can_error_passive_count, m_error_passive_events.load(std::memory_order_relaxed));
+        writer.set(Channels::can_fifo_overruns, rx.fifo_overruns);
+        writer.set(Channels::can_rx_dropped, rx.dropped);
+        writer.set(Channels::can_tx_dropped, tx.dropped);
+        writer.set(Channels::can_decode_failures, m_decode_failures);
+        writer.set(Channels::can_unknown_frames, m_unknown_frames);
+        writer.set(Channels::can_staging_discards, staging_discards);
+    });
+
+    m_window_rx_frames = rx_frames;
+    m_window_rx_bits = rx_bits;
+    m_window_tx_sent = tx.sent;
+    m_window_tx_bits = tx.bits;
+
+    // with automatic bus-off management disabled, the controller stays off the bus until it is restarted
+    if (error_state == CANErrorState::BusOff) {
+        Log::warn("CAN controller is bus-off, restarting it");
+        std::ignore = HAL_CAN_Stop(&m_handle);
+        std::ignore = HAL_CAN_Start(&m_handle);
     }
 }
 
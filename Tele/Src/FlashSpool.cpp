@@ -0,0 +1,432 @@
+#include <Tele/FlashSpool.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include <Stuff/Maths/Check/CRC.hpp>
+
+namespace Tele {
+
+template<typename T> static T load_le(uint8_t const* data) {
+    T ret;
+    std::memcpy(&ret, data, sizeof(T));
+    return ret;
+}
+
+template<typename T> static void store_le(uint8_t* data, T value) { std::memcpy(data, &value, sizeof(T)); }
+
+FlashSpool::FlashSpool(FlashDevice& flash)
+    : m_flash(flash) {}
+
+size_t FlashSpool::max_payload_size() const {
+    return std::min<size_t>(m_flash.sector_size() - sector_header_size - record_header_size, UINT16_MAX - 1);
+}
+
+auto FlashSpool::read_sector_header(size_t sector) const -> SectorHeader {
+    std::array<uint8_t, sector_header_size> bytes;
+    m_flash.read(address(sector, 0), bytes);
+
+    return {
+        .valid = load_le<uint32_t>(bytes.data() + 12) == sector_magic,
+        .erase_count = load_le<uint32_t>(bytes.data()),
+        .sequence = load_le<uint32_t>(bytes.data() + 4),
+    };
+}
+
+auto FlashSpool::read_record(size_t sector, size_t offset) const -> Record {
+    std::array<uint8_t, record_header_size> bytes;
+    m_flash.read(address(sector, offset), bytes);
+
+    return {
+        .length = load_le<uint16_t>(bytes.data()),
+        .committed = bytes[2] == 0x00,
+        // a consumption cut short reads as consumed, replaying the record would be just as fine
+        .consumed = bytes[3] != 0xFF,
+        .crc = load_le<uint32_t>(bytes.data() + 4),
+    };
+}
+
+auto FlashSpool::scan_record(size_t sector, size_t offset, Record& out) const -> ScanResult {
+    const size_t sector_size = m_flash.sector_size();
+
+    if (offset + record_header_size > sector_size)
+        return ScanResult::End;
+
+    std::array<uint8_t, record_header_size> bytes;
+    m_flash.read(address(sector, offset), bytes);
+
+    if (std::ranges::all_of(bytes, [](uint8_t b) { return b == 0xFF; }))
+        return ScanResult::End;
+
+    out = read_record(sector, offset);
+
+    if (!out.committed || out.length > max_payload_size() || offset + record_span(out.length) > sector_size)
+        return ScanResult::Broken;
+
+    Stf::CRCState<Stf::CRCDescriptions::CRC32ISOHDLC, false> crc_state {};
+    crc_state.update(static_cast<uint8_t>(out.length));
+    crc_state.update(static_cast<uint8_t>(out.length >> 8));
+
+    std::array<uint8_t, 32> chunk;
+    for (size_t i = 0; i < out.length; i += chunk.size()) {
+        const auto part = std::span(chunk).first(std::min<size_t>(chunk.size(), out.length - i));
+        m_flash.read(address(sector, offset + record_header_size + i), part);
+
+        for (uint8_t b : part)
+            crc_state.update(b);
+    }
+
+    if (crc_state.finished_value() != out.crc)
+        return ScanResult::Broken;
+
+    return ScanResult::Record;
+}
+
+size_t FlashSpool::count_pending(size_t sector, size_t& end) const {
+    size_t count = 0;
+
+    for (size_t offset = sector_header_size;;) {
+        Record record;
+
+        switch (scan_record(sector, offset, record)) {
+        case ScanResult::Record:
+            count += record.consumed ? 0 : 1;
+            offset += record_span(record.length);
+            break;
+        case ScanResult::End:
+            end = offset;
+            return count;
+        case ScanResult::Broken:
+            end = m_flash.sector_size();
+            return count;
+        }
+    }
+}
+
+bool FlashSpool::find_pending(size_t& sector, size_t& offset) const {
+    for (size_t steps = 0; steps <= m_flash.sector_count(); steps++) {
+        if (read_sector_header(sector).valid) {
+            for (Record record; scan_record(sector, offset, record) == ScanResult::Record;) {
+                if (!record.consumed)
+                    return true;
+
+                offset += record_span(record.length);
+            }
+        }
+
+        if (sector == m_head_sector)
+            break;
+
+        sector = next_sector(sector);
+        offset = sector_header_size;
+    }
+
+    return false;
+}
+
+void FlashSpool::seek_tail(size_t sector, size_t offset) {
+    if (find_pending(sector, offset)) {
+        m_tail_sector = sector;
+        m_tail_offset = offset;
+        return;
+    }
+
+    m_pending = 0;
+    m_read_ahead = 0;
+}
+
+size_t FlashSpool::recover() {
+    m_head_sector = no_sector;
+    m_head_sequence = 0;
+    m_head_offset = 0;
+    m_read_ahead = 0;
+    m_oldest_ticket = 0;
+    m_prepared_sector = no_sector;
+    m_pending = 0;
+
+    for (size_t sector = 0; sector < m_flash.sector_count(); sector++) {
+        const auto header = read_sector_header(sector);
+        if (!header.valid || (m_head_sector != no_sector && header.sequence <= m_head_sequence))
+            continue;
+
+        m_head_sector = sector;
+        m_head_sequence = header.sequence;
+    }
+
+    if (m_head_sector == no_sector)
+        return 0;
+
+    // sectors are started round robin, the oldest one comes right after the newest
+    for (size_t sector = next_sector(m_head_sector);; sector = next_sector(sector)) {
+        if (read_sector_header(sector).valid) {
+            size_t end;
+            m_pending += count_pending(sector, end);
+
+            if (sector == m_head_sector)
+                m_head_offset = end;
+        }
+
+        if (sector == m_head_sector)
+            break;
+    }
+
+    if (m_pending != 0)
+        seek_tail(next_sector(m_head_sector), sector_header_size);
+
+    return m_pending;
+}
+
+bool FlashSpool::is_prepared(size_t sector, uint32_t& erase_count) const {
+    const size_t sector_size = m_flash.sector_size();
+
+    std::array<uint8_t, 64> chunk;
+    for (size_t offset = 0; offset < sector_size; offset += chunk.size()) {
+        const auto part = std::span(chunk).first(std::min<size_t>(chunk.size(), sector_size - offset));
+        m_flash.read(address(sector, offset), part);
+
+        const auto erased = offset == 0 ? part.subspan(4) : part;
+        if (!std::ranges::all_of(erased, [](uint8_t b) { return b == 0xFF; }))
+            return false;
+
+        if (offset == 0)
+            erase_count = load_le<uint32_t>(part.data());
+    }
+
+    return true;
+}
+
+tl::expected<bool, std::string_view> FlashSpool::prepare() {
+    const size_t sector = m_head_sector == no_sector ? 0 : next_sector(m_head_sector);
+    if (sector == m_prepared_sector || sector == m_head_sector)
+        return false;
+
+    // the sector after the newest one is the oldest one, it holds pending records only if the oldest of those is in it
+    if (m_pending != 0 && m_tail_sector == sector)
+        return false;
+
+    // prepared before a reset, or blank
+    if (uint32_t erase_count; is_prepared(sector, erase_count)) {
+        m_prepared_sector = sector;
+        return false;
+    }
+
+    const auto header = read_sector_header(sector);
+
+    if (auto res = m_flash.erase(sector); !res)
+        return tl::unexpected { res.error() };
+
+    std::array<uint8_t, 4> counter;
+    store_le<uint32_t>(counter.data(), header.valid ? header.erase_count + 1 : 1);
+
+    if (auto res = m_flash.program(address(sector, 0), counter); !res)
+        return tl::unexpected { res.error() };
+
+    m_prepared_sector = sector;
+
+    return true;
+}
+
+tl::expected<void, std::string_view> FlashSpool::rotate() {
+    const size_t sector = m_head_sector == no_sector ? 0 : next_sector(m_head_sector);
+    m_prepared_sector = no_sector;
+
+    // a blank sector reads as prepared with an unknown erase count
+    uint32_t erase_count = UINT32_MAX;
+    const bool prepared = is_prepared(sector, erase_count);
+    const bool count_programmed = prepared && erase_count != UINT32_MAX;
+
+    size_t dropped = 0;
+
+    if (!prepared) {
+        const auto header = read_sector_header(sector);
+
+        if (header.valid) {
+            size_t end;
+            dropped = count_pending(sector, end);
+        }
+
+        if (auto res = m_flash.erase(sector); !res)
+            return tl::unexpected { res.error() };
+
+        erase_count = header.valid ? header.erase_count + 1 : 1;
+    } else if (!count_programmed) {
+        erase_count = 1;
+    }
+
+    m_pending -= dropped;
+    m_dropped += dropped;
+    m_oldest_ticket += dropped;
+    m_read_ahead -= std::min(m_read_ahead, dropped);
+
+    m_head_sequence = m_head_sector == no_sector ? 1 : m_head_sequence + 1;
+    m_head_sector = sector;
+    // appending stays off until the header is in place
+    m_head_offset = m_flash.sector_size();
+
+    if (dropped != 0 && m_pending != 0)
+        seek_tail(next_sector(sector), sector_header_size);
+
+    std::array<uint8_t, 8> counters;
+    store_le<uint32_t>(counters.data(), erase_count);
+    store_le<uint32_t>(counters.data() + 4, m_head_sequence);
+
+    std::array<uint8_t, 4> magic;
+    store_le<uint32_t>(magic.data(), sector_magic);
+
+    // the erase count of a prepared sector is programmed already
+    const auto unprogrammed = std::span<const uint8_t>(counters).subspan(count_programmed ? 4 : 0);
+    if (auto res = m_flash.program(address(sector, 8 - unprogrammed.size()), unprogrammed); !res)
+        return tl::unexpected { res.error() };
+
+    if (auto res = m_flash.program(address(sector, 12), magic); !res)
+        return tl::unexpected { res.error() };
+
+    m_head_offset = sector_header_size;
+
+    return {};
+}
+
+tl::expected<void, std::string_view> FlashSpool::append(std::span<const uint8_t> payload) {
+    if (payload.size() > max_payload_size())
+        return tl::unexpected { "record too large" };
+
+    const size_t span = record_span(payload.size());
+
+    if (m_head_sector == no_sector || m_head_offset + span > m_flash.sector_size()) {
+        if (auto res = rotate(); !res)
+            return tl::unexpected { res.error() };
+    }
+
+    const size_t offset = m_head_offset;
+    const size_t base = address(m_head_sector, offset);
+
+    Stf::CRCState<Stf::CRCDescriptions::CRC32ISOHDLC, false> crc_state {};
+    crc_state.update(static_cast<uint8_t>(payload.size()));
+    crc_state.update(static_cast<uint8_t>(payload.size() >> 8));
+    for (uint8_t b : payload)
+        crc_state.update(b);
+
+    std::array<uint8_t, 2> length;
+    store_le<uint16_t>(length.data(), static_cast<uint16_t>(payload.size()));
+
+    std::array<uint8_t, 4> crc;
+    store_le<uint32_t>(crc.data(), crc_state.finished_value());
+
+    const std::array<uint8_t, 1> committed { 0x00 };
+
+    // whatever is programmed from here on takes up the space, a failure leaves the rest of the sector alone
+    m_head_offset = m_flash.sector_size();
+
+    if (auto res = m_flash.program(base, length); !res)
+        return tl::unexpected { res.error() };
+
+    if (auto res = m_flash.program(base + 4, crc); !res)
+        return tl::unexpected { res.error() };
+
+    if (auto res = m_flash.program(base + record_header_size, payload); !res)
+        return tl::unexpected { res.error() };
+
+    if (auto res = m_flash.program(base + 2, committed); !res)
+        return tl::unexpected { res.error() };
+
+    m_head_offset = offset + span;
+
+    if (m_pending++ == 0) {
+        m_tail_sector = m_head_sector;
+        m_tail_offset = offset;
+    }
+
+    m_appended++;
+
+    return {};
+}
+
+tl::expected<size_t, std::string_view> FlashSpool::peek(std::span<uint8_t> out) const {
+    if (m_pending == 0)
+        return 0;
+
+    const auto record = read_record(m_tail_sector, m_tail_offset);
+    if (out.size() < record.length)
+        return tl::unexpected { "buffer too small" };
+
+    m_flash.read(address(m_tail_sector, m_tail_offset + record_header_size), out.first(record.length));
+
+    return record.length;
+}
+
+tl::expected<size_t, std::string_view> FlashSpool::read(std::span<uint8_t> out, uint32_t& ticket) {
+    if (unread() == 0)
+        return 0;
+
+    size_t sector = m_tail_sector;
+    size_t offset = m_tail_offset;
+
+    if (m_read_ahead != 0) {
+        sector = m_read_sector;
+        offset = m_read_offset;
+
+        if (!find_pending(sector, offset))
+            return tl::unexpected { "lost track of the records read" };
+    }
+
+    const auto record = read_record(sector, offset);
+    if (out.size() < record.length)
+        return tl::unexpected { "buffer too small" };
+
+    m_flash.read(address(sector, offset + record_header_size), out.first(record.length));
+
+    ticket = m_oldest_ticket + static_cast<uint32_t>(m_read_ahead++);
+    m_read_sector = sector;
+    m_read_offset = offset + record_span(record.length);
+
+    return record.length;
+}
+
+tl::expected<void, std::string_view> FlashSpool::pop() {
+    if (m_pending == 0)
+        return tl::unexpected { "spool is empty" };
+
+    const std::array<uint8_t, 1> consumed { 0x00 };
+    if (auto res = m_flash.program(address(m_tail_sector, m_tail_offset + 3), consumed); !res)
+        return tl::unexpected { res.error() };
+
+    m_consumed++;
+    m_oldest_ticket++;
+    m_read_ahead -= std::min<size_t>(m_read_ahead, 1);
+
+    if (--m_pending != 0) {
+        const auto record = read_record(m_tail_sector, m_tail_offset);
+        seek_tail(m_tail_sector, m_tail_offset + record_span(record.length));
+    }
+
+    return {};
+}
+
+tl::expected<void, std::string_view> FlashSpool::discard() {
+    while (m_pending != 0) {
+        if (auto res = pop(); !res)
+            return tl::unexpected { res.error() };
+    }
+
+    return {};
+}
+
+auto FlashSpool::statistics() const -> Statistics {
+    uint32_t max_erase_count = 0;
+
+    for (size_t sector = 0; sector < m_flash.sector_count(); sector++) {
+        if (const auto header = read_sector_header(sector); header.valid)
+            max_erase_count = std::max(max_erase_count, header.erase_count);
+    }
+
+    return {
+        .pending = m_pending,
+        .appended = m_appended,
+        .consumed = m_consumed,
+        .dropped = m_dropped,
+        .max_erase_count = max_erase_count,
+    };
+}
+
+}
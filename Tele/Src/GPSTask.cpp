@@ -39,8 +39,10 @@ void GPSTask::operator()() {
 
         Stf::MultiVisitor visitor {
             [this](NMEA::GGAMessage const& message) {
-                m_data_collector.set<float>("gps_latitude", message.latitude);
-                m_data_collector.set<float>("gps_longitude", message.longitude);
+                m_data_collector.publish([&message](DataCollectorTask::Writer& writer) {
+                    writer.set(Channels::gps_latitude, message.latitude);
+                    writer.set(Channels::gps_longitude, message.longitude);
+                });
                 Log::debug("GPS @ {}, {}", message.latitude, message.longitude);
             },
             [](auto const&) { Log::debug("received unprocessed GPS message"); },
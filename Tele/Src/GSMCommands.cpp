@@ -199,6 +199,14 @@ tl::expected<reply_type, std::string_view> parse_reply(std::string_view line) {
         return ResetSuccess { prng_vector };
     }
 
+    if (auto [res, first, last] = scn::scan_tuple<uint32_t, uint32_t>(line, "+CST_ACK {},{}"); res) {
+        if (first > last) {
+            return tl::unexpected { "bad ack range" };
+        }
+
+        return PacketAck { first, last };
+    }
+
     return tl::unexpected { "line did not match any known replies" };
 
 #undef TRY_PARSE
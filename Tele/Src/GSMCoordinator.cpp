@@ -208,7 +208,10 @@ struct CoordinatorQueueHelper {
             Command::HTTPData& http_data = std::get<Command::HTTPData>(active_command->command);
             Log::debug("since the active command is HTTPDATA, sending additional data...");
 
-            coordinator.m_transmit_task.transmit(http_data.data);
+            if (http_data.body_writer != nullptr)
+                http_data.body_writer->write(coordinator.m_transmit_task);
+            else
+                coordinator.m_transmit_task.transmit(http_data.data);
         }
 
         if (!solicited) {
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <Tele/Flash.hpp>
+
+namespace Tele {
+
+/// A `FlashDevice` kept in a file, what is programmed outlives the process as it would a reset.
+/// @remarks
+/// The file is created erased if it doesn't exist. Programming a byte that isn't erased is an error, as is everything
+/// out of bounds.
+struct FileFlash final : FlashDevice {
+    FileFlash(std::string const& path, size_t sector_size, size_t sector_count)
+        : m_sector_size(sector_size)
+        , m_sector_count(sector_count) {
+        m_file = std::fopen(path.c_str(), "r+b");
+
+        if (m_file == nullptr) {
+            m_file = std::fopen(path.c_str(), "w+b");
+
+            const std::vector<uint8_t> erased(size(), 0xFF);
+            std::fwrite(erased.data(), 1, erased.size(), m_file);
+            std::fflush(m_file);
+        }
+    }
+
+    FileFlash(FileFlash const&) = delete;
+    FileFlash(FileFlash&&) = delete;
+
+    ~FileFlash() override {
+        if (m_file != nullptr)
+            std::fclose(m_file);
+    }
+
+    bool is_open() const { return m_file != nullptr; }
+
+    size_t sector_size() const override { return m_sector_size; }
+
+    size_t sector_count() const override { return m_sector_count; }
+
+    tl::expected<void, std::string_view> erase(size_t sector) override {
+        if (sector >= m_sector_count)
+            return tl::unexpected { "sector out of bounds" };
+
+        const std::vector<uint8_t> erased(m_sector_size, 0xFF);
+        return write(sector * m_sector_size, erased);
+    }
+
+    tl::expected<void, std::string_view> program(size_t offset, std::span<const uint8_t> data) override {
+        if (offset + data.size() > size())
+            return tl::unexpected { "program out of bounds" };
+
+        std::vector<uint8_t> current(data.size());
+        read(offset, current);
+
+        if (std::ranges::any_of(current, [](uint8_t b) { return b != 0xFF; }))
+            return tl::unexpected { "programming a byte that isn't erased" };
+
+        return write(offset, data);
+    }
+
+    void read(size_t offset, std::span<uint8_t> out) const override {
+        std::fseek(m_file, static_cast<long>(offset), SEEK_SET);
+        if (std::fread(out.data(), 1, out.size(), m_file) != out.size())
+            std::ranges::fill(out, 0xFF);
+    }
+
+private:
+    size_t m_sector_size;
+    size_t m_sector_count;
+    std::FILE* m_file = nullptr;
+
+    tl::expected<void, std::string_view> write(size_t offset, std::span<const uint8_t> data) {
+        std::fseek(m_file, static_cast<long>(offset), SEEK_SET);
+        if (std::fwrite(data.data(), 1, data.size(), m_file) != data.size())
+            return tl::unexpected { "write failed" };
+
+        std::fflush(m_file);
+        return {};
+    }
+};
+
+}
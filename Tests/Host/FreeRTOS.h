@@ -0,0 +1,45 @@
+#pragma once
+
+// Host stand-ins for the FreeRTOS declarations the firmware headers reach. The host tests don't run the scheduler,
+// only what they call is defined, see Host.cpp.
+
+#include <cstddef>
+#include <cstdint>
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t StackType_t;
+
+typedef void* TaskHandle_t;
+typedef void* QueueHandle_t;
+typedef void* SemaphoreHandle_t;
+typedef void* EventGroupHandle_t;
+
+struct StaticTask_t { };
+struct StaticQueue_t { };
+struct StaticSemaphore_t { };
+struct StaticEventGroup_t { };
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFF'FFFFu
+#define configTICK_RATE_HZ 1000
+#define pdMS_TO_TICKS(ms) (static_cast<TickType_t>(ms))
+#define tskIDLE_PRIORITY 0
+
+#define taskYIELD()
+#define portYIELD_FROM_ISR(woken) static_cast<void>(woken)
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+#define taskENTER_CRITICAL_FROM_ISR() 0u
+#define taskEXIT_CRITICAL_FROM_ISR(saved) static_cast<void>(saved)
+
+struct HeapStats_t {
+    size_t xAvailableHeapSpaceInBytes;
+    size_t xNumberOfSuccessfulAllocations;
+    size_t xNumberOfSuccessfulFrees;
+};
+
+void vPortGetHeapStats(HeapStats_t* stats);
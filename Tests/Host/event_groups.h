@@ -0,0 +1,8 @@
+#pragma once
+
+#include <FreeRTOS.h>
+
+typedef uint32_t EventBits_t;
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t group, EventBits_t bits, BaseType_t* woken);
@@ -0,0 +1,31 @@
+#pragma once
+
+// Host stand-ins for the HAL and CMSIS declarations the firmware headers reach, see FreeRTOS.h.
+
+#include <cstdint>
+
+extern "C" {
+
+uint32_t HAL_GetTick(void);
+
+void Error_Handler(void);
+
+extern uint32_t g_high_frequency_ticks;
+
+struct CoreDebug_Type {
+    volatile uint32_t DHCSR;
+    volatile uint32_t DEMCR;
+};
+
+struct DWT_Type {
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+};
+
+extern CoreDebug_Type* CoreDebug;
+extern DWT_Type* DWT;
+}
+
+#define CoreDebug_DHCSR_C_DEBUGEN_Msk (1u << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1u << 24)
+#define DWT_CTRL_CYCCNTENA_Msk (1u << 0)
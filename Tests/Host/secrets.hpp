@@ -0,0 +1,10 @@
+#pragma once
+
+#include <secrets.example.hpp>
+
+#define RACE_MODE_ELECTRO 0
+#define RACE_MODE_HYDRO 1
+
+#ifndef RACE_MODE
+#define RACE_MODE RACE_MODE_ELECTRO
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <FreeRTOS.h>
+
+enum eNotifyAction { eNoAction, eSetBits, eIncrement, eSetValueWithOverwrite, eSetValueWithoutOverwrite };
+
+struct TaskStatus_t {
+    TaskHandle_t xHandle;
+    const char* pcTaskName;
+    UBaseType_t xTaskNumber;
+    uint32_t ulRunTimeCounter;
+    uint16_t usStackHighWaterMark;
+};
+
+BaseType_t xTaskCreate(
+  void (*fn)(void*), const char* name, uint32_t stack_depth, void* arg, UBaseType_t priority, TaskHandle_t* handle
+);
+
+TaskHandle_t xTaskCreateStatic(
+  void (*fn)(void*), const char* name, uint32_t stack_depth, void* arg, UBaseType_t priority, StackType_t* stack,
+  StaticTask_t* task
+);
+
+TaskHandle_t xTaskGetCurrentTaskHandle();
+TickType_t xTaskGetTickCount();
+TickType_t xTaskGetTickCountFromISR();
+void vTaskDelay(TickType_t ticks);
+
+void vTaskSuspendAll();
+BaseType_t xTaskResumeAll();
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t* woken);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks);
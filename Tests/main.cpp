@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <span>
+#include <string_view>
+#include <utility>
+
+#include <FileFlash.hpp>
+#include <tests.hpp>
+
+#include <Tele/FlashSpool.hpp>
+
+namespace Tele {
+
+/// The spool keeps its records across the process starting over, as it does across a reset on the target.
+static bool file_flash_spool_test() {
+    static constexpr char path[] = "file_flash_spool.bin";
+    std::remove(path);
+
+    bool ok = true;
+
+    auto record = [](uint32_t id) {
+        std::array<uint8_t, 16> bytes;
+        for (size_t i = 0; i < bytes.size(); i++)
+            bytes[i] = static_cast<uint8_t>(id * 7 + i);
+
+        return bytes;
+    };
+
+    {
+        FileFlash flash { path, 256, 4 };
+        FlashSpool spool { flash };
+
+        ok &= flash.is_open() && spool.recover() == 0;
+
+        for (uint32_t id = 0; id < 25; id++)
+            ok &= spool.append(record(id)).has_value();
+
+        ok &= spool.pop().has_value();
+    }
+
+    {
+        FileFlash flash { path, 256, 4 };
+        FlashSpool spool { flash };
+
+        ok &= spool.recover() == 24;
+
+        for (uint32_t id = 1; id < 25; id++) {
+            std::array<uint8_t, 32> buffer;
+            const auto length = spool.peek(buffer);
+
+            ok &= length && *length == 16 && std::ranges::equal(std::span(buffer).first(16), record(id));
+            ok &= spool.pop().has_value();
+        }
+
+        ok &= spool.pending() == 0;
+    }
+
+    {
+        FileFlash flash { path, 256, 4 };
+        FlashSpool spool { flash };
+
+        ok &= spool.recover() == 0;
+    }
+
+    std::remove(path);
+
+    return ok;
+}
+
+}
+
+int main(int argc, char** argv) {
+    static constexpr std::pair<std::string_view, bool (*)()> tests[] {
+        { "kernels_test", Tele::kernels_test },
+        { "binary_encoding_test", Tele::binary_encoding_test },
+        { "quantization_test", Tele::quantization_test },
+        { "columnar_encoding_test", Tele::columnar_encoding_test },
+        { "sparse_packet_test", Tele::sparse_packet_test },
+        { "common_mode_test", Tele::common_mode_test },
+        { "resend_window_test", Tele::resend_window_test },
+        { "flash_spool_test", Tele::flash_spool_test },
+        { "file_flash_spool_test", Tele::file_flash_spool_test },
+    };
+
+    // runs every test, or the one named
+    const std::string_view only = argc > 1 ? argv[1] : "";
+
+    size_t ran = 0;
+    size_t failed = 0;
+
+    for (auto const& [name, test] : tests) {
+        if (!only.empty() && name != only)
+            continue;
+
+        ran++;
+
+        const bool passed = test();
+        std::printf("%.*s: %s\n", static_cast<int>(name.size()), name.data(), passed ? "passed" : "FAILED");
+
+        if (!passed)
+            failed++;
+    }
+
+    if (ran == 0) {
+        std::printf("no test named %.*s\n", static_cast<int>(only.size()), only.data());
+        return 1;
+    }
+
+    return failed == 0 ? 0 : 1;
+}